@@ -0,0 +1,519 @@
+﻿/*
+ Copyright (c) 2005-2020 sdragonx (mail:sdragonx@foxmail.com)
+
+ bench.cpp
+
+ 2026-10-17 16:20:00
+
+ minivg 软件渲染的性能测试，只依赖 minivg_raster.hpp，可以在 Linux 等平台编译。
+
+ 编译运行：
+    g++ -O2 -std=c++11 -I.. bench.cpp -o bench -lpthread
+    ./bench             运行全部测试
+    ./bench stroke      只运行名字里面包含 stroke 的测试
+
+ 测试项目：
+    span        纯色填充、混合内核（标量 / SIMD），clear() 和 fill_rect() 整屏填充
+    polygon     累加缓冲区多边形填充，10 ~ 1M 个顶点；覆盖率前缀和内核（标量 / SIMD）
+    threads     分块多线程渲染，帧时间和线程数量的关系，结果和单线程比较
+    batch       fill_rects / draw_lines / fill_circles 和逐个调用的对比
+    ellipse     椭圆光栅化，不同半径每秒绘制的数量
+    stroke      粗线描边和虚线，每秒的线段数量和线宽的关系
+    hairline    1 像素细线（VG_SPEED / VG_MEDIUM），和描边绘制的对比
+    resample    图片缩放，每个滤波器每秒处理的像素（百万）
+
+*/
+#include <minivg_raster.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace minivg;
+
+const int WIDTH  = 1920;
+const int HEIGHT = 1080;
+
+const double MIN_TIME = 0.25; // 每一项最少测试的时间（秒）
+
+//---------------------------------------------------------------------------
+// 工具
+//---------------------------------------------------------------------------
+
+double now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 重复执行 f，返回平均每次的时间（秒）
+template<typename F>
+double measure(F f)
+{
+    f();
+    int runs   = 0;
+    double t   = now();
+    double end = t;
+    do {
+        f();
+        ++runs;
+        end = now();
+    } while (end - t < MIN_TIME);
+    return (end - t) / runs;
+}
+
+// 固定种子的随机数，每次运行结果相同
+class lcg
+{
+private:
+    uint32_t m_seed;
+
+public:
+    lcg() : m_seed(12345) { }
+
+    uint32_t next()
+    {
+        m_seed = m_seed * 1664525u + 1013904223u;
+        return m_seed >> 8;
+    }
+
+    // 返回 a ~ b 之间的数
+    float range(float a, float b)
+    {
+        return a + (b - a) * float(this->next() & 0xFFFF) / 65535.0f;
+    }
+
+    vec4ub color()
+    {
+        uint32_t c = this->next();
+        return vec4ub(uint8_t(c), uint8_t(c >> 8), uint8_t(c >> 16), uint8_t(128 + (c >> 17) % 128));
+    }
+};
+
+// 绑定到内存缓冲区的画布
+class surface
+{
+public:
+    std::vector<vgPixel> pixels;
+    vgCanvas canvas;
+
+    surface(int width = WIDTH, int height = HEIGHT) : pixels(width * height, 0xFF000000)
+    {
+        canvas.bind(&pixels[0], width, height, width);
+    }
+
+    uint64_t hash() const
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            h = (h ^ pixels[i]) * 1099511628211ull;
+        }
+        return h;
+    }
+};
+
+// 测试项目名字包含 filter 的时候运行
+bool selected(const char* name, const char* filter)
+{
+    if (filter && !strstr(name, filter)) {
+        return false;
+    }
+    printf("\n[%s]\n", name);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// span：纯色填充和混合内核（user-002）
+//---------------------------------------------------------------------------
+
+void bench_span()
+{
+    const detail::pixel_kernels scalar = detail::select_kernels(0);
+    const detail::pixel_kernels& best  = detail::kernels();
+    const double pixels = double(WIDTH) * HEIGHT;
+
+    std::vector<vgPixel> row(WIDTH * HEIGHT);
+    struct item
+    {
+        const char* name;
+        detail::span_func scalar;
+        detail::span_func best;
+        vgPixel color;
+    } items[] = {
+        { "fill opaque gray (memset)", scalar.fill, best.fill, 0xFF808080 },
+        { "fill opaque color", scalar.fill, best.fill, 0xFF204080 },
+        { "blend 50% color", scalar.blend, best.blend, 0x80102040 },
+    };
+
+    printf("%-28s %12s %12s %8s\n", "kernel (1920x1080)", "scalar Mp/s", "simd Mp/s", "speedup");
+    for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); ++i) {
+        const item& k = items[i];
+        double a = measure([&] { for (int y = 0; y < HEIGHT; ++y) k.scalar(&row[y * WIDTH], WIDTH, k.color); });
+        double b = measure([&] { for (int y = 0; y < HEIGHT; ++y) k.best(&row[y * WIDTH], WIDTH, k.color); });
+        printf("%-28s %12.0f %12.0f %7.2fx\n", k.name, pixels / a * 1e-6, pixels / b * 1e-6, a / b);
+    }
+
+    surface s;
+    double clear = measure([&] { s.canvas.clear(32, 32, 32); s.canvas.flush(); });
+    s.canvas.fill_color(200, 100, 50, 128);
+    double fill = measure([&] { s.canvas.fill_rect(0.0f, 0.0f, float(WIDTH), float(HEIGHT)); s.canvas.flush(); });
+    printf("canvas clear()               %8.3f ms\n", clear * 1e3);
+    printf("canvas fill_rect() 50%%       %8.3f ms\n", fill * 1e3);
+}
+
+//---------------------------------------------------------------------------
+// polygon：累加缓冲区多边形填充（user-003）
+//---------------------------------------------------------------------------
+
+void bench_polygon()
+{
+    // 覆盖率前缀和内核
+    const detail::pixel_kernels scalar = detail::select_kernels(0);
+    const detail::pixel_kernels& best  = detail::kernels();
+    lcg rnd;
+    std::vector<int32_t> acc(WIDTH);
+    std::vector<uint8_t> covers(WIDTH);
+    for (int i = 0; i < WIDTH; ++i) {
+        acc[i] = int32_t(rnd.next() % 1024) - 512;
+    }
+    double a = measure([&] { for (int y = 0; y < HEIGHT; ++y) scalar.accumulate(&acc[0], &covers[0], WIDTH, VG_NONZERO, true); });
+    double b = measure([&] { for (int y = 0; y < HEIGHT; ++y) best.accumulate(&acc[0], &covers[0], WIDTH, VG_NONZERO, true); });
+    printf("accumulate (1920x1080)       scalar %.0f Mp/s, simd %.0f Mp/s, %.2fx\n",
+        double(WIDTH) * HEIGHT / a * 1e-6, double(WIDTH) * HEIGHT / b * 1e-6, a / b);
+
+    // 随机半径的星形多边形，顶点越多边越短
+    printf("%-12s %12s %14s\n", "vertices", "ms", "Mvertices/s");
+    surface s(1024, 1024);
+    s.canvas.fill_color(40, 160, 220, 200);
+    for (int n = 10; n <= 1000000; n *= 10) {
+        std::vector<vec2f> points(n);
+        for (int i = 0; i < n; ++i) {
+            float angle = float(i) * 2.0f * float(M_PI) / n;
+            float r     = rnd.range(200.0f, 500.0f);
+            points[i]   = vec2f(512.0f + r * cos(angle), 512.0f + r * sin(angle));
+        }
+        double t = measure([&] { s.canvas.fill_polygon(&points[0], points.size(), VG_NONZERO); s.canvas.flush(); });
+        printf("%-12d %12.3f %14.2f\n", n, t * 1e3, n / t * 1e-6);
+    }
+}
+
+//---------------------------------------------------------------------------
+// threads：分块多线程渲染（user-004）
+//---------------------------------------------------------------------------
+
+// 一帧混合的图形
+void draw_scene(vgCanvas& canvas)
+{
+    lcg rnd;
+    canvas.clear(24, 24, 24);
+    for (int i = 0; i < 2000; ++i) {
+        vec4ub c = rnd.color();
+        canvas.fill_color(c.r, c.g, c.b, c.a);
+        float x = rnd.range(0.0f, float(WIDTH));
+        float y = rnd.range(0.0f, float(HEIGHT));
+        switch (i % 4) {
+        case 0:
+            canvas.fill_rect(x, y, rnd.range(10.0f, 200.0f), rnd.range(10.0f, 200.0f));
+            break;
+        case 1:
+            canvas.fill_ellipse(x, y, rnd.range(5.0f, 100.0f), rnd.range(5.0f, 100.0f));
+            break;
+        case 2:
+            canvas.pen_color(c.r, c.g, c.b, c.a);
+            canvas.pen_width(rnd.range(1.0f, 8.0f));
+            canvas.draw_line(x, y, rnd.range(0.0f, float(WIDTH)), rnd.range(0.0f, float(HEIGHT)));
+            break;
+        default:
+            canvas.fill_roundrect(x, y, rnd.range(20.0f, 150.0f), rnd.range(20.0f, 150.0f), 10.0f, 10.0f);
+            break;
+        }
+    }
+    canvas.flush();
+}
+
+void bench_threads()
+{
+    printf("%-8s %12s %10s  %s\n", "threads", "frame ms", "speedup", "same as 1 thread");
+    double base   = 0.0;
+    uint64_t hash = 0;
+    const int counts[] = { 1, 2, 4, 8, 16 };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        surface s;
+        s.canvas.threads(counts[i]);
+        double t = measure([&] { draw_scene(s.canvas); });
+        if (i == 0) {
+            base = t;
+            hash = s.hash();
+        }
+        printf("%-8d %12.3f %9.2fx  %s\n", counts[i], t * 1e3, base / t, s.hash() == hash ? "yes" : "NO");
+    }
+}
+
+//---------------------------------------------------------------------------
+// batch：批量绘制和逐个调用（user-006）
+//---------------------------------------------------------------------------
+
+void bench_batch()
+{
+    const int N = 50000;
+    lcg rnd;
+    std::vector<vgRect> rects(N);
+    std::vector<vec2f> points(N), lines(N * 2);
+    std::vector<float> radius(N);
+    std::vector<vec4ub> colors(N);
+    for (int i = 0; i < N; ++i) {
+        float x = rnd.range(0.0f, float(WIDTH)), y = rnd.range(0.0f, float(HEIGHT));
+        rects[i]     = vgRect(x, y, rnd.range(2.0f, 12.0f), rnd.range(2.0f, 12.0f));
+        points[i]    = vec2f(x, y);
+        radius[i]    = rnd.range(1.0f, 6.0f);
+        lines[i * 2] = vec2f(x, y);
+        lines[i * 2 + 1] = vec2f(x + rnd.range(-20.0f, 20.0f), y + rnd.range(-20.0f, 20.0f));
+        colors[i]    = rnd.color();
+    }
+
+    printf("%-16s %12s %12s %8s  %s\n", "50k items", "loop ms", "batch ms", "speedup", "same");
+    surface a, b;
+    for (int k = 0; k < 3; ++k) {
+        const char* name = "";
+        double loop = 0.0, batch = 0.0;
+        switch (k) {
+        case 0:
+            name = "fill_rects";
+            loop = measure([&] {
+                for (int i = 0; i < N; ++i) {
+                    a.canvas.fill_color(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+                    a.canvas.fill_rect(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+                }
+                a.canvas.flush();
+            });
+            batch = measure([&] { b.canvas.fill_rects(&rects[0], &colors[0], N); b.canvas.flush(); });
+            break;
+        case 1:
+            name = "draw_lines";
+            loop = measure([&] {
+                for (int i = 0; i < N; ++i) {
+                    a.canvas.pen_color(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+                    a.canvas.draw_line(lines[i * 2].x, lines[i * 2].y, lines[i * 2 + 1].x, lines[i * 2 + 1].y);
+                }
+                a.canvas.flush();
+            });
+            batch = measure([&] { b.canvas.draw_lines(&lines[0], lines.size(), &colors[0]); b.canvas.flush(); });
+            break;
+        default:
+            name = "fill_circles";
+            loop = measure([&] {
+                for (int i = 0; i < N; ++i) {
+                    a.canvas.fill_color(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+                    a.canvas.fill_ellipse(points[i].x, points[i].y, radius[i], radius[i]);
+                }
+                a.canvas.flush();
+            });
+            batch = measure([&] { b.canvas.fill_circles(&points[0], &radius[0], &colors[0], N); b.canvas.flush(); });
+            break;
+        }
+
+        // 同样的次数绘制同样的内容，结果应该相同
+        a.pixels.assign(a.pixels.size(), 0xFF000000);
+        b.pixels.assign(b.pixels.size(), 0xFF000000);
+        if (k == 0) {
+            for (int i = 0; i < N; ++i) {
+                a.canvas.fill_color(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+                a.canvas.fill_rect(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+            }
+            b.canvas.fill_rects(&rects[0], &colors[0], N);
+        }
+        else if (k == 1) {
+            for (int i = 0; i < N; ++i) {
+                a.canvas.pen_color(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+                a.canvas.draw_line(lines[i * 2].x, lines[i * 2].y, lines[i * 2 + 1].x, lines[i * 2 + 1].y);
+            }
+            b.canvas.draw_lines(&lines[0], lines.size(), &colors[0]);
+        }
+        else {
+            for (int i = 0; i < N; ++i) {
+                a.canvas.fill_color(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+                a.canvas.fill_ellipse(points[i].x, points[i].y, radius[i], radius[i]);
+            }
+            b.canvas.fill_circles(&points[0], &radius[0], &colors[0], N);
+        }
+        a.canvas.flush();
+        b.canvas.flush();
+        printf("%-16s %12.3f %12.3f %7.2fx  %s\n", name, loop * 1e3, batch * 1e3, loop / batch, a.hash() == b.hash() ? "yes" : "NO");
+    }
+}
+
+//---------------------------------------------------------------------------
+// ellipse：椭圆光栅化（user-009）
+//---------------------------------------------------------------------------
+
+void bench_ellipse()
+{
+    const int N = 20000;
+    lcg rnd;
+    std::vector<vec2f> points(N);
+    for (int i = 0; i < N; ++i) {
+        points[i] = vec2f(rnd.range(0.0f, float(WIDTH)), rnd.range(0.0f, float(HEIGHT)));
+    }
+
+    printf("%-8s %16s %16s\n", "radius", "fill Mpoints/s", "ring Mpoints/s");
+    surface s;
+    s.canvas.fill_color(255, 200, 0, 160);
+    s.canvas.pen_color(0, 200, 255, 160);
+    s.canvas.pen_width(2.0f);
+    const float radius[] = { 1.0f, 2.0f, 4.0f, 8.0f, 32.0f };
+    for (size_t k = 0; k < sizeof(radius) / sizeof(radius[0]); ++k) {
+        const float r = radius[k];
+        double fill = measure([&] { for (int i = 0; i < N; ++i) s.canvas.fill_ellipse(points[i].x, points[i].y, r, r); s.canvas.flush(); });
+        double ring = measure([&] { for (int i = 0; i < N; ++i) s.canvas.draw_ellipse(points[i].x, points[i].y, r, r); s.canvas.flush(); });
+        printf("%-8.0f %16.2f %16.2f\n", r, N / fill * 1e-6, N / ring * 1e-6);
+    }
+}
+
+//---------------------------------------------------------------------------
+// stroke：粗线描边和虚线（user-011）
+//---------------------------------------------------------------------------
+
+void bench_stroke()
+{
+    const int N = 10000;
+    lcg rnd;
+    std::vector<vec2f> points(N + 1);
+    float x = 100.0f, y = 100.0f;
+    for (int i = 0; i <= N; ++i) {
+        x = std::min(std::max(x + rnd.range(-30.0f, 30.0f), 0.0f), float(WIDTH));
+        y = std::min(std::max(y + rnd.range(-30.0f, 30.0f), 0.0f), float(HEIGHT));
+        points[i] = vec2f(x, y);
+    }
+
+    printf("%-8s %18s %18s %18s\n", "width", "miter Mseg/s", "round Mseg/s", "dashed Mseg/s");
+    surface s;
+    s.canvas.pen_color(50, 220, 120, 200);
+    const float dash[] = { 4.0f, 2.0f };
+    const float widths[] = { 2.0f, 4.0f, 8.0f, 16.0f };
+    for (size_t k = 0; k < sizeof(widths) / sizeof(widths[0]); ++k) {
+        s.canvas.pen_width(widths[k]);
+        s.canvas.dash_pattern(NULL, 0);
+        s.canvas.line_join(VG_JOIN_MITER);
+        s.canvas.line_cap(VG_CAP_FLAT);
+        double miter = measure([&] { s.canvas.draw_polyline(&points[0], points.size()); s.canvas.flush(); });
+        s.canvas.line_join(VG_JOIN_ROUND);
+        s.canvas.line_cap(VG_CAP_ROUND);
+        double round = measure([&] { s.canvas.draw_polyline(&points[0], points.size()); s.canvas.flush(); });
+        s.canvas.dash_pattern(dash, 2);
+        double dashed = measure([&] { s.canvas.draw_polyline(&points[0], points.size()); s.canvas.flush(); });
+        printf("%-8.0f %18.3f %18.3f %18.3f\n", widths[k], N / miter * 1e-6, N / round * 1e-6, N / dashed * 1e-6);
+    }
+}
+
+//---------------------------------------------------------------------------
+// hairline：1 像素细线（user-012）
+//---------------------------------------------------------------------------
+
+void bench_hairline()
+{
+    const int N = 10000;
+    lcg rnd;
+    std::vector<vec2f> lines(N * 2);
+    for (int i = 0; i < N * 2; ++i) {
+        lines[i] = vec2f(rnd.range(-100.0f, WIDTH + 100.0f), rnd.range(-100.0f, HEIGHT + 100.0f));
+    }
+
+    surface s;
+    s.canvas.pen_color(255, 255, 255, 200);
+    struct mode
+    {
+        const char* name;
+        float width;
+        int effect;
+    } modes[] = {
+        { "hairline VG_SPEED", 1.0f, VG_SPEED },
+        { "hairline VG_MEDIUM", 1.0f, VG_MEDIUM },
+        { "stroked width 1.5", 1.5f, VG_MEDIUM },
+    };
+    printf("%-20s %12s\n", "10k random lines", "Mlines/s");
+    for (size_t k = 0; k < sizeof(modes) / sizeof(modes[0]); ++k) {
+        s.canvas.pen_width(modes[k].width);
+        s.canvas.effect_level(modes[k].effect);
+        double t = measure([&] {
+            for (int i = 0; i < N; ++i) {
+                s.canvas.draw_line(lines[i * 2].x, lines[i * 2].y, lines[i * 2 + 1].x, lines[i * 2 + 1].y);
+            }
+            s.canvas.flush();
+        });
+        printf("%-20s %12.3f\n", modes[k].name, N / t * 1e-6);
+    }
+}
+
+//---------------------------------------------------------------------------
+// resample：图片缩放（user-020）
+//---------------------------------------------------------------------------
+
+void bench_resample()
+{
+    lcg rnd;
+    std::vector<vgPixel> src(1024 * 1024);
+    for (size_t i = 0; i < src.size(); ++i) {
+        uint32_t a = 128 + rnd.next() % 128;
+        src[i]     = (a << 24) | (rnd.next() % (a + 1) << 16) | (rnd.next() % (a + 1) << 8) | (rnd.next() % (a + 1));
+    }
+    vgSurface image(&src[0], 1024, 1024, 1024);
+
+    struct filter
+    {
+        const char* name;
+        int filter;
+    } filters[] = {
+        { "nearest", VG_FILTER_NEAREST },
+        { "bilinear", VG_FILTER_BILINEAR },
+        { "bicubic", VG_FILTER_BICUBIC },
+        { "lanczos3", VG_FILTER_LANCZOS },
+    };
+    const int sizes[] = { 512, 1600 };
+
+    printf("%-10s %-12s %16s %16s\n", "filter", "1024 ->", "1 thread Mp/s", "4 threads Mp/s");
+    for (size_t k = 0; k < sizeof(filters) / sizeof(filters[0]); ++k) {
+        for (size_t n = 0; n < sizeof(sizes) / sizeof(sizes[0]); ++n) {
+            const int size = sizes[n];
+            surface s(size, size);
+            vgSurface dst(&s.pixels[0], size, size, size);
+            double one = measure([&] { s.canvas.resample(dst, image, filters[k].filter); });
+            s.canvas.threads(4);
+            double four = measure([&] { s.canvas.resample(dst, image, filters[k].filter); });
+            double pixels = double(size) * size;
+            printf("%-10s %-12d %16.1f %16.1f\n", filters[k].name, size, pixels / one * 1e-6, pixels / four * 1e-6);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : NULL;
+
+    printf("minivg bench, cpu features: %d\n", detail::cpu_features());
+    if (selected("span", filter)) {
+        bench_span();
+    }
+    if (selected("polygon", filter)) {
+        bench_polygon();
+    }
+    if (selected("threads", filter)) {
+        bench_threads();
+    }
+    if (selected("batch", filter)) {
+        bench_batch();
+    }
+    if (selected("ellipse", filter)) {
+        bench_ellipse();
+    }
+    if (selected("stroke", filter)) {
+        bench_stroke();
+    }
+    if (selected("hairline", filter)) {
+        bench_hairline();
+    }
+    if (selected("resample", filter)) {
+        bench_resample();
+    }
+    return 0;
+}
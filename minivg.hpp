@@ -108,6 +108,8 @@ using std::min;
 #include <objbase.h>
 #include <gdiplus.h>
 
+#include "minivg_raster.hpp"
+
 typedef unsigned char byte_t;
 
 namespace minivg {
@@ -131,6 +133,7 @@ enum vgWindowStyle
     VG_SIZEABLE   = 1,                      // 可缩放窗口
     VG_FULLSCREEN = 2,                      // 全屏窗口
     VG_BACKBUFFER = 4,                      // 缓冲区模式。不创建窗口，需要使用 framebuf_blt(hdc) 绘制到目标 HDC
+    VG_SOFTWARE   = 8,                      // 软件渲染。配合 VG_BACKBUFFER 使用，图元由 vgCanvas 直接绘制到缓冲区
 };
 
 // 颜色格式
@@ -278,458 +281,45 @@ public:
     double to_double() const { return string_cast<double>(*this); } // 字符串转双实数
 };
 
-//---------------------------------------------------------------------------
-// 数学、几何
-//---------------------------------------------------------------------------
-
-#ifndef M_PI
-#define M_PI        3.141592653589793238462     // acos(-1.0)
-#endif
-
-#ifndef M_PI_2
-#define M_PI_2      1.570796326794896619231     // M_PI/2
-#endif
-
-#ifndef M_RD
-#define M_RD        0.017453292519943295769     // 弧度 (radian)
-#define M_INV_RD    57.295779513082320876798    // 弧度的倒数 (reciprocal) 1.0 / M_RD
-#endif
-
-// 判断数值是否是 0
-template<typename T>inline bool is_zero        (T      n) { return n == 0; };
-template<>          inline bool is_zero<float> (float  n) { return n < 0.0 ? (n > -FLT_EPSILON) : (n < FLT_EPSILON); }
-template<>          inline bool is_zero<double>(double n) { return n < 0.0 ? (n > -DBL_EPSILON) : (n < DBL_EPSILON); }
-
-// 判断数值是否相等
-template<typename T>
-inline bool is_equal(T a, T b)
-{
-    return is_zero(a - b);
-}
-
-// 产生 [0 ~ n] 之间的随机数
-template<typename T>
-inline int random(T n)
-{
-    return rand() % n;
-}
-
-// 产生 [0 ~ 1] 之间的随机浮点数
-inline double rand_real()
-{
-    return double(rand()) / RAND_MAX;
-}
-
-// 产生 [a ~ b] 之间的随机浮点数
-inline double rand_real(double a, double b)
-{
-    return a + (b - a) * rand_real();
-}
-
-// 计算点 [x, y] 到原点的角度
-inline double degree_angle(double x, double y)
-{
-    using namespace std;
-
-    return atan2(y, x) * M_INV_RD;
-}
-
-//---------------------------------------------------------------------------
-// 向量类
-//---------------------------------------------------------------------------
-
-#if !defined(GLM_VERSION)
-
-#define VEC2_OPERATION(op)\
-    template<typename X>\
-    vec2<T> operator op(const X& value) const\
-    {\
-        return vec2<T>(x op value, y op value);\
-    }\
-    template<typename X>\
-    vec2<T> operator op(const vec2<X>& v) const\
-    {\
-        return vec2<T>(x op v.x, y op v.y);\
-    }\
-    template<typename X>\
-    vec2<T>& operator op##=(const X& value)\
-    {\
-        x op##= value; y op##= value;\
-        return *this;\
-    }\
-    template<typename X>\
-    vec2<T>& operator op##=(const vec2<X>& v)\
-    {\
-        x op##= v.x; y op##= v.y;\
-        return *this;\
-    }
-
-#define VEC4_OPERATION(op)\
-    template<typename X>\
-    vec4<T> operator op(const X& value) const\
-    {\
-        return vec4<T>(x op value, y op value, z op value, w op value);\
-    }\
-    template<typename X>\
-    vec4<T> operator op(const vec4<X>& v) const\
-    {\
-        return vec4<T>(x op v.x, y op v.y, z op v.z, w op v.w);\
-    }\
-    template<typename X>\
-    vec4<T>& operator op##=(const X& value)\
-    {\
-        x op##= value; y op##= value; z op##= value; w op##= value;\
-        return *this;\
-    }\
-    template<typename X>\
-    vec4<T>& operator op##=(const vec4<X>& v)\
-    {\
-        x op##= v.x; y op##= v.y; z op##= v.z; w op##= v.w;\
-        return *this;\
-    }
-
-template<typename T> class vec2;
-template<typename T> class vec4;
-
-template<typename T>
-class vec2
-{
-public:
-    union {
-        T data[2];
-        struct { T x, y; };
-    };
-
-    vec2() : x(), y() {}
-    vec2(T scalar) : x(scalar), y(scalar) {}
-    vec2(T _x, T _y) : x(_x), y(_y) {}
-
-    vec2& operator=(const vec2& other)
-    {
-        x = other.x;
-        y = other.y;
-        return *this;
-    }
-
-    vec2& set(T _x, T _y) { x = _x; y = _y; return *this; }
-
-    VEC2_OPERATION(+);
-    VEC2_OPERATION(-);
-    VEC2_OPERATION(*);
-    VEC2_OPERATION(/);
-
-          T& operator[](size_t i)       { return data[i]; }
-    const T& operator[](size_t i) const { return data[i]; }
-
-    bool operator==(const vec2& other) const
-    {
-        return is_equal(x, other.x) && is_equal(y, other.y);
-    }
-
-    bool operator!=(const vec2& other) const
-    {
-        return !is_equal(x, other.x) || !is_equal(y, other.y);
-    }
-};
-
-template<typename T>
-class vec4
-{
-public:
-    union
-    {
-        T data[4];
-        struct { T x, y, z, w; }; // 空间坐标
-        struct { T b, g, r, a; }; // 颜色分量 (GDI 使用的是 BGRA)
-    };
-
-    vec4() : x(), y(), z(), w() {}
-    vec4(T scalar) : x(scalar), y(scalar), z(scalar), w(scalar) {}
-    vec4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
-
-    vec4& set(T _x, T _y, T _z, T _w) { x = _x; y = _y; z = _z; w = _w; return *this; }
-
-          T& operator[](size_t i)       { return data[i]; }
-    const T& operator[](size_t i) const { return data[i]; }
-};
-
-typedef vec2<int>       vec2i;
-typedef vec2<float>     vec2f;
-typedef vec2<double>    vec2d;
-
-typedef vec4<uint8_t>   vec4ub;
-typedef vec4<int>       vec4i;
-typedef vec4<float>     vec4f;
-typedef vec4<double>    vec4d;
-
-// 获取向量距离原点的距离
-template<typename T>
-inline float length(const vec2<T>& v)
-{
-    using namespace std;
-
-    return static_cast<T>(sqrt(v.x * v.x + v.y * v.y));
-}
-
-// 获取两个向量的距离
-template<typename T>
-inline float distance(const vec2<T>& v1, const vec2<T>& v2)
-{
-    return length(v2 - v1);
-}
-
-// 归一化向量
-template<typename T>
-inline vec2<T> normalize(const vec2<T>& v)
-{
-    float n = length(v);
-    if (n == 0) {
-        return v;
-    }
-
-    n = 1.0f / n;
-
-    return vec2<T>(v.x * n, v.y * n);
-}
-
-// 旋转向量（角度）
-template<typename T, typename A>
-inline vec2<T> rotate(const vec2<T>& v, A angle)
-{
-    using namespace std;
-
-    angle *= M_RD;
-    T sine = static_cast<T>(sin(angle));
-    T cosine = static_cast<T>(cos(angle));
-    return vec2<T>(
-        v.x * cosine - v.y * sine,
-        v.x * sine + v.y * cosine);
-}
-
-// 计算角度
-template<typename T>
-inline T degree_angle(const vec2<T>& v)
-{
-    return degree_angle(v.x, v.y);
-}
-
-#else // GLM_VERSION
-
-#if !defined(MATH_PUBLIC_H_20220126134219)
-
-} // end namespace minivg
-
-#include <glm/glm.hpp>
-
-namespace cgl {
-
-typedef glm::ivec2      vec2i;
-typedef glm::vec2       vec2f;
-typedef glm::dvec2      vec2d;
-
-typedef glm::u8vec4     vec4ub;
-typedef glm::ivec4      vec4i;
-typedef glm::vec4       vec4f;
-typedef glm::dvec4      vec4d;
-
-} // end namespace cgl
-namespace minivg {
-
-#endif // GLM_HPP_20211019161738
-
-using cgl::vec2i;
-using cgl::vec2f;
-using cgl::vec2d;
-
-using cgl::vec4ub;
-using cgl::vec4i;
-using cgl::vec4f;
-using cgl::vec4d;
-
-#endif // GLM_VERSION
-
 // clang-format on
 
-// 矩形
-class vgRect
-{
-public:
-    float x;
-    float y;
-    float w;
-    float h;
-
-public:
-    vgRect() : x(), y(), w(), h() { }
-
-    vgRect(float x, float y, float width, float height) :
-        x(x),
-        y(y),
-        w(width),
-        h(height) { }
-
-    // 返回点是否在矩形内
-    bool contaits(float x, float y) const
-    {
-        return x > this->x &&
-               y > this->y &&
-               x < this->x + this->w &&
-               y < this->y + this->h;
-    }
-
-    bool contaits(const vec2i& v) const
-    {
-        return this->contaits(v.x, v.y);
-    }
-
-    bool contaits(const vec2f& v) const
-    {
-        return this->contaits(v.x, v.y);
-    }
-
-    // 判断矩形是否相交
-    bool collision(const vgRect& other) const
-    {
-        using namespace std;
-
-        float left   = max(x, other.x);
-        float top    = max(y, other.y);
-        float right  = min(x + w, other.x + other.w);
-        float bottom = min(y + h, other.y + other.h);
-
-        return (right - left) > 0.0f && (bottom - top) > 0.0f;
-    }
-};
-
-// 包围盒
-class AABB
-{
-public:
-    float x1, y1, x2, y2;
-
-public:
-    AABB()
-    {
-        reset();
-    }
-
-    AABB(float x1, float y1, float x2, float y2)
-    {
-        this->x1 = x1;
-        this->y1 = y1;
-        this->x2 = x2;
-        this->y2 = y2;
-    }
-
-    // 重置
-    void reset()
-    {
-        // 初始化一个无效的包围盒
-        x1 = y1 = FLT_MAX;  // 左上角最大值
-        x2 = y2 = -FLT_MAX; // 右下角最小值
-    }
-
-    // 判断包围盒面积是否为正数
-    bool is_valid() const
-    {
-        return x1 < x2 && y1 < y2;
-    }
-
-    // 附加一个点，扩展包围盒
-    void append(float x, float y)
-    {
-        using namespace std;
-
-        x1 = min(x1, x);
-        x2 = max(x2, x);
-        y1 = min(y1, y);
-        y2 = max(y2, y);
-    }
-
-    void append(const vec2f& v)
-    {
-        this->append(v.x, v.y);
-    }
-
-    // 返回宽度
-    float width() const
-    {
-        return x2 - x1;
-    }
-
-    // 返回高度
-    float height() const
-    {
-        return y2 - y1;
-    }
-
-    // 获取包围盒中心位置
-    vec2f center() const
-    {
-        // 无效
-        if (x1 > y2 || y2 < y1) {
-            return vec2f();
-        }
-
-        return vec2f(x1 + (this->width() / 2), y1 + (this->height() / 2));
-    }
-
-    // 移动包围盒
-    void move(float x, float y)
-    {
-        x1 += x;
-        y1 += y;
-        x2 += x;
-        y2 += y;
-    }
-
-    void move(const vec2f& v)
-    {
-        this->move(v.x, v.y);
-    }
-
-    // 判断包围盒是否包含点
-    bool contaits(float x, float y) const
-    {
-        return x >= x1 && y >= y1 && x < x2 && y < y2;
-    }
-
-    bool contaits(const vec2f& p) const
-    {
-        return this->contaits(p.x, p.y);
-    }
-
-    // 判断两个包围盒是否相交
-    bool collision(const AABB& other) const
-    {
-        using namespace std;
-
-        float left   = max(x1, other.x1);
-        float top    = max(y1, other.y1);
-        float right  = min(x2, other.x2);
-        float bottom = min(y2, other.y2);
-
-        return (right - left) > 0.0f && (bottom - top) > 0.0f;
-    }
-};
-
 //---------------------------------------------------------------------------
 // 图片类
 //---------------------------------------------------------------------------
 
+namespace detail {
+class vgAtlas;
+}
+
 class vgImage
 {
+    friend class detail::vgAtlas;
+
 protected:
     Gdiplus::Bitmap* m_handle;   // 图片指针
     Gdiplus::BitmapData* m_data; // 图片 map 数据指针
+    bool m_readonly;             // m_data 是只读锁定
+    vgImage* m_page;             // 图集页，不为空的时候图片是图集页里面的一块区域
+    detail::vgAtlas* m_atlas;    // 打包图片的图集，释放的时候更新图集的统计
+    int m_x, m_y;                // 在图集页里面的位置
+    int m_width, m_height;       // 在图集页里面的大小
+    bool m_useMipmap;            // 缩小绘制的时候使用 mipmap
+    vgMipmap m_mipmap;           // mipmap 像素
+    std::vector<Gdiplus::Bitmap*> m_levels; // GDI+ 绘制使用的每一级图片，直接使用 m_mipmap 的像素
 
 public:
     vgImage();
     ~vgImage();
 
-    // 返回图片的指针
+    // 返回图片的指针（图集里面的图片返回图集页的指针，绘制的时候使用 source() 范围）
     Gdiplus::Bitmap* handle() const;
 
+    // 返回图片在 handle() 里面的范围
+    vgRect source() const;
+
+    // 返回图集页，不在图集里面的图片返回空
+    vgImage* page() const;
+
     // 创建一个图片，默认为 32 位色
     int create(int width, int height, int format = VG_RGBA);
 
@@ -742,12 +332,21 @@ public:
     // 绑定 HBITMAP 对象，直接操作 HBITMAP。
     int bind(HBITMAP hbmp);
 
+    // 绑定图集页里面的一块区域，图集页由调用者管理，需要比图片晚释放
+    int bind(vgImage* page, int x, int y, int width, int height);
+
     // 判断图片是否为空
     bool empty() const;
 
     // 保存图片
     int save(const unistring& filename, int type = VG_PNG);
 
+    /* 缩放图片，使用软件渲染的可分离滤波器和渲染线程
+     * filter           vgImageFilter，VG_FILTER_AUTO 使用双三次插值
+     * 图集里面的图片缩放以后成为单独的图片
+     */
+    int resize(int width, int height, int filter = VG_FILTER_BICUBIC);
+
     // 自动释放图片
     void close();
 
@@ -757,11 +356,85 @@ public:
     // 返回图片的高度
     int height() const;
 
-    // 获取图像数据指针
+    /* 获取图像数据指针
+     * 图片已经锁定（比如软件渲染绘制过）的时候，格式和读写方式满足要求就直接返回，否则重新锁定。
+     * 图集里面的图片只支持 VG_RGBA 格式，返回区域左上角的指针，行跨度是图集页的宽度
+     */
     void* map(bool readonly = false, int pixelformat = VG_RGBA);
 
     // 还原图像数据
     void unmap();
+
+    // 返回软件渲染使用的像素视图（图片保持锁定，直到 unmap() 或 close()）
+    vgSurface surface();
+
+    /* 开启 mipmap（默认关闭）
+     * enable           true 的时候，第一次缩小绘制的时候生成 mipmap，缩小绘制从接近的一级采样，
+     *                  VG_QUALITY 的时候软件渲染在相邻两级之间插值。
+     *                  map() 修改像素以后重新生成。
+     */
+    void mipmap(bool enable);
+
+    // 是否开启 mipmap
+    bool mipmap() const;
+
+    // 返回 mipmap，软件渲染的时候由画布生成
+    vgMipmap& mipmaps();
+
+    /* 返回 GDI+ 缩小绘制使用的图片
+     * scale            绘制的缩放（目标大小 / 图片大小）
+     * source           输入图片里面的源范围，返回选择的图片里面的源范围
+     */
+    Gdiplus::Bitmap* mipmap_handle(float scale, vgRect& source);
+
+protected:
+    // 释放 mipmap
+    void reset_mipmap();
+};
+
+//---------------------------------------------------------------------------
+// 精灵批量绘制
+//---------------------------------------------------------------------------
+
+/* 收集精灵，draw() 的时候一次绘制。
+ * 绘制顺序和添加顺序相同，连续使用同一张图片的精灵一起提交。
+ */
+class vgSpriteBatch
+{
+protected:
+    std::vector<vgImage*> m_images;  // 每个精灵的图片
+    std::vector<vgSprite> m_sprites; // 精灵参数
+
+public:
+    // 清空精灵
+    void clear();
+
+    // 预留空间
+    void reserve(size_t size);
+
+    // 返回精灵数量
+    size_t size() const;
+
+    bool empty() const;
+
+    // 添加精灵
+    void add(vgImage* image, const vgSprite& sprite);
+
+    // 添加精灵，使用整张图片
+    void add(
+        vgImage* image,                    // 绘制的图片
+        float x, float y,                  // 目标位置
+        float scaleX = 1.0f,               // 缩放
+        float scaleY = 1.0f,
+        float rotation = 0.0f,             // 旋转角度
+        float centerX = 0.5f,              // 旋转中心(0.0 - 1.0 之间，按源大小比例设置旋转中心)
+        float centerY = 0.5f,
+        float alpha = 1.0f,                // 透明度
+        COLORREF tint = 0xFFFFFFFF         // 着色
+    );
+
+    // 绘制所有精灵
+    void draw() const;
 };
 
 //---------------------------------------------------------------------------
@@ -777,6 +450,7 @@ public:
  *                      VG_SIZEABLE     可缩放
  *                      VG_FULLSCREEN   全屏
  *                      VG_BUFFER       只创建绘图缓冲区，不创建窗口
+ *                      VG_SOFTWARE     和 VG_BACKBUFFER 组合使用，启用软件渲染
  */
 int initgraph(int width, int height, int param = VG_FIXED);
 int initgraph(const unistring& title, int width, int height, int param = VG_FIXED);
@@ -799,6 +473,9 @@ HDC graph_hdc();
 // 获取 GDI+ 绘图设备
 Gdiplus::Graphics* graphics();
 
+// 获取软件渲染画布，没有启用软件渲染返回空
+vgCanvas* graph_canvas();
+
 // 设置视口显示范围 (宽高改变会重设背景缓冲区大小)
 void viewport(int x, int y, int width, int height);
 
@@ -874,27 +551,121 @@ void display_event(VG_PAINT_EVENT function);
 // 绘图函数
 //---------------------------------------------------------------------------
 
+/* 设置变换，影响之后的图形、图片、精灵和文字
+ * m                绘图坐标到设备坐标的变换
+ * 剪裁矩形、clear() 和 invalidate() 使用设备坐标，不受变换影响。
+ * 平移、缩放和 90 度倍数的旋转，矩形、椭圆和图片仍然可以使用轴对齐的快速路径。
+ */
+void transform(const vgMatrix& m);
+
+// 返回当前变换
+vgMatrix transform();
+
+// 重置为单位矩阵，不影响变换栈
+void reset_transform();
+
+// 保存当前变换
+void push_transform();
+
+// 恢复上一次保存的变换，栈为空的时候重置为单位矩阵
+void pop_transform();
+
+// 平移，在当前变换之前应用
+void translate(float x, float y);
+
+// 旋转（角度，顺时针），在当前变换之前应用
+void rotate(float angle);
+
+// 缩放，在当前变换之前应用
+void scale(float x, float y);
+
 // 设置剪裁矩形
 void cliprect(int x, int y, int width, int height);
 
-// 压入剪裁矩形
+// 压入剪裁矩形，和当前剪裁求交集
 void push_cliprect(int x, int y, int width, int height);
 
-// 弹出剪裁矩形
+// 弹出剪裁矩形，恢复压入之前的剪裁
 void pop_cliprect();
 
 // 背景缓冲绘制到目标 HDC
 void framebuf_blt(HDC hdc);
 
-// 设置显示质量
-enum vgEffectLevel
+// 设置显示质量 (vgEffectLevel)
+int effect_level(int level);
+
+/* 设置混合模式 (vgBlendMode)，返回之前的混合模式
+ * 影响之后的填充、描边、图片、精灵和 draw_pixels，clear() 不受影响。
+ * GDIPlus 绘图只支持 VG_BLEND_NORMAL 和 VG_BLEND_COPY，其他模式按 VG_BLEND_NORMAL 绘制。
+ */
+int blend_mode(int mode);
+
+/* 设置图片缩放滤波器 (vgImageFilter)，返回之前的滤波器
+ * VG_FILTER_AUTO 按显示质量选择。软件渲染的轴对齐缩放绘制使用可分离滤波器，
+ * 目标范围对齐到像素；GDIPlus 绘图使用对应的插值模式，Lanczos 按高质量双三次绘制。
+ */
+int image_filter(int filter);
+
+/* 设置软件渲染线程数量
+ * count            大于 1 的时候，绘图命令先记录下来，显示的时候分块多线程绘制，
+ *                  结果和单线程绘制完全相同
+ */
+void render_threads(int count);
+
+/* 设置延迟绘制（软件渲染）
+ * enable           true 的时候，绘图函数只记录绘图命令，窗口显示或者调用 flush() 的时候
+ *                  整理之后统一绘制。记录期间使用的图片，在绘制之前不能释放。
+ */
+void deferred_mode(bool enable);
+
+// 立即执行记录的绘图命令
+void flush();
+
+/* 开启脏矩形跟踪（默认关闭）
+ * enable           true 的时候，每个绘图函数影响的区域合并到本帧的脏矩形里面，
+ *                  显示的时候只复制脏矩形，不再复制整个视口。
+ *                  软件渲染记录每个绘图命令剪裁以后的范围，GDI+ 记录图形变换以后的包围盒。
+ *                  直接修改像素、通过 graph_hdc() 绘制以后需要调用 invalidate() 标记改变的区域。
+ */
+void damage_tracking(bool enable);
+
+// 标记改变的区域
+void invalidate(int x, int y, int width, int height);
+
+/* 返回本帧的脏矩形数量
+ * rects            不为空的时候，复制最多 size 个脏矩形
+ */
+int damage_rects(vgRect* rects, int size);
+
+/* 开启分块比较（默认关闭）
+ * enable           true 的时候，显示之前把缓冲区分成 32x32 的块计算哈希，
+ *                  只复制和上一帧不同的块。不管内容是怎么画的都有效，
+ *                  包括 GDI+、draw_pixels() 和通过 graph_hdc() 绘制的内容。
+ */
+void tile_diff(bool enable);
+
+/* 返回上一次显示复制的矩形数量（脏矩形跟踪或者分块比较的结果）
+ * rects            不为空的时候，复制最多 size 个矩形，可以用来导出改变的区域
+ */
+int presented_rects(vgRect* rects, int size);
+
+// 帧统计
+struct vgFrameStats
 {
-    VG_SPEED,   // 速度优先
-    VG_MEDIUM,  // 中等质量
-    VG_QUALITY, // 质量优先
+    int frames;             // 显示的帧数
+    int damageRects;        // 上一帧复制的矩形数量
+    size_t blitBytes;       // 上一帧复制的字节数
+    size_t fullBytes;       // 复制整个视口的字节数
+    double totalBlitBytes;  // 累计复制的字节数
+    double totalFullBytes;  // 每帧都复制整个视口的累计字节数
+    int drawCalls;          // 上一帧的绘图调用数量（图形、文字和图片）
+    int culledCalls;        // 上一帧完全在剪裁范围外面、没有绘制的调用数量
+    int layerRedraws;       // 上一帧重新绘制的图层数量
+    double compositeTime;   // 上一帧合成图层的时间（毫秒，不包括重新绘制图层）
 };
 
-int effect_level(int level);
+// 返回帧统计
+vgFrameStats frame_stats();
 
 // 设置帧率
 void set_fps(int value);
@@ -927,11 +698,12 @@ void pen_width(float width);
 // 画笔样式
 enum vgPenStyle
 {
-    VG_SOLID,     // 实心画笔（默认）
-    VG_DASH,      // -------
-    VG_DOT,       // .......
-    VG_DASH_DOT,  // -.-.-.-
-    VG_CUSTOM = 5 // 自定义点画模式
+    VG_SOLID,        // 实心画笔（默认）
+    VG_DASH,         // -------
+    VG_DOT,          // .......
+    VG_DASH_DOT,     // -.-.-.-
+    VG_DASH_DOT_DOT, // -..-..-
+    VG_CUSTOM = 5    // 自定义点画模式
 };
 
 // 返回画笔样式
@@ -946,6 +718,12 @@ void pen_style(int mode);
  */
 void dash_style(const float* dash, int size);
 
+// 设置拐角样式 vgLineJoin，默认 VG_JOIN_MITER
+void line_join(int join);
+
+// 设置线帽样式 vgLineCap，默认 VG_CAP_FLAT
+void line_cap(int cap);
+
 // 获取填充颜色
 vec4ub fill_color();
 
@@ -959,6 +737,12 @@ void fill_color(BYTE r, BYTE g, BYTE b, BYTE a = 255);
 void fill_color(COLORREF argb);
 void fill_color(vec4ub rgba);
 
+/* 使用渐变填充，fill_* 函数使用渐变代替填充颜色，设置填充颜色以后取消渐变
+ * gradient         渐变，保存副本，修改以后需要重新设置
+ * GDIPlus 绘图的线性渐变只能重复或者镜像重复，径向渐变只填充圆的范围，锥形渐变使用第一个颜色。
+ */
+void fill_gradient(const vgGradient& gradient);
+
 /* 绘制一个点
  * x                x 方向坐标
  * y                y 方向坐标
@@ -1055,6 +839,41 @@ void draw_polygon(const vec2f* points, size_t size);
  */
 void fill_polygon(const vec2f* points, size_t size);
 
+/* 批量填充矩形，结果和逐个调用 fill_rect 相同
+ * 软件渲染的时候，没有旋转和镜像的矩形不经过光栅化器，整个批次一遍直接逐行混合。
+ * rects            矩形数组
+ * colors           每个矩形的颜色，为空使用填充颜色
+ * size             矩形数量
+ */
+void fill_rects(const vgRect* rects, const vec4ub* colors, size_t size);
+
+/* 批量绘制线段，结果和逐个调用 draw_line 相同
+ * 每条线段仍然单独光栅化，只省掉逐个调用和提交命令的开销。
+ * points           线段端点数组，每两个点一条线段
+ * size             端点数量
+ * colors           每条线段的颜色，为空使用画笔颜色
+ */
+void draw_lines(const vec2f* points, size_t size, const vec4ub* colors = NULL);
+
+/* 批量填充圆，结果和逐个调用 fill_ellipse 相同
+ * 软件渲染的时候整个批次一遍直接逐行混合，时间主要是逐像素计算覆盖率，和逐个调用差不多。
+ * points           圆心数组
+ * radius           半径数组
+ * colors           每个圆的颜色，为空使用填充颜色
+ * size             圆的数量
+ */
+void fill_circles(const vec2f* points, const float* radius, const vec4ub* colors, size_t size);
+
+/* 绘制路径
+ * path             路径，曲线展平的结果缓存在路径里面，可以每帧重复使用
+ */
+void draw_path(const vgPath& path);
+
+/* 填充路径
+ * path             路径，使用路径的填充规则
+ */
+void fill_path(const vgPath& path);
+
 //---------------------------------------------------------------------------
 // 字体函数
 //---------------------------------------------------------------------------
@@ -1163,12 +982,45 @@ vgImage* loadimage(const unistring& filename);
 // 加载资源中的图片
 vgImage* loadimage(int id, PCTSTR resource_type = TEXT("PNG"));
 
+/* 开启图集（默认关闭）
+ * enable           true 的时候，之后 loadimage() 加载的小图片复制到共用的图集页里面，
+ *                  原来的图片释放，返回的图片指向图集页里面的一块区域。
+ *                  绘制函数和精灵批量绘制直接支持这些图片，减少小图片的内存分配。
+ * pageSize         图集页的宽高
+ * maxSize          宽高都不超过 maxSize 的图片才放到图集里面
+ */
+void image_atlas(bool enable, int pageSize = 1024, int maxSize = 256);
+
+// 图集统计
+struct vgAtlasStats
+{
+    int pages;          // 图集页数量
+    int images;         // 图集里面的图片数量（不包括已经释放或者缩放的图片）
+    size_t pageBytes;   // 图集页占用的内存，图集页在程序退出之前不释放，图片全部释放的页重新打包
+    size_t imageBytes;  // 图片像素占用的内存（不包括间隔和空闲区域）
+    float efficiency;   // 打包效率 imageBytes / pageBytes
+};
+
+// 返回图集统计
+vgAtlasStats atlas_stats();
+
 /* 保存图片
  * image            要保存的图片
  * filename         png 图片文件名
  */
 int saveimage(vgImage* image, const unistring& filename);
 
+/* 开始绘制到图片，之后的图形、文字、图片和精灵都绘制到 image 里面，直到 end_target()
+ * image            newimage() 创建或者加载的图片，绘制期间不能释放，也不能绘制到自己
+ * 图片从单位变换、不剪裁开始绘制，end_target() 恢复之前的目标、变换（包括变换栈）和剪裁，可以嵌套使用。
+ * 绘制期间没有配对的 push_transform() / pop_transform() 只影响图片，不会改变之前的变换栈。
+ * 成功返回 0
+ */
+int begin_target(vgImage* image);
+
+// 结束绘制到图片，恢复之前的绘图目标
+void end_target();
+
 /* 原始大小绘制图片
  * xy               图片绘制位置
  */
@@ -1191,7 +1043,8 @@ void drawsprite(
     float rotation,                        // 旋转角度
     float centerX = 0.5f,                  // 旋转中心(0.0 - 1.0 之间，按源大小比例设置旋转中心)
     float centerY = 0.5f,
-    float alpha   = 1.0f
+    float alpha   = 1.0f,                  // 透明度
+    COLORREF tint = 0xFFFFFFFF             // 着色 0xAARRGGBB，图片颜色乘以着色
 );
 
 void drawsprite(
@@ -1203,6 +1056,13 @@ void drawsprite(
     float centerY = 0.5f
 );
 
+/* 批量绘制精灵，按数组顺序绘制，和剪裁矩形不相交的精灵逐个剔除
+ * images           每个精灵的图片
+ * sprites          精灵参数
+ * size             精灵数量
+ */
+void drawsprites(vgImage* const* images, const vgSprite* sprites, size_t size);
+
 /* 把像素直接绘制到屏幕上，像素格式必须是 BGRA 32位。
  * x, y             像素绘制位置
  * width            绘制的宽度
@@ -1213,6 +1073,88 @@ void drawsprite(
  */
 void draw_pixels(float x, float y, float width, float height, const void* pixels, int imageWidth, int imageHeight);
 
+//---------------------------------------------------------------------------
+// 图层
+//---------------------------------------------------------------------------
+
+/* 图层，有自己的离屏缓冲区，大小和视口相同。
+ * 图层无效（或者视口大小改变）的时候调用绘制函数重新绘制，否则合成的时候直接使用缓冲区里面的像素。
+ */
+class vgLayer
+{
+protected:
+    unistring m_name;       // 名字
+    VG_PAINT_EVENT m_paint; // 绘制函数
+    vgImage m_image;        // 离屏缓冲区
+    int m_zorder;           // 合成顺序，小的在下面
+    float m_opacity;        // 不透明度 0.0 - 1.0
+    int m_x, m_y;           // 合成的偏移
+    bool m_visible;         // 是否显示
+    bool m_invalid;         // 需要重新绘制
+    int m_redraws;          // 重新绘制的次数
+
+public:
+    vgLayer(const unistring& name, VG_PAINT_EVENT paint, int zorder);
+
+    // 返回名字
+    const unistring& name() const;
+
+    // 设置绘制函数，图层变为无效
+    void paint(VG_PAINT_EVENT function);
+
+    // 标记图层无效，下一次合成的时候重新绘制
+    void invalidate();
+
+    bool invalid() const;
+
+    // 合成顺序，相同的按创建顺序
+    void zorder(int value);
+    int zorder() const;
+
+    // 不透明度，改变不需要重新绘制
+    void opacity(float value);
+    float opacity() const;
+
+    // 合成的偏移（像素），改变不需要重新绘制
+    void offset(int x, int y);
+    int x() const;
+    int y() const;
+
+    // 是否显示，隐藏的图层不合成也不重新绘制
+    void visible(bool value);
+    bool visible() const;
+
+    // 返回重新绘制的次数
+    int redraws() const;
+
+    // 返回离屏缓冲区
+    vgImage* image();
+
+    /* 图层无效或者大小改变的时候重新绘制
+     * 返回是否重新绘制
+     */
+    bool update(int width, int height);
+};
+
+/* 创建图层
+ * name             名字，findlayer() 使用
+ * paint            绘制函数，图层无效的时候调用，绘制到图层的缓冲区
+ * zorder           合成顺序，小的在下面
+ */
+vgLayer* newlayer(const unistring& name, VG_PAINT_EVENT paint, int zorder = 0);
+
+// 按名字查找图层，没有找到返回空
+vgLayer* findlayer(const unistring& name);
+
+// 删除图层
+void freelayer(vgLayer* layer);
+
+/* 合成图层
+ * 先重新绘制无效的图层，再按合成顺序把所有显示的图层一次混合到当前绘图目标上面（源覆盖），
+ * 受剪裁矩形影响，不受变换影响。一般在 display_event 里面 clear() 之后调用。
+ */
+void composite_layers();
+
 //---------------------------------------------------------------------------
 // 多媒体
 //---------------------------------------------------------------------------
@@ -164,6 +164,133 @@ MINIVG_INLINE HBITMAP bm_create(int width, int height, int pixelbits = 32)
     return hBitmap;
 }
 
+// 图集，把加载的小图片复制到共用的图集页里面
+
+class vgAtlas
+{
+private:
+    std::vector<vgImage*> pages;        // 图集页
+    std::vector<vgAtlasPacker> packers; // 每一页的打包位置
+    std::vector<int> counts;            // 每一页里面的图片数量
+    int images;                         // 图集里面的图片数量
+    size_t imageBytes;                  // 图片像素占用的内存
+
+public:
+    bool enabled;
+    int pageSize; // 新建图集页的大小
+    int maxSize;  // 放到图集里面的图片的最大宽高
+
+    vgAtlas() : pages(), packers(), counts(), images(), imageBytes(), enabled(), pageSize(1024), maxSize(256)
+    {
+    }
+
+    // 把图片复制到图集页里面，成功以后图片指向图集页里面的区域
+    bool pack(vgImage* image)
+    {
+        // 四周重复一圈边缘像素，GDI+ 缩放的时候不会采样到相邻的图片
+        const int PADDING = 1;
+
+        int w = image->width();
+        int h = image->height();
+        if (!enabled || image->page() || w <= 0 || h <= 0 || w > maxSize || h > maxSize) {
+            return false;
+        }
+
+        int x, y;
+        size_t i = 0;
+        while (i < packers.size() && !packers[i].insert(w + PADDING * 2, h + PADDING * 2, x, y)) {
+            ++i;
+        }
+        if (i == packers.size()) {
+            int size = std::max(pageSize, std::max(w, h) + PADDING * 2);
+            vgAtlasPacker packer(size, size);
+            vgImage* page = new vgImage();
+            page->create(size, size);
+            vgSurface pixels = page->surface();
+            if (pixels.empty() || !packer.insert(w + PADDING * 2, h + PADDING * 2, x, y)) {
+                delete page;
+                return false;
+            }
+            for (int row = 0; row < pixels.height; ++row) {
+                memset(pixels.row(row), 0, pixels.width * sizeof(vgPixel));
+            }
+            pages.push_back(page);
+            packers.push_back(packer);
+            counts.push_back(0);
+        }
+
+        vgSurface src = image->surface();
+        vgSurface dst = pages[i]->surface();
+        if (src.empty() || dst.empty()) {
+            image->unmap();
+            pages[i]->unmap();
+            return false;
+        }
+        for (int row = -PADDING; row < h + PADDING; ++row) {
+            const vgPixel* s = src.row(std::min(std::max(row, 0), h - 1));
+            vgPixel* d       = dst.row(y + PADDING + row) + x + PADDING;
+            for (int n = 1; n <= PADDING; ++n) {
+                d[-n]        = s[0];
+                d[w - 1 + n] = s[w - 1];
+            }
+            memcpy(d, s, w * sizeof(vgPixel));
+        }
+
+        // 解除锁定，GDI+ 才能绘制
+        image->unmap();
+        pages[i]->unmap();
+
+        image->bind(pages[i], x + PADDING, y + PADDING, w, h);
+        image->m_atlas = this;
+        ++counts[i];
+        ++images;
+        imageBytes += size_t(w) * h * sizeof(vgPixel);
+        return true;
+    }
+
+    /* 图集里面的图片释放（close()、resize() 等）的时候调用，更新统计
+     * 打包位置不能单独回收，一页的图片全部释放以后，整页重新打包
+     */
+    void release(vgImage* page, int width, int height)
+    {
+        size_t i = std::find(pages.begin(), pages.end(), page) - pages.begin();
+        if (i == pages.size()) {
+            return;
+        }
+        --images;
+        imageBytes -= size_t(width) * height * sizeof(vgPixel);
+        if (--counts[i] == 0) {
+            packers[i].clear();
+        }
+    }
+
+    vgAtlasStats stats() const
+    {
+        vgAtlasStats s = { 0 };
+        s.pages      = static_cast<int>(pages.size());
+        s.images     = images;
+        s.imageBytes = imageBytes;
+        for (size_t i = 0; i < packers.size(); ++i) {
+            s.pageBytes += size_t(packers[i].width()) * packers[i].height() * sizeof(vgPixel);
+        }
+        s.efficiency = s.pageBytes ? float(double(s.imageBytes) / s.pageBytes) : 0.0f;
+        return s;
+    }
+
+    // 释放图集页，图集里面的图片需要先释放
+    void dispose()
+    {
+        for (size_t i = 0; i < pages.size(); ++i) {
+            delete pages[i];
+        }
+        pages.clear();
+        packers.clear();
+        counts.clear();
+        images     = 0;
+        imageBytes = 0;
+    }
+};
+
 // 资源管理类
 
 class vgResource
@@ -174,6 +301,8 @@ private:
     std::vector<vgImage*> image_pool;        // 创建的图片
 
 public:
+    vgAtlas atlas; // 图集
+
     // 加载一个图片
     vgImage* loadimage(const unistring& name)
     {
@@ -183,6 +312,7 @@ public:
         if (itr == images.end()) {
             bmp = new vgImage;
             if (bmp->open(name) == VG_OK) {
+                atlas.pack(bmp);
                 images[name] = bmp;
             }
             else {
@@ -204,6 +334,7 @@ public:
         if (itr == resource_images.end()) {
             bmp = new vgImage;
             if (bmp->open(id, resource_type) == VG_OK) {
+                atlas.pack(bmp);
                 resource_images[id] = bmp;
             }
             else {
@@ -242,6 +373,7 @@ public:
     {
         delete_all(images);
         delete_all(resource_images);
+        atlas.dispose();
 
         for (size_t i = 0; i < image_pool.size(); ++i) {
             delete image_pool[i];
@@ -720,6 +852,22 @@ protected:
 // minivg 实例类
 //---------------------------------------------------------------------------
 
+// 离屏绘图目标，begin_target() 的时候保存之前的绘图状态
+struct render_target
+{
+    vgImage* image;                       // 绘制的图片
+    Gdiplus::Bitmap* bitmap;              // 包装图片锁定的像素，GDI+ 直接绘制到这块像素
+    Gdiplus::Graphics* g;                 // 之前的 GDI+ 设备
+    vgSurface surface;                    // 之前的绘图目标
+    detail::irect clip;                   // 之前的剪裁矩形
+    std::vector<detail::irect> clipStack; // 之前的剪裁矩形堆栈
+    bool clipChanged;                     // 之前的 GDI+ 剪裁是否需要同步
+    vgMatrix transform;                   // 之前的变换
+    std::vector<vgMatrix> transformStack; // 之前的变换栈
+
+    render_target() : image(), bitmap(), g(), surface(), clip(), clipStack(), clipChanged(), transform(), transformStack() { }
+};
+
 class vgContext : public vgWindow
 {
 public:
@@ -728,9 +876,16 @@ public:
     HBITMAP pixelbuf;                     // 像素缓冲区
 
     int effectLevel;                      // 效果等级
+    int blendMode;                        // 混合模式
+    int imageFilter;                      // 图片缩放滤波器
 
     Gdiplus::Pen* pen;                    // 画笔
     Gdiplus::SolidBrush* brush;           // 画刷
+    Gdiplus::Brush* gradientBrush;        // 渐变画刷，为空使用 brush
+    Gdiplus::ImageAttributes* spriteAttributes; // 精灵的透明度和着色
+    uint32_t spriteColor;                 // spriteAttributes 当前的颜色
+    std::vector<vgSprite> spriteCache;    // drawsprites() 剔除以后留下的精灵
+    Gdiplus::SolidBrush* pointBrush;      // 画笔颜色的画刷，用来画点
     Gdiplus::Font* font;                  // 字体
     Gdiplus::SolidBrush* textBrush;       // 字体颜色
     unistring fontName;                   // 字体名字
@@ -745,7 +900,21 @@ public:
     bool fullscreen;                      // 是否全屏
 
     Gdiplus::Rect viewRect;               // 视口
-    std::vector<Gdiplus::Rect> clipStack; // 剪裁矩形堆栈
+    std::vector<detail::irect> clipStack; // 剪裁矩形堆栈，保存压入之前的剪裁（设备坐标）
+    bool clipChanged;                     // GDI+ 的剪裁需要同步
+    std::vector<render_target> targets;   // 离屏绘图目标堆栈
+
+    vgCanvas canvas;                      // 软件渲染画布
+    bool software;                        // 是否使用软件渲染
+    vgFrameStats stats;                   // 帧统计
+    int drawCalls;                        // 本帧的绘图调用数量
+    int culledCalls;                      // 本帧剔除的绘图调用数量
+    std::vector<vgLayer*> layers;         // 图层
+    int layerRedraws;                     // 本帧重新绘制的图层数量
+    double compositeTime;                 // 本帧合成图层的时间（毫秒）
+    bool tileDiff;                        // 分块比较帧内容
+    detail::frame_diff frameDiff;         // 上一帧的分块哈希
+    detail::damage_region presentRegion;  // 上一次显示复制的区域
 
     // 键盘事件
     VG_KEY_EVENT OnKeyDown;
@@ -784,13 +953,30 @@ public:
         g(),
         pixelbuf(),
         effectLevel(VG_MEDIUM),
+        blendMode(VG_BLEND_NORMAL),
+        imageFilter(VG_FILTER_AUTO),
         pen(),
         brush(),
+        gradientBrush(),
+        spriteAttributes(),
+        spriteColor(0xFFFFFFFF),
+        pointBrush(),
         font(),
         fontName(MINIVG_DEFAULT_FONT),
         fontSize(12.0f),
         fontStyle(VG_NORMAL),
 
+        clipChanged(false),
+
+        software(false),
+        stats(),
+        drawCalls(),
+        culledCalls(),
+        layers(),
+        layerRedraws(),
+        compositeTime(),
+        tileDiff(false),
+
         OnKeyDown(), OnKeyUp(), OnKeyPress(),
         OnMouseDown(), OnMouseUp(), OnMouseMove(),
         OnTimer(),
@@ -808,6 +994,11 @@ public:
 
     ~vgContext()
     {
+        // 图层的缓冲区是 GDI+ 图片，在关闭 GDI+ 之前释放
+        for (size_t i = 0; i < layers.size(); ++i) {
+            delete layers[i];
+        }
+        layers.clear();
         resource.dispose();
         gdiplusShutdown();
     }
@@ -882,15 +1073,245 @@ public:
             SelectObject(hdc, pixelbuf);
             g = new Gdiplus::Graphics(hdc);
             effect_level(effectLevel);
+            this->apply_transform();
+
+            // 软件渲染直接写 DIB 像素，DIB 是自底向上存储的
+            BITMAP bm;
+            GetObject(pixelbuf, sizeof(bm), &bm);
+            BYTE* bits = static_cast<BYTE*>(bm.bmBits) + (bm.bmHeight - 1) * bm.bmWidthBytes;
+            canvas.bind(bits, bm.bmWidth, bm.bmHeight, -bm.bmWidthBytes / 4);
         }
 
         viewRect = Gdiplus::Rect(x, y, width, height);
     }
 
     // 将缓冲区的图像绘制到目标 HDC
-    void bitblt(HDC dc)
+    // update 是系统要求重绘的区域（窗口坐标），只复制改变的区域时也要复制
+    void bitblt(HDC dc, const RECT* update = nullptr)
+    {
+        // 延迟绘制和多线程渲染的时候，先执行记录的绘图命令
+        canvas.flush();
+
+        const size_t full = size_t(viewRect.Width) * viewRect.Height * 4;
+        size_t bytes      = 0;
+        int count         = 0;
+        if (this->partial()) {
+            presentRegion.clear();
+            if (tileDiff) {
+                // GDI+ 和通过 graph_hdc() 绘制的内容先写到位图里面，再比较像素
+                if (g) {
+                    g->Flush(Gdiplus::FlushIntentionSync);
+                }
+                GdiFlush();
+                frameDiff.update(canvas.target(), presentRegion);
+            }
+            else {
+                for (size_t i = 0; i < canvas.damage_count(); ++i) {
+                    vgRect r = canvas.damage_rect(i);
+                    presentRegion.add(detail::irect(int(r.x), int(r.y), int(r.x + r.w), int(r.y + r.h)));
+                }
+            }
+            canvas.clear_damage();
+
+            if (update) {
+                detail::irect rc(update->left - viewRect.X, update->top - viewRect.Y, update->right - viewRect.X, update->bottom - viewRect.Y);
+                presentRegion.add(rc.intersect(detail::irect(0, 0, viewRect.Width, viewRect.Height)));
+            }
+
+            // 只复制改变的区域
+            const std::vector<detail::irect>& rects = presentRegion.rects();
+            for (size_t i = 0; i < rects.size(); ++i) {
+                const detail::irect& r = rects[i];
+                BitBlt(dc, viewRect.X + r.x1, viewRect.Y + r.y1, r.width(), r.height(), hdc, r.x1, r.y1, SRCCOPY);
+                bytes += size_t(r.area()) * 4;
+                ++count;
+            }
+        }
+        else {
+            BitBlt(dc, viewRect.X, viewRect.Y, viewRect.Width, viewRect.Height, hdc, 0, 0, SRCCOPY);
+            presentRegion.clear();
+            presentRegion.add(detail::irect(0, 0, viewRect.Width, viewRect.Height));
+            bytes = full;
+            count = 1;
+        }
+
+        ++stats.frames;
+        stats.damageRects = count;
+        stats.blitBytes   = bytes;
+        stats.fullBytes   = full;
+        stats.totalBlitBytes += double(bytes);
+        stats.totalFullBytes += double(full);
+        stats.drawCalls     = drawCalls;
+        stats.culledCalls   = culledCalls;
+        stats.layerRedraws  = layerRedraws;
+        stats.compositeTime = compositeTime;
+        drawCalls     = 0;
+        culledCalls   = 0;
+        layerRedraws  = 0;
+        compositeTime = 0.0;
+    }
+
+    /* 剔除测试，在绘图之前调用
+     * box              绘图坐标的保守包围盒
+     * margin           包围盒向外扩展的距离（描边的宽度）
+     * 变换以后的包围盒和剪裁矩形不相交的时候返回 true，图形不需要绘制。抗锯齿的边缘按 1 像素计算。
+     */
+    bool culled(const AABB& box, float margin = 0.0f)
     {
-        BitBlt(dc, viewRect.X, viewRect.Y, viewRect.Width, viewRect.Height, hdc, 0, 0, SRCCOPY);
+        ++drawCalls;
+        vgRect r(box.x1 - margin, box.y1 - margin, box.width() + margin * 2.0f, box.height() + margin * 2.0f);
+        if (!canvas.transform().is_identity()) {
+            r = canvas.transform().transform(r);
+        }
+        const vgRect clip = canvas.cliprect();
+        if (!canvas.clip().empty() && r.x + r.w + 1.0f > clip.x && r.y + r.h + 1.0f > clip.y && r.x - 1.0f < clip.x + clip.w && r.y - 1.0f < clip.y + clip.h) {
+            // GDI+ 绘制的图形不经过画布，按变换以后的包围盒记录脏矩形
+            if (!software && this->tracking()) {
+                this->damage(r);
+            }
+            return false;
+        }
+        ++culledCalls;
+        return true;
+    }
+
+    // 矩形的剔除测试，宽高可以是负数（镜像绘制的图片）
+    bool culled(float x, float y, float width, float height, float margin = 0.0f)
+    {
+        AABB box;
+        box.append(x, y);
+        box.append(x + width, y + height);
+        return this->culled(box, margin);
+    }
+
+    // 点集的剔除测试
+    bool culled(const vec2f* points, size_t size, float margin = 0.0f)
+    {
+        AABB box;
+        for (size_t i = 0; i < size; ++i) {
+            box.append(points[i]);
+        }
+        return this->culled(box, margin);
+    }
+
+    // 精灵的剔除测试，用精灵矩阵变换源矩形得到绘图坐标的范围
+    bool culled(const vgSprite& sprite)
+    {
+        vgRect r = sprite.matrix().transform(vgRect(0.0f, 0.0f, sprite.source.w, sprite.source.h));
+        return this->culled(r.x, r.y, r.w, r.h);
+    }
+
+    // 开启了脏矩形跟踪。软件渲染由画布记录每个绘图命令的范围，GDI+ 由 culled() 记录图形的包围盒
+    bool tracking() const
+    {
+        return canvas.damage_tracking();
+    }
+
+    // 填充使用的画刷
+    Gdiplus::Brush* fill_brush() const
+    {
+        return gradientBrush ? gradientBrush : static_cast<Gdiplus::Brush*>(brush);
+    }
+
+    /* 精灵的透明度和着色，所有精灵共用一个 ImageAttributes，颜色改变的时候才更新颜色矩阵
+     * 不需要调制的时候返回空
+     */
+    Gdiplus::ImageAttributes* sprite_attributes(float alpha, uint32_t tint)
+    {
+        uint32_t a     = alpha > 0.0f ? static_cast<uint32_t>(std::min(alpha, 1.0f) * (tint >> 24) + 0.5f) : 0;
+        uint32_t color = (a << 24) | (tint & 0x00FFFFFF);
+        if (color == 0xFFFFFFFF) {
+            return nullptr;
+        }
+        if (!spriteAttributes) {
+            spriteAttributes = new Gdiplus::ImageAttributes();
+            spriteColor      = 0xFFFFFFFF;
+        }
+        if (color != spriteColor) {
+            Gdiplus::ColorMatrix cm = {
+                ((color >> 16) & 0xFF) / 255.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+                0.0f, ((color >> 8) & 0xFF) / 255.0f, 0.0f, 0.0f, 0.0f,
+                0.0f, 0.0f, (color & 0xFF) / 255.0f, 0.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, (color >> 24) / 255.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+            };
+            spriteAttributes->SetColorMatrix(&cm);
+            spriteColor = color;
+        }
+        return spriteAttributes;
+    }
+
+    // 显示的时候只复制改变的区域
+    bool partial() const
+    {
+        return tileDiff || this->tracking();
+    }
+
+    // 标记 GDI+ 绘制的区域（软件渲染模式下，文字和其他格式的图片仍然由 GDI+ 绘制）
+    void invalidate(const Gdiplus::RectF& rect)
+    {
+        if (this->tracking()) {
+            // GDI+ 绘制的范围是绘图坐标，转换成设备坐标
+            this->damage(canvas.transform().transform(vgRect(rect.X, rect.Y, rect.Width, rect.Height)));
+        }
+    }
+
+    // 标记设备坐标的改变区域，抗锯齿的边缘按 1 像素计算，只记录剪裁矩形以内的部分
+    void damage(const vgRect& r)
+    {
+        detail::irect rc(int(floor(r.x)) - 1, int(floor(r.y)) - 1, int(ceil(r.x + r.w)) + 1, int(ceil(r.y + r.h)) + 1);
+        rc = rc.intersect(canvas.clip());
+        if (!rc.empty()) {
+            canvas.invalidate(rc.x1, rc.y1, rc.width(), rc.height());
+        }
+    }
+
+    // GDI+ 使用和软件渲染相同的变换
+    void apply_transform()
+    {
+        if (g) {
+            const vgMatrix& m = canvas.transform();
+            Gdiplus::Matrix mat(m.a, m.b, m.c, m.d, m.tx, m.ty);
+            g->SetTransform(&mat);
+        }
+    }
+
+    /* 设置剪裁矩形（设备坐标），画布直接用整数矩形剪裁扫描线。
+     * 软件渲染只有文字使用 GDI+，等到画文字的时候再同步 GDI+ 的剪裁
+     */
+    void set_clip(const detail::irect& rect)
+    {
+        canvas.cliprect(rect);
+        clipChanged = true;
+        if (!software) {
+            this->sync_clip();
+        }
+    }
+
+    // GDI+ 的剪裁矩形会被变换，这里按设备坐标设置，和软件渲染一样不受变换影响
+    void sync_clip()
+    {
+        if (g && clipChanged) {
+            const detail::irect& clip = canvas.clip();
+            g->ResetTransform();
+            g->SetClip(Gdiplus::Rect(clip.x1, clip.y1, clip.width(), clip.height()));
+            this->apply_transform();
+            clipChanged = false;
+        }
+    }
+
+    /* 重绘窗口
+     * 跟踪脏矩形的时候只发送内部重绘消息，不使整个窗口无效，
+     * 这时候的更新区域只包含系统要求重绘的部分（比如被遮挡的窗口重新显示）。
+     */
+    void repaint()
+    {
+        if (this->partial()) {
+            RedrawWindow(m_handle, nullptr, nullptr, RDW_INTERNALPAINT | RDW_UPDATENOW);
+        }
+        else {
+            vgWindow::repaint();
+        }
     }
 
     // 设置窗口置顶
@@ -1004,10 +1425,11 @@ protected:
     {
         Gdiplus::GdiplusStartup(&token, &input, nullptr);
 
-        pen       = new Gdiplus::Pen(Gdiplus::Color::Black);
-        brush     = new Gdiplus::SolidBrush(Gdiplus::Color::White);
-        font      = new Gdiplus::Font(fontName.c_str(), fontSize, Gdiplus::FontStyleRegular, Gdiplus::UnitPoint, nullptr);
-        textBrush = new Gdiplus::SolidBrush(Gdiplus::Color::Black);
+        pen        = new Gdiplus::Pen(Gdiplus::Color::Black);
+        brush      = new Gdiplus::SolidBrush(Gdiplus::Color::White);
+        pointBrush = new Gdiplus::SolidBrush(Gdiplus::Color::Black);
+        font       = new Gdiplus::Font(fontName.c_str(), fontSize, Gdiplus::FontStyleRegular, Gdiplus::UnitPoint, nullptr);
+        textBrush  = new Gdiplus::SolidBrush(Gdiplus::Color::Black);
 
         hdc = CreateCompatibleDC(nullptr);
     }
@@ -1020,6 +1442,9 @@ protected:
         delete_object(hdc);
         safe_delete(pen);
         safe_delete(brush);
+        safe_delete(gradientBrush);
+        safe_delete(spriteAttributes);
+        safe_delete(pointBrush);
         safe_delete(font);
         safe_delete(textBrush);
 
@@ -1033,7 +1458,15 @@ protected:
         BeginPaint(m_handle, &ps);
         if (OnPaint)
             OnPaint();
-        this->bitblt(ps.hdc);
+        if (this->partial()) {
+            // 系统要求重绘的区域也要复制。ps.hdc 只能绘制更新区域，所以使用窗口 DC
+            HDC dc = GetDC(m_handle);
+            this->bitblt(dc, &ps.rcPaint);
+            ReleaseDC(m_handle, dc);
+        }
+        else {
+            this->bitblt(ps.hdc);
+        }
         EndPaint(m_handle, &ps);
     }
 };
@@ -1075,6 +1508,90 @@ MINIVG_INLINE void WINAPI updateThread(void* arg)
     // timeEndPeriod(1); // 结束高精度计时
 }
 
+// 使用展平的折线创建 GDI+ 路径
+MINIVG_INLINE void make_path(const vgPath& path, Gdiplus::GraphicsPath& out)
+{
+    path.flatten();
+    const std::vector<vec2f>& points      = path.flat_points();
+    const std::vector<uint32_t>& contours = path.flat_contours();
+    const std::vector<uint8_t>& closed    = path.flat_closed();
+
+    out.SetFillMode(path.fill_rule() == VG_NONZERO ? Gdiplus::FillModeWinding : Gdiplus::FillModeAlternate);
+    size_t first = 0;
+    for (size_t i = 0; i < contours.size(); ++i) {
+        out.StartFigure();
+        out.AddLines(reinterpret_cast<const Gdiplus::PointF*>(&points[first]), static_cast<int>(contours[i]));
+        if (closed[i]) {
+            out.CloseFigure();
+        }
+        first += contours[i];
+    }
+}
+
+// 创建渐变画刷，GDI+ 没有的功能使用相近的效果
+MINIVG_INLINE Gdiplus::Brush* make_gradient_brush(const vgGradient& gradient)
+{
+    const std::vector<vgGradient::stop>& stops = gradient.stops();
+    if (stops.empty()) {
+        return new Gdiplus::SolidBrush(Gdiplus::Color(0, 0, 0, 0));
+    }
+
+    // 插值颜色的位置必须从 0 开始，到 1 结束
+    std::vector<Gdiplus::Color> colors;
+    std::vector<Gdiplus::REAL> positions;
+    if (stops.front().offset > 0.0f) {
+        colors.push_back(Gdiplus::Color(stops.front().color.a, stops.front().color.r, stops.front().color.g, stops.front().color.b));
+        positions.push_back(0.0f);
+    }
+    for (size_t i = 0; i < stops.size(); ++i) {
+        colors.push_back(Gdiplus::Color(stops[i].color.a, stops[i].color.r, stops[i].color.g, stops[i].color.b));
+        positions.push_back(stops[i].offset);
+    }
+    if (stops.back().offset < 1.0f) {
+        colors.push_back(colors.back());
+        positions.push_back(1.0f);
+    }
+    const int count = static_cast<int>(colors.size());
+
+    switch (gradient.type()) {
+    case VG_GRADIENT_LINEAR: {
+        const vec2f& a = gradient.start();
+        const vec2f& b = gradient.end();
+        if (a.x == b.x && a.y == b.y) {
+            break;
+        }
+        Gdiplus::LinearGradientBrush* brush = new Gdiplus::LinearGradientBrush(
+            Gdiplus::PointF(a.x, a.y), Gdiplus::PointF(b.x, b.y), colors.front(), colors.back());
+        brush->SetInterpolationColors(&colors[0], &positions[0], count);
+        brush->SetWrapMode(gradient.spread() == VG_SPREAD_REFLECT ? Gdiplus::WrapModeTileFlipXY : Gdiplus::WrapModeTile);
+        return brush;
+    }
+    case VG_GRADIENT_RADIAL: {
+        const vec2f& o = gradient.center();
+        const float r  = gradient.radius();
+        if (!(r > 0.0f)) {
+            return new Gdiplus::SolidBrush(colors.back());
+        }
+        Gdiplus::GraphicsPath path;
+        path.AddEllipse(o.x - r, o.y - r, r * 2.0f, r * 2.0f);
+        Gdiplus::PathGradientBrush* brush = new Gdiplus::PathGradientBrush(&path);
+        brush->SetCenterPoint(Gdiplus::PointF(o.x, o.y));
+
+        // 路径渐变的位置 0 是边界，1 是中心
+        std::reverse(colors.begin(), colors.end());
+        std::reverse(positions.begin(), positions.end());
+        for (int i = 0; i < count; ++i) {
+            positions[i] = 1.0f - positions[i];
+        }
+        brush->SetInterpolationColors(&colors[0], &positions[0], count);
+        return brush;
+    }
+    default:
+        break;
+    }
+    return new Gdiplus::SolidBrush(colors.front());
+}
+
 } // end namespace detail
 
 //---------------------------------------------------------------------------
@@ -1092,6 +1609,7 @@ initgraph(const unistring& title, int width, int height, int param)
 
     // 创建缓冲区模式
     if (param & VG_BACKBUFFER) {
+        detail::instance().software = (param & VG_SOFTWARE) != 0;
         detail::instance().viewport(0, 0, width, height);
         detail::instance().winRect.left   = 0;
         detail::instance().winRect.top    = 0;
@@ -1387,6 +1905,12 @@ MINIVG_INLINE Gdiplus::Graphics* graphics()
     return detail::instance().g;
 }
 
+// 获取软件渲染画布
+MINIVG_INLINE vgCanvas* graph_canvas()
+{
+    return detail::instance().software ? &detail::instance().canvas : nullptr;
+}
+
 // 设置视口显示范围 (宽高改变会重设背景缓冲区大小)
 MINIVG_INLINE void viewport(int x, int y, int width, int height)
 {
@@ -1411,42 +1935,86 @@ MINIVG_INLINE int view_height()
     return bm.bmHeight;
 }
 
+// 设置变换
+MINIVG_INLINE void transform(const vgMatrix& m)
+{
+    detail::instance().canvas.transform(m);
+    detail::instance().apply_transform();
+}
+
+// 返回当前变换
+MINIVG_INLINE vgMatrix transform()
+{
+    return detail::instance().canvas.transform();
+}
+
+// 重置变换
+MINIVG_INLINE void reset_transform()
+{
+    detail::instance().canvas.reset_transform();
+    detail::instance().apply_transform();
+}
+
+// 保存当前变换
+MINIVG_INLINE void push_transform()
+{
+    detail::instance().canvas.push_transform();
+}
+
+// 恢复上一次保存的变换
+MINIVG_INLINE void pop_transform()
+{
+    detail::instance().canvas.pop_transform();
+    detail::instance().apply_transform();
+}
+
+// 平移
+MINIVG_INLINE void translate(float x, float y)
+{
+    detail::instance().canvas.translate(x, y);
+    detail::instance().apply_transform();
+}
+
+// 旋转
+MINIVG_INLINE void rotate(float angle)
+{
+    detail::instance().canvas.rotate(angle);
+    detail::instance().apply_transform();
+}
+
+// 缩放
+MINIVG_INLINE void scale(float x, float y)
+{
+    detail::instance().canvas.scale(x, y);
+    detail::instance().apply_transform();
+}
+
 // 设置剪裁矩形
 MINIVG_INLINE void cliprect(int x, int y, int width, int height)
 {
-    if (detail::instance().g)
-        detail::instance().g->SetClip(Gdiplus::Rect(x, y, width, height));
+    detail::instance().set_clip(detail::irect(x, y, x + width, y + height));
 }
 
-// 压入剪裁矩形
+// 压入剪裁矩形，和当前剪裁求交集，空的剪裁也要压入，保证弹出的时候恢复正确
 MINIVG_INLINE void push_cliprect(int x, int y, int width, int height)
 {
-    if (detail::instance().g) {
-        if (detail::instance().g->IsClipEmpty()) {
-            // 如果是空则不添加
-        }
-        else {
-            Gdiplus::Rect rect;
-            detail::instance().g->GetClipBounds(&rect);
-            detail::instance().clipStack.push_back(rect);
-        }
-        detail::instance().g->SetClip(Gdiplus::Rect(x, y, width, height));
-    }
+    detail::vgContext& vg = detail::instance();
+    vg.clipStack.push_back(vg.canvas.clip());
+    vg.set_clip(vg.canvas.clip().intersect(detail::irect(x, y, x + width, y + height)));
 }
 
 // 弹出剪裁矩形
 MINIVG_INLINE void pop_cliprect()
 {
-    if (detail::instance().g) {
-        if (!detail::instance().clipStack.empty()) {
-            Gdiplus::Rect rect = detail::instance().clipStack.back();
-            detail::instance().clipStack.pop_back();
-            detail::instance().g->SetClip(rect);
-        }
-        else {
-            // 如果是空，则重置剪裁
-            detail::instance().g->ResetClip();
-        }
+    detail::vgContext& vg = detail::instance();
+    if (!vg.clipStack.empty()) {
+        detail::irect rect = vg.clipStack.back();
+        vg.clipStack.pop_back();
+        vg.set_clip(rect);
+    }
+    else {
+        // 如果是空，则重置剪裁
+        vg.set_clip(detail::irect(0, 0, vg.canvas.width(), vg.canvas.height()));
     }
 }
 
@@ -1485,6 +2053,95 @@ MINIVG_INLINE void set_graphics_effect_level(Gdiplus::Graphics* g, int level)
     }
 }
 
+// 图片缩放滤波器对应的插值模式，VG_FILTER_AUTO 保持显示质量的设置
+MINIVG_INLINE void set_graphics_image_filter(Gdiplus::Graphics* g, int filter)
+{
+    switch (filter) {
+    case VG_FILTER_NEAREST:
+        g->SetInterpolationMode(Gdiplus::InterpolationModeNearestNeighbor);
+        break;
+    case VG_FILTER_BILINEAR:
+        g->SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBilinear);
+        break;
+    case VG_FILTER_BICUBIC:
+    case VG_FILTER_LANCZOS:
+        g->SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBicubic);
+        break;
+    default:
+        break;
+    }
+}
+
+// 设置软件渲染线程数量
+MINIVG_INLINE void render_threads(int count)
+{
+    detail::instance().canvas.threads(count);
+}
+
+// 设置延迟绘制
+MINIVG_INLINE void deferred_mode(bool enable)
+{
+    detail::instance().canvas.deferred(enable);
+}
+
+// 执行记录的绘图命令
+MINIVG_INLINE void flush()
+{
+    detail::instance().canvas.flush();
+}
+
+// 开启脏矩形跟踪
+MINIVG_INLINE void damage_tracking(bool enable)
+{
+    detail::instance().canvas.damage_tracking(enable);
+}
+
+// 标记改变的区域
+MINIVG_INLINE void invalidate(int x, int y, int width, int height)
+{
+    detail::instance().canvas.invalidate(x, y, width, height);
+}
+
+// 返回本帧的脏矩形
+MINIVG_INLINE int damage_rects(vgRect* rects, int size)
+{
+    const vgCanvas& canvas = detail::instance().canvas;
+    const int count        = static_cast<int>(canvas.damage_count());
+    if (rects) {
+        for (int i = 0; i < count && i < size; ++i) {
+            rects[i] = canvas.damage_rect(i);
+        }
+    }
+    return count;
+}
+
+// 开启分块比较
+MINIVG_INLINE void tile_diff(bool enable)
+{
+    detail::instance().tileDiff = enable;
+    detail::instance().frameDiff.reset();
+}
+
+// 返回上一次显示复制的区域
+MINIVG_INLINE int presented_rects(vgRect* rects, int size)
+{
+    const std::vector<detail::irect>& list = detail::instance().presentRegion.rects();
+    const int count                        = static_cast<int>(list.size());
+    if (rects) {
+        for (int i = 0; i < count && i < size; ++i) {
+            const detail::irect& r = list[i];
+            rects[i] = vgRect(float(r.x1), float(r.y1), float(r.width()), float(r.height()));
+        }
+    }
+    return count;
+}
+
+// 返回帧统计
+MINIVG_INLINE vgFrameStats frame_stats()
+{
+    return detail::instance().stats;
+}
+
 // 设置显示质量
 MINIVG_INLINE int effect_level(int level)
 {
@@ -1493,11 +2150,51 @@ MINIVG_INLINE int effect_level(int level)
         return -1;
     }
     set_graphics_effect_level(g, level);
+    set_graphics_image_filter(g, detail::instance().imageFilter);
+    if (detail::instance().blendMode == VG_BLEND_COPY) {
+        g->SetCompositingMode(Gdiplus::CompositingModeSourceCopy);
+    }
+    detail::instance().canvas.effect_level(level);
     detail::instance().effectLevel = level;
 
     return 0;
 }
 
+// 设置混合模式
+MINIVG_INLINE int blend_mode(int mode)
+{
+    detail::vgContext& context = detail::instance();
+    int last                   = context.blendMode;
+    context.canvas.blend_mode(mode);
+    context.blendMode = context.canvas.blend_mode();
+    if (context.g) {
+        context.g->SetCompositingMode(context.blendMode == VG_BLEND_COPY ?
+            Gdiplus::CompositingModeSourceCopy : Gdiplus::CompositingModeSourceOver);
+    }
+    return last;
+}
+
+// 设置图片缩放滤波器
+MINIVG_INLINE int image_filter(int filter)
+{
+    detail::vgContext& context = detail::instance();
+    int last                   = context.imageFilter;
+    context.canvas.image_filter(filter);
+    context.imageFilter = context.canvas.image_filter();
+    if (context.g) {
+        if (context.imageFilter == VG_FILTER_AUTO) {
+            set_graphics_effect_level(context.g, context.effectLevel);
+            if (context.blendMode == VG_BLEND_COPY) {
+                context.g->SetCompositingMode(Gdiplus::CompositingModeSourceCopy);
+            }
+        }
+        else {
+            set_graphics_image_filter(context.g, context.imageFilter);
+        }
+    }
+    return last;
+}
+
 /* 设置帧率
  */
 MINIVG_INLINE void set_fps(int value)
@@ -1516,8 +2213,12 @@ MINIVG_INLINE int fps()
 // 清屏
 MINIVG_INLINE void clear(BYTE r, BYTE g, BYTE b, BYTE a)
 {
-    if (detail::instance().g)
+    if (detail::instance().software)
+        detail::instance().canvas.clear(r, g, b, a);
+    else if (detail::instance().g) {
         detail::instance().g->Clear(Gdiplus::Color(a, r, g, b));
+        detail::instance().damage(detail::instance().canvas.cliprect());
+    }
 }
 
 // 获取画笔颜色
@@ -1534,20 +2235,29 @@ MINIVG_INLINE vec4ub pen_color()
 // 设置画笔颜色
 MINIVG_INLINE void pen_color(BYTE r, BYTE g, BYTE b, BYTE a)
 {
+    detail::instance().canvas.pen_color(r, g, b, a);
     if (detail::instance().pen)
         detail::instance().pen->SetColor(Gdiplus::Color(a, r, g, b));
+    if (detail::instance().pointBrush)
+        detail::instance().pointBrush->SetColor(Gdiplus::Color(a, r, g, b));
 }
 
 MINIVG_INLINE void pen_color(COLORREF argb)
 {
+    detail::instance().canvas.pen_color(BYTE(argb >> 16), BYTE(argb >> 8), BYTE(argb), BYTE(argb >> 24));
     if (detail::instance().pen)
         detail::instance().pen->SetColor(Gdiplus::Color(argb));
+    if (detail::instance().pointBrush)
+        detail::instance().pointBrush->SetColor(Gdiplus::Color(argb));
 }
 
 MINIVG_INLINE void pen_color(vec4ub rgba)
 {
+    detail::instance().canvas.pen_color(rgba.r, rgba.g, rgba.b, rgba.a);
     if (detail::instance().pen)
         detail::instance().pen->SetColor(Gdiplus::Color(rgba.a, rgba.r, rgba.g, rgba.b));
+    if (detail::instance().pointBrush)
+        detail::instance().pointBrush->SetColor(Gdiplus::Color(rgba.a, rgba.r, rgba.g, rgba.b));
 }
 
 // 获取画笔宽度
@@ -1559,6 +2269,7 @@ MINIVG_INLINE float pen_width()
 // 设置画笔宽度
 MINIVG_INLINE void pen_width(float width)
 {
+    detail::instance().canvas.pen_width(width);
     if (detail::instance().pen)
         detail::instance().pen->SetWidth(width);
 }
@@ -1578,6 +2289,33 @@ MINIVG_INLINE void pen_style(int mode)
     if (detail::instance().pen) {
         detail::instance().pen->SetDashStyle(static_cast<Gdiplus::DashStyle>(mode));
     }
+
+    // 和 GDI+ 的预设虚线一致
+    static const float dash[]         = { 3.0f, 1.0f };
+    static const float dot[]          = { 1.0f, 1.0f };
+    static const float dash_dot[]     = { 3.0f, 1.0f, 1.0f, 1.0f };
+    static const float dash_dot_dot[] = { 3.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+    vgCanvas& canvas = detail::instance().canvas;
+    switch (mode) {
+    case VG_SOLID:
+        canvas.dash_pattern(NULL, 0);
+        break;
+    case VG_DASH:
+        canvas.dash_pattern(dash, 2);
+        break;
+    case VG_DOT:
+        canvas.dash_pattern(dot, 2);
+        break;
+    case VG_DASH_DOT:
+        canvas.dash_pattern(dash_dot, 4);
+        break;
+    case VG_DASH_DOT_DOT:
+        canvas.dash_pattern(dash_dot_dot, 6);
+        break;
+    default:
+        break;
+    }
 }
 
 // 设置点画模图案样式
@@ -1586,13 +2324,33 @@ MINIVG_INLINE void dash_style(const float* dash, int size)
     if (detail::instance().pen) {
         detail::instance().pen->SetDashPattern(dash, size);
     }
+    detail::instance().canvas.dash_pattern(dash, size > 0 ? size_t(size) : 0);
 }
 
-// 获取填充颜色
-MINIVG_INLINE vec4ub fill_color()
+// 设置拐角样式
+MINIVG_INLINE void line_join(int join)
 {
-    if (detail::instance().brush) {
-        Gdiplus::Color color;
+    if (detail::instance().pen) {
+        detail::instance().pen->SetLineJoin(static_cast<Gdiplus::LineJoin>(join));
+    }
+    detail::instance().canvas.line_join(join);
+}
+
+// 设置线帽样式
+MINIVG_INLINE void line_cap(int cap)
+{
+    if (detail::instance().pen) {
+        detail::instance().pen->SetLineCap(static_cast<Gdiplus::LineCap>(cap),
+            static_cast<Gdiplus::LineCap>(cap), Gdiplus::DashCapFlat);
+    }
+    detail::instance().canvas.line_cap(cap);
+}
+
+// 获取填充颜色
+MINIVG_INLINE vec4ub fill_color()
+{
+    if (detail::instance().brush) {
+        Gdiplus::Color color;
         detail::instance().brush->GetColor(&color);
         return vec4ub(color.GetR(), color.GetG(), color.GetB(), color.GetA());
     }
@@ -1602,34 +2360,50 @@ MINIVG_INLINE vec4ub fill_color()
 // 设置填充颜色
 MINIVG_INLINE void fill_color(BYTE r, BYTE g, BYTE b, BYTE a)
 {
+    detail::instance().canvas.fill_color(r, g, b, a);
+    detail::safe_delete(detail::instance().gradientBrush);
     if (detail::instance().brush)
         detail::instance().brush->SetColor(Gdiplus::Color(a, r, g, b));
 }
 
 MINIVG_INLINE void fill_color(COLORREF argb)
 {
+    detail::instance().canvas.fill_color(BYTE(argb >> 16), BYTE(argb >> 8), BYTE(argb), BYTE(argb >> 24));
+    detail::safe_delete(detail::instance().gradientBrush);
     if (detail::instance().brush)
         detail::instance().brush->SetColor(Gdiplus::Color(argb));
 }
 
 MINIVG_INLINE void fill_color(vec4ub rgba)
 {
+    detail::instance().canvas.fill_color(rgba.r, rgba.g, rgba.b, rgba.a);
+    detail::safe_delete(detail::instance().gradientBrush);
     if (detail::instance().brush)
         detail::instance().brush->SetColor(Gdiplus::Color(rgba.a, rgba.r, rgba.g, rgba.b));
 }
 
+// 使用渐变填充
+MINIVG_INLINE void fill_gradient(const vgGradient& gradient)
+{
+    detail::vgContext& vg = detail::instance();
+    vg.canvas.fill_gradient(gradient);
+    detail::safe_delete(vg.gradientBrush);
+    vg.gradientBrush = detail::make_gradient_brush(gradient);
+}
+
 // 绘制一个点
 MINIVG_INLINE void draw_point(float x, float y, float size)
 {
-    if (detail::instance().g) {
-        // 获取画笔颜色
-        Gdiplus::Color color;
-        detail::instance().pen->GetColor(&color);
-        // 创建画刷
-        Gdiplus::SolidBrush brush(color);
-        // 绘制圆
-        float half = size * 0.5f;
-        detail::instance().g->FillEllipse(&brush, x - half, y - half, size, size);
+    float half = size * 0.5f;
+    if (detail::instance().culled(x - half, y - half, size, size)) {
+        return;
+    }
+    if (detail::instance().software) {
+        detail::instance().canvas.draw_point(x, y, size);
+    }
+    else if (detail::instance().g) {
+        // 画刷颜色和画笔同步设置，不用每次创建
+        detail::instance().g->FillEllipse(detail::instance().pointBrush, x - half, y - half, size, size);
     }
 }
 
@@ -1641,27 +2415,54 @@ MINIVG_INLINE void draw_point(float x, float y)
 // 绘制线段
 MINIVG_INLINE void draw_line(float x1, float y1, float x2, float y2)
 {
-    if (detail::instance().g)
+    if (detail::instance().culled(x1, y1, x2 - x1, y2 - y1, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.draw_line(x1, y1, x2, y2);
+    else if (detail::instance().g)
         detail::instance().g->DrawLine(detail::instance().pen, x1, y1, x2, y2);
 }
 
 // 绘制一个空心矩形
 MINIVG_INLINE void draw_rect(float x, float y, float width, float height)
 {
-    if (detail::instance().g)
+    if (detail::instance().culled(x, y, width, height, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.draw_rect(x, y, width, height);
+    else if (detail::instance().g)
         detail::instance().g->DrawRectangle(detail::instance().pen, x, y, width, height);
 }
 
 // 填充一个矩形
 MINIVG_INLINE void fill_rect(float x, float y, float width, float height)
 {
-    if (detail::instance().g)
-        detail::instance().g->FillRectangle(detail::instance().brush, x, y, width, height);
+    if (detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.fill_rect(x, y, width, height);
+    else if (detail::instance().g)
+        detail::instance().g->FillRectangle(detail::instance().fill_brush(), x, y, width, height);
 }
 
 // 绘制圆角矩形
 MINIVG_INLINE void draw_roundrect(float x, float y, float width, float height, float cx, float cy)
 {
+    if (detail::instance().culled(x, y, width, height, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.draw_roundrect(x, y, width, height, cx, cy);
+        return;
+    }
+
     cx *= 2.0f;
     cy *= 2.0f;
 
@@ -1688,6 +2489,15 @@ MINIVG_INLINE void draw_roundrect(float x, float y, float width, float height, f
 // 填充圆角矩形
 MINIVG_INLINE void fill_roundrect(float x, float y, float width, float height, float cx, float cy)
 {
+    if (detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.fill_roundrect(x, y, width, height, cx, cy);
+        return;
+    }
+
     cx *= 2.0f;
     cy *= 2.0f;
 
@@ -1707,34 +2517,58 @@ MINIVG_INLINE void fill_roundrect(float x, float y, float width, float height, f
         path.AddArc(x2, y2, cx, cy, 0, 90);
         path.AddArc(x, y2, cx, cy, 90, 90);
         path.CloseFigure();
-        g->FillPath(detail::instance().brush, &path);
+        g->FillPath(detail::instance().fill_brush(), &path);
     }
 }
 
 // 绘制椭圆
 MINIVG_INLINE void draw_ellipse(float ox, float oy, float rx, float ry)
 {
-    if (detail::instance().g)
+    if (detail::instance().culled(ox - rx, oy - ry, rx * 2.0f, ry * 2.0f, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.draw_ellipse(ox, oy, rx, ry);
+    else if (detail::instance().g)
         detail::instance().g->DrawEllipse(detail::instance().pen, ox - rx, oy - ry, rx * 2.0f, ry * 2.0f);
 }
 
 MINIVG_INLINE void draw_ellipse_r(float x, float y, float width, float height)
 {
-    if (detail::instance().g)
+    if (detail::instance().culled(x, y, width, height, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.draw_ellipse(x + width * 0.5f, y + height * 0.5f, width * 0.5f, height * 0.5f);
+    else if (detail::instance().g)
         detail::instance().g->DrawEllipse(detail::instance().pen, x, y, width, height);
 }
 
 // 填充椭圆
 MINIVG_INLINE void fill_ellipse(float ox, float oy, float rx, float ry)
 {
-    if (detail::instance().g)
-        detail::instance().g->FillEllipse(detail::instance().brush, ox - rx, oy - ry, rx * 2.0f, ry * 2.0f);
+    if (detail::instance().culled(ox - rx, oy - ry, rx * 2.0f, ry * 2.0f)) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.fill_ellipse(ox, oy, rx, ry);
+    else if (detail::instance().g)
+        detail::instance().g->FillEllipse(detail::instance().fill_brush(), ox - rx, oy - ry, rx * 2.0f, ry * 2.0f);
 }
 
 MINIVG_INLINE void fill_ellipse_r(float x, float y, float width, float height)
 {
-    if (detail::instance().g)
-        detail::instance().g->FillEllipse(detail::instance().brush, x, y, width, height);
+    if (detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
+    if (detail::instance().software)
+        detail::instance().canvas.fill_ellipse(x + width * 0.5f, y + height * 0.5f, width * 0.5f, height * 0.5f);
+    else if (detail::instance().g)
+        detail::instance().g->FillEllipse(detail::instance().fill_brush(), x, y, width, height);
 }
 
 // 绘制空心圆，xy 为圆心
@@ -1752,7 +2586,14 @@ MINIVG_INLINE void fill_circle(float x, float y, float r)
 // 绘制连续的线段
 MINIVG_INLINE void draw_polyline(const vec2f* points, size_t size)
 {
-    if (detail::instance().g) {
+    if (detail::instance().culled(points, size, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.draw_polyline(points, size);
+    }
+    else if (detail::instance().g) {
         detail::instance().g->DrawLines(
             detail::instance().pen, reinterpret_cast<const Gdiplus::PointF*>(points), static_cast<int>(size)
         );
@@ -1762,7 +2603,14 @@ MINIVG_INLINE void draw_polyline(const vec2f* points, size_t size)
 // 绘制多边形
 MINIVG_INLINE void draw_polygon(const vec2f* points, size_t size)
 {
-    if (detail::instance().g) {
+    if (detail::instance().culled(points, size, detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.draw_polygon(points, size);
+    }
+    else if (detail::instance().g) {
         detail::instance().g->DrawPolygon(
             detail::instance().pen, reinterpret_cast<const Gdiplus::PointF*>(points), static_cast<int>(size)
         );
@@ -1772,13 +2620,140 @@ MINIVG_INLINE void draw_polygon(const vec2f* points, size_t size)
 // 填充多边形
 MINIVG_INLINE void fill_polygon(const vec2f* points, size_t size)
 {
-    if (detail::instance().g) {
+    if (detail::instance().culled(points, size)) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.fill_polygon(points, size);
+    }
+    else if (detail::instance().g) {
         detail::instance().g->FillPolygon(
-            detail::instance().brush, reinterpret_cast<const Gdiplus::PointF*>(points), static_cast<int>(size)
+            detail::instance().fill_brush(), reinterpret_cast<const Gdiplus::PointF*>(points), static_cast<int>(size)
         );
     }
 }
 
+// 批量填充矩形
+MINIVG_INLINE void fill_rects(const vgRect* rects, const vec4ub* colors, size_t size)
+{
+    detail::vgContext& vg = detail::instance();
+
+    // 批量绘制按一次调用剔除，单个图元交给后端处理
+    AABB box;
+    for (size_t i = 0; i < size; ++i) {
+        box.append(rects[i].x, rects[i].y);
+        box.append(rects[i].x + rects[i].w, rects[i].y + rects[i].h);
+    }
+    if (vg.culled(box)) {
+        return;
+    }
+
+    if (vg.software) {
+        vg.canvas.fill_rects(rects, colors, size);
+    }
+    else if (vg.g) {
+        if (!colors) {
+            vg.g->FillRectangles(vg.fill_brush(), reinterpret_cast<const Gdiplus::RectF*>(rects), static_cast<int>(size));
+            return;
+        }
+        Gdiplus::SolidBrush brush(Gdiplus::Color::White);
+        for (size_t i = 0; i < size; ++i) {
+            brush.SetColor(Gdiplus::Color(colors[i].a, colors[i].r, colors[i].g, colors[i].b));
+            vg.g->FillRectangle(&brush, rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        }
+    }
+}
+
+// 批量绘制线段
+MINIVG_INLINE void draw_lines(const vec2f* points, size_t size, const vec4ub* colors)
+{
+    detail::vgContext& vg = detail::instance();
+    if (vg.culled(points, size, vg.canvas.stroke_extent())) {
+        return;
+    }
+
+    if (vg.software) {
+        vg.canvas.draw_lines(points, size, colors);
+    }
+    else if (vg.g) {
+        Gdiplus::Pen* pen = colors ? vg.pen->Clone() : vg.pen;
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            if (colors) {
+                const vec4ub& c = colors[i / 2];
+                pen->SetColor(Gdiplus::Color(c.a, c.r, c.g, c.b));
+            }
+            vg.g->DrawLine(pen, points[i].x, points[i].y, points[i + 1].x, points[i + 1].y);
+        }
+        if (colors) {
+            delete pen;
+        }
+    }
+}
+
+// 批量填充圆
+MINIVG_INLINE void fill_circles(const vec2f* points, const float* radius, const vec4ub* colors, size_t size)
+{
+    detail::vgContext& vg = detail::instance();
+    AABB box;
+    for (size_t i = 0; i < size; ++i) {
+        box.append(points[i].x - radius[i], points[i].y - radius[i]);
+        box.append(points[i].x + radius[i], points[i].y + radius[i]);
+    }
+    if (vg.culled(box)) {
+        return;
+    }
+
+    if (vg.software) {
+        vg.canvas.fill_circles(points, radius, colors, size);
+    }
+    else if (vg.g) {
+        Gdiplus::SolidBrush brush(Gdiplus::Color::White);
+        Gdiplus::Brush* current = colors ? static_cast<Gdiplus::Brush*>(&brush) : vg.fill_brush();
+        for (size_t i = 0; i < size; ++i) {
+            if (colors) {
+                brush.SetColor(Gdiplus::Color(colors[i].a, colors[i].r, colors[i].g, colors[i].b));
+            }
+            float r = radius[i];
+            vg.g->FillEllipse(current, points[i].x - r, points[i].y - r, r * 2.0f, r * 2.0f);
+        }
+    }
+}
+
+// 绘制路径
+MINIVG_INLINE void draw_path(const vgPath& path)
+{
+    if (detail::instance().culled(path.bounds(), detail::instance().canvas.stroke_extent())) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.draw_path(path);
+    }
+    else if (detail::instance().g) {
+        Gdiplus::GraphicsPath gpath;
+        detail::make_path(path, gpath);
+        detail::instance().g->DrawPath(detail::instance().pen, &gpath);
+    }
+}
+
+// 填充路径
+MINIVG_INLINE void fill_path(const vgPath& path)
+{
+    if (detail::instance().culled(path.bounds())) {
+        return;
+    }
+
+    if (detail::instance().software) {
+        detail::instance().canvas.fill_path(path);
+    }
+    else if (detail::instance().g) {
+        Gdiplus::GraphicsPath gpath;
+        detail::make_path(path, gpath);
+        detail::instance().g->FillPath(detail::instance().fill_brush(), &gpath);
+    }
+}
+
 //---------------------------------------------------------------------------
 // 字体函数
 //---------------------------------------------------------------------------
@@ -1892,13 +2867,31 @@ MINIVG_INLINE void textout(float x, float y, const wchar_t* text, size_t length)
 {
     detail::vgContext& vg = detail::instance();
     if (vg.g) {
+        /* 不测量文字，按字号保守估计范围：字号单位是磅，一个字按两倍字号算宽高，
+         * 再留出一个字的余量给斜体和字形的外伸部分
+         */
+        float em    = vg.fontSize * 2.0f;
+        int   lines = 1;
+        for (size_t i = 0; i < length; ++i) {
+            if (text[i] == L'\n') {
+                ++lines;
+            }
+        }
+        if (vg.culled(x - em, y - em, em * (length + 2), em * (lines + 2))) {
+            return;
+        }
+
         if (vg.fontIsChange) {
             setfont(vg.fontName, vg.fontSize, vgFontStyle(vg.fontStyle));
             vg.fontIsChange = false;
         }
 
+        vg.sync_clip();
         Gdiplus::StringFormat format;
         format.SetFormatFlags(Gdiplus::StringFormatFlagsNoFitBlackBox | Gdiplus::StringFormatFlagsDisplayFormatControl | Gdiplus::StringFormatFlagsLineLimit | Gdiplus::StringFormatFlagsNoClip);
+
+        // 文字要画在之前的图元上面
+        vg.canvas.flush();
         vg.g->DrawString(
             text, static_cast<int>(length),
             vg.font,
@@ -1907,6 +2900,16 @@ MINIVG_INLINE void textout(float x, float y, const wchar_t* text, size_t length)
             &format,
             vg.textBrush
         );
+
+        // 软件渲染模式下，文字仍然由 GDI+ 绘制，需要等待绘制完成
+        if (vg.software) {
+            vg.g->Flush(Gdiplus::FlushIntentionSync);
+            if (vg.tracking()) {
+                Gdiplus::RectF bounds;
+                vg.g->MeasureString(text, static_cast<int>(length), vg.font, Gdiplus::PointF(x, y), &format, &bounds);
+                vg.invalidate(bounds);
+            }
+        }
     }
     else {
         MINIVG_LOG_ERROR("error: context is null.\n");
@@ -1921,6 +2924,11 @@ MINIVG_INLINE void textout(float x, float y, const unistring& text)
 // 格式输出文字（左对齐、右对齐、居中）
 MINIVG_INLINE void drawtext(float x, float y, float width, float height, const unistring& text, int align)
 {
+    // 文字按布局矩形剪裁
+    if (detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
     if (detail::instance().g) {
         if (detail::instance().fontIsChange) {
             setfont(detail::instance().fontName, detail::instance().fontSize, vgFontStyle(detail::instance().fontStyle));
@@ -1948,9 +2956,16 @@ MINIVG_INLINE void drawtext(float x, float y, float width, float height, const u
         format.SetAlignment((Gdiplus::StringAlignment) hAlign);     // 水平对齐
         format.SetLineAlignment((Gdiplus::StringAlignment) vAlign); // 垂直对齐
         Gdiplus::RectF rect(x, y, width, height);
+        detail::instance().sync_clip();
+        detail::instance().canvas.flush();
         detail::instance().g->DrawString(
             text.c_str(), static_cast<int>(text.length()), detail::instance().font, rect, &format, detail::instance().textBrush
         );
+
+        if (detail::instance().software) {
+            detail::instance().g->Flush(Gdiplus::FlushIntentionSync);
+            detail::instance().invalidate(rect);
+        }
     }
 }
 
@@ -2028,7 +3043,8 @@ MINIVG_INLINE float textheight(const unistring& text)
 //---------------------------------------------------------------------------
 
 inline vgImage::vgImage() :
-    m_handle(), m_data()
+    m_handle(), m_data(), m_readonly(), m_page(), m_atlas(), m_x(), m_y(), m_width(), m_height(),
+    m_useMipmap(), m_mipmap(), m_levels()
 {
 }
 
@@ -2040,7 +3056,22 @@ inline vgImage::~vgImage()
 // 返回图片的指针
 inline Gdiplus::Bitmap* vgImage::handle() const
 {
-    return m_handle;
+    return m_page ? m_page->handle() : m_handle;
+}
+
+// 返回图片在 handle() 里面的范围
+inline vgRect vgImage::source() const
+{
+    if (m_page) {
+        return vgRect(float(m_x), float(m_y), float(m_width), float(m_height));
+    }
+    return vgRect(0.0f, 0.0f, float(this->width()), float(this->height()));
+}
+
+// 返回图集页
+inline vgImage* vgImage::page() const
+{
+    return m_page;
 }
 
 // 创建一个图片，默认为 32 位色
@@ -2154,10 +3185,26 @@ inline int vgImage::bind(HBITMAP hbmp)
     return 0;
 }
 
+// 绑定图集页里面的一块区域
+inline int vgImage::bind(vgImage* page, int x, int y, int width, int height)
+{
+    this->close();
+    if (!page || page->page() || x < 0 || y < 0 || width <= 0 || height <= 0
+        || x + width > page->width() || y + height > page->height()) {
+        return -1;
+    }
+    m_page   = page;
+    m_x      = x;
+    m_y      = y;
+    m_width  = width;
+    m_height = height;
+    return 0;
+}
+
 // 判断图片是否为空
 inline bool vgImage::empty() const
 {
-    return !m_handle;
+    return !this->handle();
 }
 
 inline const wchar_t* GetImageType(int type)
@@ -2227,7 +3274,15 @@ MINIVG_INLINE int GetImageCLSID(const WCHAR* format, CLSID* pCLSID)
 
 inline int vgImage::save(const unistring& filename, int type)
 {
+    if (m_page) {
+        // 图集里面的图片先复制出来
+        vgImage image;
+        m_page->unmap();
+        image.m_handle = m_page->handle()->Clone(m_x, m_y, m_width, m_height, PixelFormat32bppPARGB);
+        return image.save(filename, type);
+    }
     if (m_handle) {
+        this->unmap();
         CLSID id;
         if (!GetImageCLSID(GetImageType(type), &id)) {
             return m_handle->Save(filename.c_str(), &id, nullptr);
@@ -2237,9 +3292,42 @@ inline int vgImage::save(const unistring& filename, int type)
     return -1;
 }
 
+// 缩放图片
+inline int vgImage::resize(int width, int height, int filter)
+{
+    if (this->empty() || width <= 0 || height <= 0) {
+        return -1;
+    }
+
+    vgImage image;
+    image.create(width, height);
+    vgSurface dst = image.surface();
+    vgSurface src = this->surface();
+    if (dst.empty() || src.empty()) {
+        return -1;
+    }
+    detail::instance().canvas.resample(dst, src, filter);
+    image.unmap();
+
+    // 接管新的图片，close() 解除原图（或者图集页）的锁定
+    this->close();
+    m_handle       = image.m_handle;
+    image.m_handle = nullptr;
+    return 0;
+}
+
 // 释放图片
 inline void vgImage::close()
 {
+    this->reset_mipmap();
+
+    // 先解除锁定（图集里面的图片解除图集页的锁定），图集页由图集管理，这里只解除绑定并更新图集的统计
+    this->unmap();
+    if (m_atlas) {
+        m_atlas->release(m_page, m_width, m_height);
+        m_atlas = nullptr;
+    }
+    m_page = nullptr;
     if (m_handle) {
         delete m_handle;
         m_handle = nullptr;
@@ -2249,22 +3337,41 @@ inline void vgImage::close()
 // 返回图片的宽度
 inline int vgImage::width() const
 {
+    if (m_page) {
+        return m_width;
+    }
     return m_handle ? m_handle->GetWidth() : 0;
 }
 
 // 返回图片的高度
 inline int vgImage::height() const
 {
+    if (m_page) {
+        return m_height;
+    }
     return m_handle ? m_handle->GetHeight() : 0;
 }
 
 // 获取图像数据指针
 inline void* vgImage::map(bool readonly, int pixelformat)
 {
+    // 像素可能被修改，mipmap 重新生成
+    if (!readonly) {
+        this->reset_mipmap();
+    }
+    if (m_page) {
+        // 锁定图集页，返回区域左上角的指针，unmap() 解除图集页的锁定
+        return pixelformat == VG_RGBA ? this->surface().pixels : nullptr;
+    }
     if (m_data) {
-        msgbox(L"图片已经锁定。", L"错误");
+        // 软件渲染绘制图片以后图片保持锁定，格式相同并且读写方式满足的时候直接使用
+        const int format = pixelformat == VG_RGB ? PixelFormat24bppRGB : PixelFormat32bppPARGB;
+        if (m_data->PixelFormat == format && (readonly || !m_readonly)) {
+            return m_data->Scan0;
+        }
+        this->unmap();
     }
-    else {
+    if (m_handle) {
         m_data = new Gdiplus::BitmapData();
         Gdiplus::Rect rect(0, 0, this->width(), this->height());
         Gdiplus::Status stat;
@@ -2285,8 +3392,10 @@ inline void* vgImage::map(bool readonly, int pixelformat)
         }
 
         if (stat == Gdiplus::Ok) {
+            m_readonly = readonly;
             return m_data->Scan0;
         }
+        detail::safe_delete(m_data);
     }
 
     return nullptr;
@@ -2295,12 +3404,105 @@ inline void* vgImage::map(bool readonly, int pixelformat)
 // 还原图像数据
 inline void vgImage::unmap()
 {
-    if (m_data) {
+    if (m_page) {
+        m_page->unmap();
+    }
+    else if (m_data) {
+        // 记录的绘图命令可能还在使用图片像素
+        detail::instance().canvas.flush();
         m_handle->UnlockBits(m_data);
         detail::safe_delete(m_data);
     }
 }
 
+// 返回软件渲染使用的像素视图
+inline vgSurface vgImage::surface()
+{
+    if (m_page) {
+        return m_page->surface().crop(m_x, m_y, m_width, m_height);
+    }
+    if (!m_handle) {
+        return vgSurface();
+    }
+    // 软件渲染只支持预乘 BGRA 格式
+    if (m_data && m_data->PixelFormat != PixelFormat32bppPARGB) {
+        this->unmap();
+    }
+    if (!m_data && !this->map()) {
+        return vgSurface();
+    }
+    return vgSurface(m_data->Scan0, m_data->Width, m_data->Height, m_data->Stride / 4);
+}
+
+// 开启 mipmap
+inline void vgImage::mipmap(bool enable)
+{
+    m_useMipmap = enable;
+    if (!enable) {
+        this->reset_mipmap();
+    }
+}
+
+inline bool vgImage::mipmap() const
+{
+    return m_useMipmap;
+}
+
+inline vgMipmap& vgImage::mipmaps()
+{
+    return m_mipmap;
+}
+
+// 返回 GDI+ 缩小绘制使用的图片，按最接近的一级选择
+inline Gdiplus::Bitmap* vgImage::mipmap_handle(float scale, vgRect& source)
+{
+    float lod = scale > 0.0f ? -log(scale) / log(2.0f) : 0.0f;
+    int level = static_cast<int>(floor(lod + 0.5f));
+    if (m_useMipmap && level >= 1 && m_mipmap.empty()) {
+        vgSurface pixels = this->surface();
+        m_mipmap.build(pixels);
+        // 解除锁定，GDI+ 才能绘制原图
+        this->unmap();
+    }
+    level = std::min(level, m_mipmap.size());
+    if (!m_useMipmap || level < 1) {
+        // 使用原图，图集里面的图片加上区域的位置
+        vgRect offset = this->source();
+        source.x += offset.x;
+        source.y += offset.y;
+        return this->handle();
+    }
+
+    if (m_levels.empty()) {
+        m_levels.resize(m_mipmap.size());
+    }
+    if (!m_levels[level - 1]) {
+        const vgSurface& s = m_mipmap.level(level);
+        m_levels[level - 1] = new Gdiplus::Bitmap(s.width, s.height, s.stride * 4, PixelFormat32bppPARGB, (BYTE*) s.pixels);
+    }
+
+    float k  = ldexp(1.0f, -level);
+    source.x *= k;
+    source.y *= k;
+    source.w *= k;
+    source.h *= k;
+    return m_levels[level - 1];
+}
+
+// 释放 mipmap
+inline void vgImage::reset_mipmap()
+{
+    if (!m_mipmap.empty()) {
+        // 记录的绘图命令可能还在使用 mipmap
+        detail::instance().canvas.flush();
+        m_mipmap.clear();
+    }
+    for (size_t i = 0; i < m_levels.size(); ++i) {
+        delete m_levels[i];
+    }
+    m_levels.clear();
+}
+
 //
 // API 部分
 //
@@ -2327,6 +3529,21 @@ MINIVG_INLINE vgImage* loadimage(int id, PCTSTR resource_type)
     return detail::instance().resource.loadimage(id, resource_type);
 }
 
+// 开启图集
+MINIVG_INLINE void image_atlas(bool enable, int pageSize, int maxSize)
+{
+    detail::vgAtlas& atlas = detail::instance().resource.atlas;
+    atlas.enabled  = enable;
+    atlas.pageSize = std::max(pageSize, 1);
+    atlas.maxSize  = maxSize;
+}
+
+// 返回图集统计
+MINIVG_INLINE vgAtlasStats atlas_stats()
+{
+    return detail::instance().resource.atlas.stats();
+}
+
 MINIVG_INLINE int saveimage(vgImage* image, const unistring& filename)
 {
     if (image) {
@@ -2335,17 +3552,131 @@ MINIVG_INLINE int saveimage(vgImage* image, const unistring& filename)
     return -1;
 }
 
+// 开始绘制到图片
+MINIVG_INLINE int begin_target(vgImage* image)
+{
+    detail::vgContext& vg = detail::instance();
+    if (!vg.g || !image || image->empty()) {
+        return -1;
+    }
+
+    // 之前的绘图先画完，图片可能正在被使用
+    vg.canvas.flush();
+    vg.g->Flush(Gdiplus::FlushIntentionSync);
+
+    // 重新锁定图片像素（mipmap 需要重新生成），软件渲染和 GDI+ 都直接绘制到这块像素
+    image->unmap();
+    if (!image->map()) {
+        return -1;
+    }
+    vgSurface surface = image->surface();
+
+    vg.targets.push_back(detail::render_target());
+    detail::render_target& target = vg.targets.back();
+    target.image       = image;
+    target.bitmap      = new Gdiplus::Bitmap(surface.width, surface.height, surface.stride * 4, PixelFormat32bppPARGB, reinterpret_cast<BYTE*>(surface.pixels));
+    target.g           = vg.g;
+    target.surface     = vg.canvas.target();
+    target.clip        = vg.canvas.clip();
+    target.clipChanged = vg.clipChanged;
+    target.transform   = vg.canvas.transform();
+    target.clipStack.swap(vg.clipStack);
+    vg.canvas.swap_transforms(target.transformStack);
+
+    // 图片从单位变换、空的变换栈、不剪裁开始绘制
+    vg.g = new Gdiplus::Graphics(target.bitmap);
+    vg.canvas.retarget(surface, true);
+    vg.canvas.transform(vgMatrix());
+    vg.clipChanged = false;
+    effect_level(vg.effectLevel);
+    return 0;
+}
+
+// 结束绘制到图片，恢复之前的绘图目标
+MINIVG_INLINE void end_target()
+{
+    detail::vgContext& vg = detail::instance();
+    if (vg.targets.empty()) {
+        return;
+    }
+
+    detail::render_target& target = vg.targets.back();
+
+    // 画完图片上记录的绘图命令，之后恢复之前的目标和状态
+    vg.g->Flush(Gdiplus::FlushIntentionSync);
+    delete vg.g;
+    delete target.bitmap;
+    vg.g = target.g;
+    vg.canvas.retarget(target.surface, vg.targets.size() > 1);
+    vg.canvas.cliprect(target.clip);
+    vg.canvas.transform(target.transform);
+    vg.canvas.swap_transforms(target.transformStack);
+    vg.clipStack.swap(target.clipStack);
+    vg.clipChanged = target.clipChanged;
+
+    // 解锁图片，GDI+ 绘制图片的时候不能锁定
+    vgImage* image = target.image;
+    vg.targets.pop_back();
+    image->unmap();
+}
+
 MINIVG_INLINE void drawimage(vgImage* image, float x, float y)
 {
-    if (detail::instance().g && image && image->handle()) {
-        detail::instance().g->DrawImage(image->handle(), x, y);
+    if (!image || detail::instance().culled(x, y, float(image->width()), float(image->height()))) {
+        return;
+    }
+
+    if (detail::instance().software && image) {
+        vgSurface pixels = image->surface();
+        detail::instance().canvas.draw_image(pixels, x, y, float(pixels.width), float(pixels.height));
+    }
+    else if (detail::instance().g && image && image->handle()) {
+        if (image->page()) {
+            vgRect s = image->source();
+            detail::instance().g->DrawImage(image->handle(), Gdiplus::RectF(x, y, s.w, s.h),
+                s.x, s.y, s.w, s.h, Gdiplus::UnitPixel);
+        }
+        else {
+            detail::instance().g->DrawImage(image->handle(), x, y);
+        }
     }
 }
 
 MINIVG_INLINE void drawimage(vgImage* image, float x, float y, float width, float height)
 {
-    if (detail::instance().g && image && image->handle()) {
-        detail::instance().g->DrawImage(image->handle(), x, y, width, height);
+    if (!image || detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
+    if (detail::instance().software && image) {
+        vgSurface pixels = image->surface();
+        if (image->mipmap() && !pixels.empty()) {
+            vgMatrix m;
+            m.translate(x, y);
+            m.scale(width / pixels.width, height / pixels.height);
+            detail::instance().canvas.draw_image(pixels, image->mipmaps(), vgRect(0.0f, 0.0f, float(pixels.width), float(pixels.height)), m);
+        }
+        else {
+            detail::instance().canvas.draw_image(pixels, x, y, width, height);
+        }
+    }
+    else if (detail::instance().g && image && image->handle()) {
+        if (image->mipmap()) {
+            // 和软件渲染一样，mipmap 级别包括当前变换的缩放
+            vgRect s(0.0f, 0.0f, float(image->width()), float(image->height()));
+            float mipScale = std::min(width / s.w, height / s.h) * detail::instance().canvas.transform_scale();
+            Gdiplus::Bitmap* bitmap = image->mipmap_handle(mipScale, s);
+            detail::instance().g->DrawImage(bitmap, Gdiplus::RectF(x, y, width, height),
+                s.x, s.y, s.w, s.h, Gdiplus::UnitPixel);
+        }
+        else if (image->page()) {
+            vgRect s = image->source();
+            detail::instance().g->DrawImage(image->handle(), Gdiplus::RectF(x, y, width, height),
+                s.x, s.y, s.w, s.h, Gdiplus::UnitPixel);
+        }
+        else {
+            detail::instance().g->DrawImage(image->handle(), x, y, width, height);
+        }
     }
 }
 
@@ -2359,13 +3690,29 @@ MINIVG_INLINE void drawsprite(
     float scaleX, float scaleY,            // 缩放
     float rotation,                        // 旋转角度
     float centerX, float centerY,          // 旋转中心(0.0 - 1.0 之间，按源大小比例设置旋转中心)
-    float alpha
+    float alpha,                           // 透明度
+    COLORREF tint                          // 着色
 )
 {
-    (void) alpha; // todo... 图片 alpha 支持
+    if (!image) {
+        return;
+    }
+
+    vgSprite sprite(vgRect(sourceX, sourceY, sourceWidth, sourceHeight), x, y, scaleX, scaleY, rotation, centerX, centerY, alpha, tint);
+    if (detail::instance().culled(sprite)) {
+        return;
+    }
 
     Gdiplus::Graphics* g = detail::instance().g;
-    if (g && image) {
+    if (detail::instance().software) {
+        if (image->mipmap()) {
+            detail::instance().canvas.draw_sprite(image->surface(), image->mipmaps(), sprite);
+        }
+        else {
+            detail::instance().canvas.draw_sprite(image->surface(), sprite);
+        }
+    }
+    else if (g) {
         float cx = sourceWidth;
         float cy = sourceHeight;
 
@@ -2393,32 +3740,19 @@ MINIVG_INLINE void drawsprite(
         m.Translate(x, y);       // 平移
         m.Rotate(-rotation);     // 旋转
         m.Scale(scaleX, scaleY); // 缩放
+        m.Multiply(&saveMat, Gdiplus::MatrixOrderAppend); // 最后应用当前变换
         g->SetTransform(&m);     // 应用矩阵变换
 
-        /*
-        Gdiplus::ImageAttributes attribute;
-        Gdiplus::ColorMatrix cm = {
-            1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 0.5f, 0.0f,
-            0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-        };
-
-        attribute.SetColorMatrix(&cm, Gdiplus::ColorMatrixFlags::ColorMatrixFlagsSkipGrays);
-
-        // 绘制图片
-        g->DrawImage(
-            image->handle(),
-            Gdiplus::RectF(-centerX, -centerY, cx, cy),
-            sourceX, sourceY, sourceWidth, sourceHeight,
-            Gdiplus::UnitPixel, &attribute);
-        */
+        // 绘制图片，透明度和着色使用共用的颜色矩阵
+        // 源范围转换到图集页或者 mipmap 的一级里面，级别包括当前变换的缩放
+        vgRect s(sourceX, sourceY, sourceWidth, sourceHeight);
+        float mipScale = std::min(fabs(scaleX), fabs(scaleY)) * detail::instance().canvas.transform_scale();
+        Gdiplus::Bitmap* bitmap = image->mipmap_handle(mipScale, s);
         g->DrawImage(
-            image->handle(),
+            bitmap,
             Gdiplus::RectF(-centerX, -centerY, cx, cy),
-            sourceX, sourceY, sourceWidth, sourceHeight,
-            Gdiplus::UnitPixel
+            s.x, s.y, s.w, s.h,
+            Gdiplus::UnitPixel, detail::instance().sprite_attributes(alpha, tint)
         );
 
         // 恢复 dc 矩阵变换
@@ -2439,11 +3773,126 @@ MINIVG_INLINE void drawsprite(
     drawsprite(image, 0.0f, 0.0f, cx, cy, x, y, scaleX, scaleY, rotation, centerX, centerY);
 }
 
+// 批量绘制精灵
+MINIVG_INLINE void drawsprites(vgImage* const* images, const vgSprite* sprites, size_t size)
+{
+    detail::vgContext& vg = detail::instance();
+    if (vg.software) {
+        // 连续使用同一张图片的精灵剔除以后一起提交，图片只锁定一次
+        size_t i = 0;
+        while (i < size) {
+            vgImage* image = images[i];
+            vg.spriteCache.clear();
+            for (; i < size && images[i] == image; ++i) {
+                if (image && !vg.culled(sprites[i])) {
+                    vg.spriteCache.push_back(sprites[i]);
+                }
+            }
+            if (vg.spriteCache.empty()) {
+                continue;
+            }
+            if (image->mipmap()) {
+                vg.canvas.draw_sprites(image->surface(), image->mipmaps(), &vg.spriteCache[0], vg.spriteCache.size());
+            }
+            else {
+                vg.canvas.draw_sprites(image->surface(), &vg.spriteCache[0], vg.spriteCache.size());
+            }
+        }
+    }
+    else if (vg.g) {
+        // 矩阵只保存、恢复一次
+        Gdiplus::Matrix saveMat;
+        vg.g->GetTransform(&saveMat);
+        const float transformScale = vg.canvas.transform_scale();
+
+        for (size_t i = 0; i < size; ++i) {
+            if (!images[i] || !images[i]->handle() || vg.culled(sprites[i])) {
+                continue;
+            }
+            const vgSprite& s       = sprites[i];
+            vgRect source           = s.source;
+            Gdiplus::Bitmap* bitmap = images[i]->mipmap_handle(std::min(fabs(s.scaleX), fabs(s.scaleY)) * transformScale, source);
+            vgMatrix m              = vg.canvas.transform() * s.matrix();
+            Gdiplus::Matrix mat(m.a, m.b, m.c, m.d, m.tx, m.ty);
+            vg.g->SetTransform(&mat);
+            vg.g->DrawImage(
+                bitmap,
+                Gdiplus::RectF(0.0f, 0.0f, s.source.w, s.source.h),
+                source.x, source.y, source.w, source.h,
+                Gdiplus::UnitPixel, vg.sprite_attributes(s.alpha, s.tint)
+            );
+        }
+
+        vg.g->SetTransform(&saveMat);
+    }
+}
+
+//
+// vgSpriteBatch
+//
+
+inline void vgSpriteBatch::clear()
+{
+    m_images.clear();
+    m_sprites.clear();
+}
+
+inline void vgSpriteBatch::reserve(size_t size)
+{
+    m_images.reserve(size);
+    m_sprites.reserve(size);
+}
+
+inline size_t vgSpriteBatch::size() const
+{
+    return m_sprites.size();
+}
+
+inline bool vgSpriteBatch::empty() const
+{
+    return m_sprites.empty();
+}
+
+inline void vgSpriteBatch::add(vgImage* image, const vgSprite& sprite)
+{
+    m_images.push_back(image);
+    m_sprites.push_back(sprite);
+}
+
+inline void vgSpriteBatch::add(vgImage* image, float x, float y, float scaleX, float scaleY, float rotation,
+    float centerX, float centerY, float alpha, COLORREF tint)
+{
+    if (image) {
+        vgRect source(0.0f, 0.0f, static_cast<float>(image->width()), static_cast<float>(image->height()));
+        this->add(image, vgSprite(source, x, y, scaleX, scaleY, rotation, centerX, centerY, alpha, tint));
+    }
+}
+
+inline void vgSpriteBatch::draw() const
+{
+    if (!m_sprites.empty()) {
+        drawsprites(&m_images[0], &m_sprites[0], m_sprites.size());
+    }
+}
+
 // 把像素直接绘制到屏幕上，像素格式必须是 BGRA 32位。
 MINIVG_INLINE void draw_pixels(float x, float y, float width, float height, const void* pixels, int imageWidth, int imageHeight)
 {
+    if (detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
     Gdiplus::Graphics* g = detail::instance().g;
-    if (g) {
+    if (detail::instance().software) {
+        // 像素是自底向上存储的
+        BYTE* data = (BYTE*) pixels;
+        data += (imageWidth * 4) * (imageHeight - 1);
+        detail::instance().canvas.draw_image(vgSurface(data, imageWidth, imageHeight, -imageWidth), x, y, width, height);
+
+        // 像素由调用者管理，不能延迟绘制
+        detail::instance().canvas.flush();
+    }
+    else if (g) {
         BYTE* data = (BYTE*) pixels;
         data += (imageWidth * 4) * (imageHeight - 1);
         Gdiplus::Bitmap bmp(imageWidth, imageHeight, -imageWidth * 4, PixelFormat32bppPARGB, data);
@@ -2453,8 +3902,22 @@ MINIVG_INLINE void draw_pixels(float x, float y, float width, float height, cons
 
 MINIVG_INLINE void draw_pixels(float x, float y, float width, float height, const void* pixels, int imageWidth, int imageHeight, int imageRowStride, vgFormat format)
 {
+    if (detail::instance().culled(x, y, width, height)) {
+        return;
+    }
+
     Gdiplus::Graphics* g = detail::instance().g;
-    if (g) {
+    if (detail::instance().software && format == VG_PRGBA) {
+        BYTE* data = (BYTE*) pixels;
+        if (imageRowStride < 0) {
+            data += -imageRowStride * (imageHeight - 1);
+        }
+        vgSurface surface(data, imageWidth, imageHeight, imageRowStride / 4);
+        detail::instance().canvas.draw_image(surface, x, y, width, height);
+        detail::instance().canvas.flush();
+    }
+    else if (g) {
+        detail::instance().canvas.flush();
         BYTE* data = (BYTE*) pixels;
         if (imageRowStride < 0) {
             data += -imageRowStride * (imageHeight - 1);
@@ -2465,7 +3928,208 @@ MINIVG_INLINE void draw_pixels(float x, float y, float width, float height, cons
             Gdiplus::Bitmap bmp(imageWidth, imageHeight, imageRowStride, format, data);
             g->DrawImage(&bmp, x, y, width, height);
         }
+
+        // 软件渲染模式下，其他格式交给 GDI+ 绘制
+        if (detail::instance().software) {
+            g->Flush(Gdiplus::FlushIntentionSync);
+            detail::instance().invalidate(Gdiplus::RectF(x, y, width, height));
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// 图层
+//---------------------------------------------------------------------------
+
+inline vgLayer::vgLayer(const unistring& name, VG_PAINT_EVENT paint, int zorder) :
+    m_name(name), m_paint(paint), m_image(), m_zorder(zorder), m_opacity(1.0f), m_x(), m_y(),
+    m_visible(true), m_invalid(true), m_redraws()
+{
+}
+
+inline const unistring& vgLayer::name() const
+{
+    return m_name;
+}
+
+inline void vgLayer::paint(VG_PAINT_EVENT function)
+{
+    m_paint   = function;
+    m_invalid = true;
+}
+
+inline void vgLayer::invalidate()
+{
+    m_invalid = true;
+}
+
+inline bool vgLayer::invalid() const
+{
+    return m_invalid;
+}
+
+inline void vgLayer::zorder(int value)
+{
+    m_zorder = value;
+}
+
+inline int vgLayer::zorder() const
+{
+    return m_zorder;
+}
+
+inline void vgLayer::opacity(float value)
+{
+    m_opacity = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+inline float vgLayer::opacity() const
+{
+    return m_opacity;
+}
+
+inline void vgLayer::offset(int x, int y)
+{
+    m_x = x;
+    m_y = y;
+}
+
+inline int vgLayer::x() const
+{
+    return m_x;
+}
+
+inline int vgLayer::y() const
+{
+    return m_y;
+}
+
+inline void vgLayer::visible(bool value)
+{
+    m_visible = value;
+}
+
+inline bool vgLayer::visible() const
+{
+    return m_visible;
+}
+
+inline int vgLayer::redraws() const
+{
+    return m_redraws;
+}
+
+inline vgImage* vgLayer::image()
+{
+    return &m_image;
+}
+
+// 重新绘制图层，缓冲区先清成透明
+inline bool vgLayer::update(int width, int height)
+{
+    if (m_image.width() != width || m_image.height() != height) {
+        m_image.create(width, height);
+        m_invalid = true;
+    }
+    if (!m_invalid || begin_target(&m_image) != 0) {
+        return false;
+    }
+    clear(0, 0, 0, 0);
+    if (m_paint) {
+        m_paint();
+    }
+    end_target();
+    m_invalid = false;
+    ++m_redraws;
+    return true;
+}
+
+namespace detail {
+
+// 图层按合成顺序排序
+inline bool layer_order(const vgLayer* a, const vgLayer* b)
+{
+    return a->zorder() < b->zorder();
+}
+
+} // end namespace detail
+
+// 创建图层
+MINIVG_INLINE vgLayer* newlayer(const unistring& name, VG_PAINT_EVENT paint, int zorder)
+{
+    vgLayer* layer = new vgLayer(name, paint, zorder);
+    detail::instance().layers.push_back(layer);
+    return layer;
+}
+
+// 按名字查找图层
+MINIVG_INLINE vgLayer* findlayer(const unistring& name)
+{
+    const std::vector<vgLayer*>& layers = detail::instance().layers;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i]->name() == name) {
+            return layers[i];
+        }
+    }
+    return nullptr;
+}
+
+// 删除图层
+MINIVG_INLINE void freelayer(vgLayer* layer)
+{
+    std::vector<vgLayer*>& layers = detail::instance().layers;
+    std::vector<vgLayer*>::iterator itr = std::find(layers.begin(), layers.end(), layer);
+    if (itr != layers.end()) {
+        // 图层像素可能还在记录的绘图命令里面
+        detail::instance().canvas.flush();
+        delete *itr;
+        layers.erase(itr);
+    }
+}
+
+// 合成图层
+MINIVG_INLINE void composite_layers()
+{
+    detail::vgContext& vg = detail::instance();
+    if (!vg.g || vg.layers.empty()) {
+        return;
+    }
+
+    // 按合成顺序排序，相同的保持创建顺序
+    std::stable_sort(vg.layers.begin(), vg.layers.end(), detail::layer_order);
+
+    // 重新绘制无效的图层
+    const int width  = vg.viewRect.Width;
+    const int height = vg.viewRect.Height;
+    for (size_t i = 0; i < vg.layers.size(); ++i) {
+        if (vg.layers[i]->visible() && vg.layers[i]->update(width, height)) {
+            ++vg.layerRedraws;
+        }
+    }
+
+    // 所有图层一次合成，GDI+ 绘制的内容先写到缓冲区里面
+    const double t = detail::tick_time();
+    std::vector<detail::layer_source> sources;
+    for (size_t i = 0; i < vg.layers.size(); ++i) {
+        vgLayer* layer = vg.layers[i];
+        uint8_t alpha  = static_cast<uint8_t>(layer->opacity() * 255.0f + 0.5f);
+        if (layer->visible() && alpha) {
+            sources.push_back(detail::layer_source(layer->image()->surface(), layer->x(), layer->y(), alpha));
+        }
+    }
+    if (!sources.empty()) {
+        vg.g->Flush(Gdiplus::FlushIntentionSync);
+        GdiFlush();
+        vg.canvas.composite(&sources[0], sources.size());
+    }
+
+    // GDI+ 模式下解除图层图片的锁定，GDI+ 不能绘制锁定的图片；软件渲染保持锁定，下一帧直接使用
+    if (!vg.software) {
+        for (size_t i = 0; i < vg.layers.size(); ++i) {
+            vg.layers[i]->image()->unmap();
+        }
     }
+    vg.compositeTime += (detail::tick_time() - t) * 1000.0;
 }
 
 //---------------------------------------------------------------------------
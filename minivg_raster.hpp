@@ -0,0 +1,7426 @@
+﻿/*
+ Copyright (c) 2005-2020 sdragonx (mail:sdragonx@foxmail.com)
+
+ minivg_raster.hpp
+
+ 2026-10-17 09:35:12
+
+ minivg 软件光栅化后端。
+
+ 这个文件不依赖 windows.h、gdiplus.h，可以单独在 Linux 等平台使用。
+ 所有图元直接以抗锯齿覆盖率绘制到预乘 BGRA 帧缓冲区里面。
+
+ 在 minivg 里面使用：
+    initgraph(800, 600, VG_BACKBUFFER | VG_SOFTWARE);
+
+ 单独使用：
+
+#include "minivg_raster.hpp"
+
+int main(int argc, char* argv[])
+{
+    std::vector<uint32_t> pixels(800 * 600);
+
+    vgCanvas canvas;
+    canvas.bind(&pixels[0], 800, 600, 800);
+
+    canvas.clear(0, 0, 0);
+    canvas.fill_color(0, 255, 0, 128);
+    canvas.fill_rect(100, 100, 200, 200);
+}
+
+*/
+#ifndef MINIVG_RASTER_HPP_20261017093512
+#define MINIVG_RASTER_HPP_20261017093512
+
+#include <cmath>
+#include <float.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+// 多线程渲染需要 C++11 线程库，定义 MINIVG_NO_THREADS 关闭
+#if !defined(MINIVG_NO_THREADS) && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700))
+    #define MINIVG_THREADS
+    #include <atomic>
+    #include <condition_variable>
+    #include <mutex>
+    #include <thread>
+#endif
+
+// SIMD 支持，定义 MINIVG_NO_SIMD 关闭
+#if !defined(MINIVG_NO_SIMD) && (defined(_MSC_VER) || defined(__GNUC__))
+    #if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+        #define MINIVG_SIMD_X86
+        #include <emmintrin.h>
+        #include <immintrin.h>
+        #ifdef _MSC_VER
+            #include <intrin.h>
+        #else
+            #include <cpuid.h>
+        #endif
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+        #define MINIVG_SIMD_NEON
+        #include <arm_neon.h>
+    #endif
+#endif
+
+// 运行时选择指令集的函数，gcc 需要单独指定编译目标
+#if defined(MINIVG_SIMD_X86) && defined(__GNUC__)
+    #define MINIVG_TARGET_SSE2 __attribute__((target("sse2")))
+    #define MINIVG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define MINIVG_TARGET_SSE2
+    #define MINIVG_TARGET_AVX2
+#endif
+
+// 向量里面的匿名结构体，gcc 在 -pedantic 下需要标记为扩展
+#ifdef __GNUC__
+    #define MINIVG_ANONYMOUS __extension__
+#else
+    #define MINIVG_ANONYMOUS
+#endif
+
+namespace minivg {
+
+// clang-format off
+
+//---------------------------------------------------------------------------
+// 数学、几何
+//---------------------------------------------------------------------------
+
+#ifndef M_PI
+#define M_PI        3.141592653589793238462     // acos(-1.0)
+#endif
+
+#ifndef M_PI_2
+#define M_PI_2      1.570796326794896619231     // M_PI/2
+#endif
+
+#ifndef M_LOG2E
+#define M_LOG2E     1.442695040888963407360     // 1.0 / log(2.0)
+#endif
+
+#ifndef M_RD
+#define M_RD        0.017453292519943295769     // 弧度 (radian)
+#define M_INV_RD    57.295779513082320876798    // 弧度的倒数 (reciprocal) 1.0 / M_RD
+#endif
+
+// 判断数值是否是 0
+template<typename T>inline bool is_zero        (T      n) { return n == 0; };
+template<>          inline bool is_zero<float> (float  n) { return n < 0.0 ? (n > -FLT_EPSILON) : (n < FLT_EPSILON); }
+template<>          inline bool is_zero<double>(double n) { return n < 0.0 ? (n > -DBL_EPSILON) : (n < DBL_EPSILON); }
+
+// 判断数值是否相等
+template<typename T>
+inline bool is_equal(T a, T b)
+{
+    return is_zero(a - b);
+}
+
+// 产生 [0 ~ n] 之间的随机数
+template<typename T>
+inline int random(T n)
+{
+    return rand() % n;
+}
+
+// 产生 [0 ~ 1] 之间的随机浮点数
+inline double rand_real()
+{
+    return double(rand()) / RAND_MAX;
+}
+
+// 产生 [a ~ b] 之间的随机浮点数
+inline double rand_real(double a, double b)
+{
+    return a + (b - a) * rand_real();
+}
+
+// 计算点 [x, y] 到原点的角度
+inline double degree_angle(double x, double y)
+{
+    using namespace std;
+
+    return atan2(y, x) * M_INV_RD;
+}
+
+//---------------------------------------------------------------------------
+// 向量类
+//---------------------------------------------------------------------------
+
+#if !defined(GLM_VERSION)
+
+#define VEC2_OPERATION(op)\
+    template<typename X>\
+    vec2<T> operator op(const X& value) const\
+    {\
+        return vec2<T>(x op value, y op value);\
+    }\
+    template<typename X>\
+    vec2<T> operator op(const vec2<X>& v) const\
+    {\
+        return vec2<T>(x op v.x, y op v.y);\
+    }\
+    template<typename X>\
+    vec2<T>& operator op##=(const X& value)\
+    {\
+        x op##= value; y op##= value;\
+        return *this;\
+    }\
+    template<typename X>\
+    vec2<T>& operator op##=(const vec2<X>& v)\
+    {\
+        x op##= v.x; y op##= v.y;\
+        return *this;\
+    }
+
+#define VEC4_OPERATION(op)\
+    template<typename X>\
+    vec4<T> operator op(const X& value) const\
+    {\
+        return vec4<T>(x op value, y op value, z op value, w op value);\
+    }\
+    template<typename X>\
+    vec4<T> operator op(const vec4<X>& v) const\
+    {\
+        return vec4<T>(x op v.x, y op v.y, z op v.z, w op v.w);\
+    }\
+    template<typename X>\
+    vec4<T>& operator op##=(const X& value)\
+    {\
+        x op##= value; y op##= value; z op##= value; w op##= value;\
+        return *this;\
+    }\
+    template<typename X>\
+    vec4<T>& operator op##=(const vec4<X>& v)\
+    {\
+        x op##= v.x; y op##= v.y; z op##= v.z; w op##= v.w;\
+        return *this;\
+    }
+
+template<typename T> class vec2;
+template<typename T> class vec4;
+
+template<typename T>
+class vec2
+{
+public:
+    union {
+        T data[2];
+        MINIVG_ANONYMOUS struct { T x, y; };
+    };
+
+    vec2() : x(), y() {}
+    vec2(T scalar) : x(scalar), y(scalar) {}
+    vec2(T _x, T _y) : x(_x), y(_y) {}
+
+    vec2& set(T _x, T _y) { x = _x; y = _y; return *this; }
+
+    VEC2_OPERATION(+)
+    VEC2_OPERATION(-)
+    VEC2_OPERATION(*)
+    VEC2_OPERATION(/)
+
+          T& operator[](size_t i)       { return data[i]; }
+    const T& operator[](size_t i) const { return data[i]; }
+
+    bool operator==(const vec2& other) const
+    {
+        return is_equal(x, other.x) && is_equal(y, other.y);
+    }
+
+    bool operator!=(const vec2& other) const
+    {
+        return !is_equal(x, other.x) || !is_equal(y, other.y);
+    }
+};
+
+template<typename T>
+class vec4
+{
+public:
+    union
+    {
+        T data[4];
+        MINIVG_ANONYMOUS struct { T x, y, z, w; }; // 空间坐标
+        MINIVG_ANONYMOUS struct { T b, g, r, a; }; // 颜色分量 (GDI 使用的是 BGRA)
+    };
+
+    vec4() : x(), y(), z(), w() {}
+    vec4(T scalar) : x(scalar), y(scalar), z(scalar), w(scalar) {}
+    vec4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
+
+    vec4& set(T _x, T _y, T _z, T _w) { x = _x; y = _y; z = _z; w = _w; return *this; }
+
+          T& operator[](size_t i)       { return data[i]; }
+    const T& operator[](size_t i) const { return data[i]; }
+};
+
+typedef vec2<int>       vec2i;
+typedef vec2<float>     vec2f;
+typedef vec2<double>    vec2d;
+
+typedef vec4<uint8_t>   vec4ub;
+typedef vec4<int>       vec4i;
+typedef vec4<float>     vec4f;
+typedef vec4<double>    vec4d;
+
+// 获取向量距离原点的距离
+template<typename T>
+inline float length(const vec2<T>& v)
+{
+    using namespace std;
+
+    return static_cast<T>(sqrt(v.x * v.x + v.y * v.y));
+}
+
+// 获取两个向量的距离
+template<typename T>
+inline float distance(const vec2<T>& v1, const vec2<T>& v2)
+{
+    return length(v2 - v1);
+}
+
+// 归一化向量
+template<typename T>
+inline vec2<T> normalize(const vec2<T>& v)
+{
+    float n = length(v);
+    if (n == 0) {
+        return v;
+    }
+
+    n = 1.0f / n;
+
+    return vec2<T>(v.x * n, v.y * n);
+}
+
+// 旋转向量（角度）
+template<typename T, typename A>
+inline vec2<T> rotate(const vec2<T>& v, A angle)
+{
+    using namespace std;
+
+    angle *= M_RD;
+    T sine = static_cast<T>(sin(angle));
+    T cosine = static_cast<T>(cos(angle));
+    return vec2<T>(
+        v.x * cosine - v.y * sine,
+        v.x * sine + v.y * cosine);
+}
+
+// 计算角度
+template<typename T>
+inline T degree_angle(const vec2<T>& v)
+{
+    return degree_angle(v.x, v.y);
+}
+
+#else // GLM_VERSION
+
+#if !defined(MATH_PUBLIC_H_20220126134219)
+
+} // end namespace minivg
+
+#include <glm/glm.hpp>
+
+namespace cgl {
+
+typedef glm::ivec2      vec2i;
+typedef glm::vec2       vec2f;
+typedef glm::dvec2      vec2d;
+
+typedef glm::u8vec4     vec4ub;
+typedef glm::ivec4      vec4i;
+typedef glm::vec4       vec4f;
+typedef glm::dvec4      vec4d;
+
+} // end namespace cgl
+namespace minivg {
+
+#endif // GLM_HPP_20211019161738
+
+using cgl::vec2i;
+using cgl::vec2f;
+using cgl::vec2d;
+
+using cgl::vec4ub;
+using cgl::vec4i;
+using cgl::vec4f;
+using cgl::vec4d;
+
+#endif // GLM_VERSION
+
+// clang-format on
+
+// 矩形
+class vgRect
+{
+public:
+    float x;
+    float y;
+    float w;
+    float h;
+
+public:
+    vgRect() : x(), y(), w(), h() { }
+
+    vgRect(float x, float y, float width, float height) :
+        x(x),
+        y(y),
+        w(width),
+        h(height) { }
+
+    // 返回点是否在矩形内
+    bool contaits(float x, float y) const
+    {
+        return x > this->x &&
+               y > this->y &&
+               x < this->x + this->w &&
+               y < this->y + this->h;
+    }
+
+    bool contaits(const vec2i& v) const
+    {
+        return this->contaits(v.x, v.y);
+    }
+
+    bool contaits(const vec2f& v) const
+    {
+        return this->contaits(v.x, v.y);
+    }
+
+    // 判断矩形是否相交
+    bool collision(const vgRect& other) const
+    {
+        using namespace std;
+
+        float left   = max(x, other.x);
+        float top    = max(y, other.y);
+        float right  = min(x + w, other.x + other.w);
+        float bottom = min(y + h, other.y + other.h);
+
+        return (right - left) > 0.0f && (bottom - top) > 0.0f;
+    }
+};
+
+// 包围盒
+class AABB
+{
+public:
+    float x1, y1, x2, y2;
+
+public:
+    AABB()
+    {
+        reset();
+    }
+
+    AABB(float x1, float y1, float x2, float y2)
+    {
+        this->x1 = x1;
+        this->y1 = y1;
+        this->x2 = x2;
+        this->y2 = y2;
+    }
+
+    // 重置
+    void reset()
+    {
+        // 初始化一个无效的包围盒
+        x1 = y1 = FLT_MAX;  // 左上角最大值
+        x2 = y2 = -FLT_MAX; // 右下角最小值
+    }
+
+    // 判断包围盒面积是否为正数
+    bool is_valid() const
+    {
+        return x1 < x2 && y1 < y2;
+    }
+
+    // 附加一个点，扩展包围盒
+    void append(float x, float y)
+    {
+        using namespace std;
+
+        x1 = min(x1, x);
+        x2 = max(x2, x);
+        y1 = min(y1, y);
+        y2 = max(y2, y);
+    }
+
+    void append(const vec2f& v)
+    {
+        this->append(v.x, v.y);
+    }
+
+    // 返回宽度
+    float width() const
+    {
+        return x2 - x1;
+    }
+
+    // 返回高度
+    float height() const
+    {
+        return y2 - y1;
+    }
+
+    // 获取包围盒中心位置
+    vec2f center() const
+    {
+        // 无效
+        if (x1 > y2 || y2 < y1) {
+            return vec2f();
+        }
+
+        return vec2f(x1 + (this->width() / 2), y1 + (this->height() / 2));
+    }
+
+    // 移动包围盒
+    void move(float x, float y)
+    {
+        x1 += x;
+        y1 += y;
+        x2 += x;
+        y2 += y;
+    }
+
+    void move(const vec2f& v)
+    {
+        this->move(v.x, v.y);
+    }
+
+    // 判断包围盒是否包含点
+    bool contaits(float x, float y) const
+    {
+        return x >= x1 && y >= y1 && x < x2 && y < y2;
+    }
+
+    bool contaits(const vec2f& p) const
+    {
+        return this->contaits(p.x, p.y);
+    }
+
+    // 判断两个包围盒是否相交
+    bool collision(const AABB& other) const
+    {
+        using namespace std;
+
+        float left   = max(x1, other.x1);
+        float top    = max(y1, other.y1);
+        float right  = min(x2, other.x2);
+        float bottom = min(y2, other.y2);
+
+        return (right - left) > 0.0f && (bottom - top) > 0.0f;
+    }
+};
+
+//---------------------------------------------------------------------------
+// 绘图常量
+//---------------------------------------------------------------------------
+
+// 显示质量
+enum vgEffectLevel
+{
+    VG_SPEED,   // 速度优先
+    VG_MEDIUM,  // 中等质量
+    VG_QUALITY, // 质量优先
+};
+
+// 填充规则
+enum vgFillRule
+{
+    VG_NONZERO, // 非零环绕
+    VG_EVENODD, // 奇偶填充
+};
+
+// 混合模式，都是预乘 alpha 的公式
+enum vgBlendMode
+{
+    VG_BLEND_NORMAL,   // 源覆盖（默认）
+    VG_BLEND_ADD,      // 相加，src + dst
+    VG_BLEND_MULTIPLY, // 正片叠底，src * dst + src * (1 - dst.a) + dst * (1 - src.a)
+    VG_BLEND_SCREEN,   // 滤色，src + dst - src * dst
+    VG_BLEND_MIN,      // 变暗，src + dst - max(src * dst.a, dst * src.a)
+    VG_BLEND_MAX,      // 变亮，src + dst - min(src * dst.a, dst * src.a)
+    VG_BLEND_COPY,     // 复制，直接替换目标像素
+    VG_BLEND_COUNT
+};
+
+// 渐变类型
+enum vgGradientType
+{
+    VG_GRADIENT_LINEAR, // 线性渐变
+    VG_GRADIENT_RADIAL, // 径向渐变
+    VG_GRADIENT_CONIC   // 锥形渐变
+};
+
+// 渐变范围以外的颜色
+enum vgGradientSpread
+{
+    VG_SPREAD_PAD,      // 使用两端的颜色
+    VG_SPREAD_REPEAT,   // 重复
+    VG_SPREAD_REFLECT   // 镜像重复
+};
+
+// 图片缩放的滤波器
+enum vgImageFilter
+{
+    VG_FILTER_AUTO,     // 按显示质量逐像素采样（默认）
+    VG_FILTER_NEAREST,  // 最近邻
+    VG_FILTER_BILINEAR, // 双线性
+    VG_FILTER_BICUBIC,  // 双三次（Catmull-Rom）
+    VG_FILTER_LANCZOS   // Lanczos-3
+};
+
+// 拐角样式（和 Gdiplus::LineJoin 相同）
+enum vgLineJoin
+{
+    VG_JOIN_MITER, // 尖角（默认）
+    VG_JOIN_BEVEL, // 斜角
+    VG_JOIN_ROUND, // 圆角
+};
+
+// 线帽样式（和 Gdiplus::LineCap 相同）
+enum vgLineCap
+{
+    VG_CAP_FLAT,   // 平头（默认）
+    VG_CAP_SQUARE, // 方头
+    VG_CAP_ROUND,  // 圆头
+};
+
+//---------------------------------------------------------------------------
+// 像素、帧缓冲区
+//---------------------------------------------------------------------------
+
+// 预乘 BGRA 像素，内存顺序为 B G R A（小端序的 0xAARRGGBB）
+typedef uint32_t vgPixel;
+
+// 像素缓冲区视图，不负责内存管理
+class vgSurface
+{
+public:
+    vgPixel* pixels; // 第一行像素指针
+    int width;       // 宽度
+    int height;      // 高度
+    int stride;      // 行跨度（像素），自底向上的位图为负数
+
+public:
+    vgSurface() : pixels(), width(), height(), stride() { }
+
+    vgSurface(void* pixels, int width, int height, int stride) :
+        pixels(static_cast<vgPixel*>(pixels)),
+        width(width),
+        height(height),
+        stride(stride) { }
+
+    // 返回一行像素
+    vgPixel* row(int y) const
+    {
+        return pixels + ptrdiff_t(y) * stride;
+    }
+
+    // 判断是否为空
+    bool empty() const
+    {
+        return !pixels || width <= 0 || height <= 0;
+    }
+
+    // 返回一块区域的视图，区域需要在缓冲区范围内
+    vgSurface crop(int x, int y, int w, int h) const
+    {
+        if (this->empty()) {
+            return vgSurface();
+        }
+        return vgSurface(this->row(y) + x, w, h, stride);
+    }
+};
+
+// 2x3 仿射矩阵
+// x' = a * x + c * y + tx
+// y' = b * x + d * y + ty
+class vgMatrix
+{
+public:
+    float a, b, c, d, tx, ty;
+
+public:
+    vgMatrix() : a(1.0f), b(0.0f), c(0.0f), d(1.0f), tx(0.0f), ty(0.0f) { }
+
+    vgMatrix(float a, float b, float c, float d, float tx, float ty) :
+        a(a), b(b), c(c), d(d), tx(tx), ty(ty) { }
+
+    // 矩阵相乘，结果先应用 m，再应用 this
+    vgMatrix operator*(const vgMatrix& m) const
+    {
+        return vgMatrix(
+            a * m.a + c * m.b,
+            b * m.a + d * m.b,
+            a * m.c + c * m.d,
+            b * m.c + d * m.d,
+            a * m.tx + c * m.ty + tx,
+            b * m.tx + d * m.ty + ty
+        );
+    }
+
+    // 平移（和 Gdiplus::Matrix 一样，新的变换先应用）
+    vgMatrix& translate(float x, float y)
+    {
+        tx += a * x + c * y;
+        ty += b * x + d * y;
+        return *this;
+    }
+
+    // 旋转（角度），90 度的倍数使用精确的值，旋转以后仍然是轴对齐的
+    vgMatrix& rotate(float angle)
+    {
+        using namespace std;
+
+        float sine   = static_cast<float>(sin(angle * M_RD));
+        float cosine = static_cast<float>(cos(angle * M_RD));
+        const float turns = angle / 90.0f;
+        if (turns == floor(turns) && fabs(turns) < 16777216.0f) {
+            static const float table[5] = { 0.0f, 1.0f, 0.0f, -1.0f, 0.0f };
+            int k  = int(fmod(turns, 4.0f));
+            k      = k < 0 ? k + 4 : k;
+            sine   = table[k];
+            cosine = table[k + 1];
+        }
+        return *this = *this * vgMatrix(cosine, sine, -sine, cosine, 0.0f, 0.0f);
+    }
+
+    // 缩放
+    vgMatrix& scale(float x, float y)
+    {
+        a *= x;
+        b *= x;
+        c *= y;
+        d *= y;
+        return *this;
+    }
+
+    // 单位矩阵
+    bool is_identity() const
+    {
+        return this->is_translate() && tx == 0.0f && ty == 0.0f;
+    }
+
+    // 只有平移
+    bool is_translate() const
+    {
+        return a == 1.0f && b == 0.0f && c == 0.0f && d == 1.0f;
+    }
+
+    // 轴对齐：缩放、镜像和 90 度倍数的旋转，矩形变换以后仍然是矩形
+    bool is_axis_aligned() const
+    {
+        return (b == 0.0f && c == 0.0f) || (a == 0.0f && d == 0.0f);
+    }
+
+    // 逆矩阵，不可逆的时候返回零矩阵
+    vgMatrix inverse() const
+    {
+        float det = a * d - b * c;
+        if (is_zero(det)) {
+            return vgMatrix(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+        det = 1.0f / det;
+        return vgMatrix(
+            d * det, -b * det,
+            -c * det, a * det,
+            (c * ty - d * tx) * det,
+            (b * tx - a * ty) * det
+        );
+    }
+
+    // 变换一个点
+    vec2f transform(float x, float y) const
+    {
+        return vec2f(a * x + c * y + tx, b * x + d * y + ty);
+    }
+
+    vec2f transform(const vec2f& v) const
+    {
+        return this->transform(v.x, v.y);
+    }
+
+    // 变换一个矩形，返回包围盒，轴对齐的变换结果是准确的
+    vgRect transform(const vgRect& r) const
+    {
+        using namespace std;
+
+        vec2f p[4] = {
+            this->transform(r.x, r.y),
+            this->transform(r.x + r.w, r.y),
+            this->transform(r.x + r.w, r.y + r.h),
+            this->transform(r.x, r.y + r.h)
+        };
+        vec2f lo = p[0];
+        vec2f hi = p[0];
+        for (int i = 1; i < 4; ++i) {
+            lo.x = min(lo.x, p[i].x);
+            lo.y = min(lo.y, p[i].y);
+            hi.x = max(hi.x, p[i].x);
+            hi.y = max(hi.y, p[i].y);
+        }
+        return vgRect(lo.x, lo.y, hi.x - lo.x, hi.y - lo.y);
+    }
+};
+
+//---------------------------------------------------------------------------
+// 精灵
+//---------------------------------------------------------------------------
+
+class vgSprite
+{
+public:
+    vgRect source;          // 图片源范围
+    float x, y;             // 目标位置
+    float scaleX, scaleY;   // 缩放
+    float rotation;         // 旋转角度
+    float centerX, centerY; // 旋转中心(0.0 - 1.0 之间，按源大小比例设置旋转中心，其他值是像素位置)
+    float alpha;            // 透明度 0.0 - 1.0
+    uint32_t tint;          // 着色 0xAARRGGBB（没有预乘），图片颜色乘以着色，默认白色不改变颜色
+
+public:
+    vgSprite() :
+        source(), x(), y(), scaleX(1.0f), scaleY(1.0f), rotation(), centerX(0.5f), centerY(0.5f), alpha(1.0f),
+        tint(0xFFFFFFFF) { }
+
+    vgSprite(const vgRect& source, float x, float y, float scaleX = 1.0f, float scaleY = 1.0f, float rotation = 0.0f,
+        float centerX = 0.5f, float centerY = 0.5f, float alpha = 1.0f, uint32_t tint = 0xFFFFFFFF) :
+        source(source), x(x), y(y), scaleX(scaleX), scaleY(scaleY), rotation(rotation),
+        centerX(centerX), centerY(centerY), alpha(alpha), tint(tint) { }
+
+    // 透明度和着色合成的预乘调制颜色
+    uint32_t modulation() const
+    {
+        uint32_t a = static_cast<uint32_t>(std::min(alpha, 1.0f) * 255.0f + 0.5f);
+        if (!(alpha > 0.0f)) {
+            a = 0;
+        }
+        a = (a * (tint >> 24) + 127) / 255;
+        return (a << 24)
+            | ((((tint >> 16) & 0xFF) * a + 127) / 255 << 16)
+            | ((((tint >> 8) & 0xFF) * a + 127) / 255 << 8)
+            | ((tint & 0xFF) * a + 127) / 255;
+    }
+
+    // 源范围局部坐标 (0, 0) - (source.w, source.h) 到目标的变换，和 drawsprite 相同
+    vgMatrix matrix() const
+    {
+        float cx = centerX;
+        float cy = centerY;
+        if (cx >= 0.0f && cx < 1.0f) {
+            cx *= source.w;
+        }
+        if (cy >= 0.0f && cy < 1.0f) {
+            cy *= source.h;
+        }
+
+        // 翻转
+        float angle = rotation;
+        if (scaleX < 0.0f) {
+            angle = -angle;
+        }
+        if (scaleY < 0.0f) {
+            angle = -angle;
+        }
+
+        vgMatrix m;
+        m.translate(x, y);
+        m.rotate(-angle);
+        m.scale(scaleX, scaleY);
+        m.translate(-cx, -cy);
+        return m;
+    }
+};
+
+//---------------------------------------------------------------------------
+// mipmap
+//---------------------------------------------------------------------------
+
+/* 图片的 mipmap 金字塔，缩小绘制的时候从接近的一级采样，减少读取的像素和锯齿。
+ * 第 0 级是原图（不保存），每一级的宽高是上一级的一半（向上取整），
+ * 每个像素是上一级 2x2 像素的平均值，最后一级是 1x1。
+ */
+class vgMipmap
+{
+protected:
+    std::vector<vgPixel> m_pixels;   // 第 1 级开始所有级别的像素
+    std::vector<vgSurface> m_levels; // 第 1 级开始每一级的像素视图
+    int m_width;                     // 原图宽度
+    int m_height;                    // 原图高度
+
+public:
+    vgMipmap() : m_pixels(), m_levels(), m_width(), m_height() { }
+
+    // 释放所有级别
+    void clear()
+    {
+        std::vector<vgPixel>().swap(m_pixels);
+        m_levels.clear();
+        m_width  = 0;
+        m_height = 0;
+    }
+
+    bool empty() const
+    {
+        return m_levels.empty();
+    }
+
+    // 生成时原图的宽度
+    int width() const
+    {
+        return m_width;
+    }
+
+    // 生成时原图的高度
+    int height() const
+    {
+        return m_height;
+    }
+
+    // 级别数量，不包括原图
+    int size() const
+    {
+        return static_cast<int>(m_levels.size());
+    }
+
+    // 返回第 i 级（1 ~ size()）
+    const vgSurface& level(int i) const
+    {
+        return m_levels[i - 1];
+    }
+
+    // 从原图生成所有级别
+    void build(const vgSurface& image)
+    {
+        this->clear();
+        if (image.empty()) {
+            return;
+        }
+
+        size_t count = 0;
+        size_t total = 0;
+        for (int w = image.width, h = image.height; w > 1 || h > 1; ++count) {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            total += size_t(w) * h;
+        }
+        m_width  = image.width;
+        m_height = image.height;
+        if (!count) {
+            return;
+        }
+
+        m_pixels.resize(total);
+        m_levels.reserve(count);
+
+        vgPixel* p = &m_pixels[0];
+        vgSurface src = image;
+        for (size_t i = 0; i < count; ++i) {
+            int w = (src.width + 1) / 2;
+            int h = (src.height + 1) / 2;
+            vgSurface dst(p, w, h, w);
+            downsample(src, dst);
+            m_levels.push_back(dst);
+            src = dst;
+            p += size_t(w) * h;
+        }
+    }
+
+    /* 返回变换需要的级别 log2(每个目标像素对应的图片像素)，小于等于 0 的时候不是缩小
+     * m                图片坐标到目标坐标的变换
+     */
+    static float lod(const vgMatrix& m)
+    {
+        using namespace std;
+
+        float su = m.a * m.a + m.b * m.b;
+        float sv = m.c * m.c + m.d * m.d;
+        return -0.5f * static_cast<float>(log(min(su, sv)) * M_LOG2E);
+    }
+
+private:
+    // 2x2 像素求平均值，奇数宽高的最后一行、一列重复使用
+    static void downsample(const vgSurface& src, const vgSurface& dst)
+    {
+        using namespace std;
+
+        for (int y = 0; y < dst.height; ++y) {
+            const vgPixel* r1 = src.row(min(y * 2, src.height - 1));
+            const vgPixel* r2 = src.row(min(y * 2 + 1, src.height - 1));
+            vgPixel* d        = dst.row(y);
+            for (int x = 0; x < dst.width; ++x) {
+                int x1 = min(x * 2, src.width - 1);
+                int x2 = min(x * 2 + 1, src.width - 1);
+                d[x]   = average(r1[x1], r1[x2], r2[x1], r2[x2]);
+            }
+        }
+    }
+
+    // 四个像素的平均值，每个通道在 16 位里面累加
+    static vgPixel average(vgPixel a, vgPixel b, vgPixel c, vgPixel d)
+    {
+        uint32_t rb = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+        uint32_t ag = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF) + ((d >> 8) & 0x00FF00FF) + 0x00020002;
+        return ((rb >> 2) & 0x00FF00FF) | ((ag << 6) & 0xFF00FF00);
+    }
+};
+
+//---------------------------------------------------------------------------
+// 图集
+//---------------------------------------------------------------------------
+
+/* 天际线（skyline）矩形打包，只负责计算位置，不管理像素。
+ * 天际线记录每一段已经占用的最高位置，新矩形放在能放下的最低位置，
+ * 高度相同的时候选择浪费宽度最少的一段。
+ */
+class vgAtlasPacker
+{
+protected:
+    struct segment
+    {
+        int x, y, width;
+    };
+
+    std::vector<segment> m_skyline;
+    int m_width;
+    int m_height;
+    size_t m_used; // 已经使用的面积
+
+public:
+    vgAtlasPacker() : m_skyline(), m_width(), m_height(), m_used() { }
+
+    vgAtlasPacker(int width, int height) : m_skyline(), m_width(), m_height(), m_used()
+    {
+        this->init(width, height);
+    }
+
+    // 初始化一个空的页面
+    void init(int width, int height)
+    {
+        m_width  = std::max(width, 0);
+        m_height = std::max(height, 0);
+        this->clear();
+    }
+
+    // 清空已经打包的矩形
+    void clear()
+    {
+        segment s = { 0, 0, m_width };
+        m_skyline.assign(1, s);
+        m_used = 0;
+    }
+
+    int width() const
+    {
+        return m_width;
+    }
+
+    int height() const
+    {
+        return m_height;
+    }
+
+    // 已经使用的面积
+    size_t used_area() const
+    {
+        return m_used;
+    }
+
+    // 使用率 0.0 - 1.0
+    float occupancy() const
+    {
+        size_t area = size_t(m_width) * m_height;
+        return area ? float(double(m_used) / area) : 0.0f;
+    }
+
+    /* 放置一个矩形，成功返回 true
+     * width, height    矩形大小
+     * x, y             返回放置的位置
+     */
+    bool insert(int width, int height, int& x, int& y)
+    {
+        if (width <= 0 || height <= 0) {
+            return false;
+        }
+
+        size_t best   = m_skyline.size();
+        int bestTop   = INT_MAX;
+        int bestWaste = INT_MAX;
+        int bestY     = 0;
+        for (size_t i = 0; i < m_skyline.size(); ++i) {
+            int top, waste;
+            if (this->fit(i, width, height, top, waste)) {
+                if (top + height < bestTop || (top + height == bestTop && waste < bestWaste)) {
+                    best      = i;
+                    bestTop   = top + height;
+                    bestWaste = waste;
+                    bestY     = top;
+                }
+            }
+        }
+        if (best == m_skyline.size()) {
+            return false;
+        }
+
+        x = m_skyline[best].x;
+        y = bestY;
+        this->place(best, x, bestTop, width);
+        m_used += size_t(width) * height;
+        return true;
+    }
+
+private:
+    // 从第 i 段开始放置，返回放置的高度和下面浪费的面积
+    bool fit(size_t i, int width, int height, int& top, int& waste) const
+    {
+        int x = m_skyline[i].x;
+        if (x + width > m_width) {
+            return false;
+        }
+
+        top = 0;
+        int right = x + width;
+        for (size_t j = i; j < m_skyline.size() && m_skyline[j].x < right; ++j) {
+            top = std::max(top, m_skyline[j].y);
+        }
+        if (top + height > m_height) {
+            return false;
+        }
+
+        waste = 0;
+        for (size_t j = i; j < m_skyline.size() && m_skyline[j].x < right; ++j) {
+            int w = std::min(right, m_skyline[j].x + m_skyline[j].width) - m_skyline[j].x;
+            waste += (top - m_skyline[j].y) * w;
+        }
+        return true;
+    }
+
+    // 在第 i 段插入新的一段，截掉被覆盖的部分，合并高度相同的相邻段
+    void place(size_t i, int x, int y, int width)
+    {
+        segment s = { x, y, width };
+        m_skyline.insert(m_skyline.begin() + i, s);
+
+        int right = x + width;
+        size_t j  = i + 1;
+        while (j < m_skyline.size() && m_skyline[j].x < right) {
+            int end = m_skyline[j].x + m_skyline[j].width;
+            if (end <= right) {
+                m_skyline.erase(m_skyline.begin() + j);
+            }
+            else {
+                m_skyline[j].width = end - right;
+                m_skyline[j].x     = right;
+                break;
+            }
+        }
+
+        for (j = 0; j + 1 < m_skyline.size();) {
+            if (m_skyline[j].y == m_skyline[j + 1].y) {
+                m_skyline[j].width += m_skyline[j + 1].width;
+                m_skyline.erase(m_skyline.begin() + j + 1);
+            }
+            else {
+                ++j;
+            }
+        }
+    }
+};
+
+namespace detail {
+
+// 整数矩形 [x1, x2) x [y1, y2)
+struct irect
+{
+    int x1, y1, x2, y2;
+
+    irect() : x1(), y1(), x2(), y2() { }
+    irect(int x1, int y1, int x2, int y2) : x1(x1), y1(y1), x2(x2), y2(y2) { }
+
+    int width() const { return x2 - x1; }
+    int height() const { return y2 - y1; }
+
+    bool empty() const
+    {
+        return x1 >= x2 || y1 >= y2;
+    }
+
+    // 求交集
+    irect intersect(const irect& other) const
+    {
+        using namespace std;
+
+        return irect(max(x1, other.x1), max(y1, other.y1), min(x2, other.x2), min(y2, other.y2));
+    }
+
+    // 求并集（包围盒）
+    irect unite(const irect& other) const
+    {
+        using namespace std;
+
+        return irect(min(x1, other.x1), min(y1, other.y1), max(x2, other.x2), max(y2, other.y2));
+    }
+
+    // 判断是否包含另一个矩形
+    bool contains(const irect& other) const
+    {
+        return x1 <= other.x1 && y1 <= other.y1 && other.x2 <= x2 && other.y2 <= y2;
+    }
+
+    int64_t area() const
+    {
+        return empty() ? 0 : int64_t(width()) * height();
+    }
+};
+
+//---------------------------------------------------------------------------
+// 像素运算
+//---------------------------------------------------------------------------
+
+// x * y / 255
+inline uint32_t mul255(uint32_t x, uint32_t y)
+{
+    uint32_t t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// 颜色转预乘像素
+inline vgPixel premultiply(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    return (uint32_t(a) << 24) | (mul255(r, a) << 16) | (mul255(g, a) << 8) | mul255(b, a);
+}
+
+inline vgPixel premultiply(const vec4ub& color)
+{
+    return premultiply(color.r, color.g, color.b, color.a);
+}
+
+// 4 个分量同时乘以 k / 255
+inline vgPixel scale_pixel(vgPixel c, uint32_t k)
+{
+    uint32_t rb = (c & 0x00FF00FF) * k + 0x00800080;
+    uint32_t ag = ((c >> 8) & 0x00FF00FF) * k + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// 4 个分量分别乘以 m 的分量 / 255，m 是预乘颜色的时候结果仍然是预乘颜色
+inline vgPixel modulate_pixel(vgPixel c, vgPixel m)
+{
+    return (mul255(c >> 24, m >> 24) << 24)
+        | (mul255((c >> 16) & 0xFF, (m >> 16) & 0xFF) << 16)
+        | (mul255((c >> 8) & 0xFF, (m >> 8) & 0xFF) << 8)
+        | mul255(c & 0xFF, m & 0xFF);
+}
+
+// 源覆盖混合：dst = src + dst * (1 - src.a)
+inline vgPixel blend_over(vgPixel dst, vgPixel src)
+{
+    return src + scale_pixel(dst, 255 - (src >> 24));
+}
+
+// 按混合模式计算一个分量，sa、da 是源和目标的 alpha，结果限制到 255
+template<int MODE>
+inline uint32_t blend_channel(uint32_t s, uint32_t d, uint32_t sa, uint32_t da)
+{
+    using namespace std;
+
+    uint32_t r;
+    switch (MODE) {
+    case VG_BLEND_ADD:
+        r = s + d;
+        break;
+    case VG_BLEND_MULTIPLY:
+        r = mul255(s, d) + mul255(s, 255 - da) + mul255(d, 255 - sa);
+        break;
+    case VG_BLEND_SCREEN:
+        r = s + d - mul255(s, d);
+        break;
+    case VG_BLEND_MIN:
+        r = s + d - max(mul255(s, da), mul255(d, sa));
+        break;
+    case VG_BLEND_MAX:
+        r = s + d - min(mul255(s, da), mul255(d, sa));
+        break;
+    case VG_BLEND_COPY:
+        r = s;
+        break;
+    default:
+        r = s + mul255(d, 255 - sa);
+        break;
+    }
+    return min(r, 255u);
+}
+
+template<int MODE>
+inline vgPixel blend_mode_pixel(vgPixel dst, vgPixel src)
+{
+    const uint32_t sa = src >> 24;
+    const uint32_t da = dst >> 24;
+    return blend_channel<MODE>(src & 0xFF, dst & 0xFF, sa, da)
+        | (blend_channel<MODE>((src >> 8) & 0xFF, (dst >> 8) & 0xFF, sa, da) << 8)
+        | (blend_channel<MODE>((src >> 16) & 0xFF, (dst >> 16) & 0xFF, sa, da) << 16)
+        | (blend_channel<MODE>(sa, da, sa, da) << 24);
+}
+
+/* 使用混合模式混合一个像素
+ * cover 是覆盖率。复制模式按覆盖率在源和目标之间插值，其他模式对源是线性的，直接缩放源像素。
+ */
+inline vgPixel blend_pixel(vgPixel dst, vgPixel src, uint32_t cover, int mode)
+{
+    if (mode == VG_BLEND_NORMAL) {
+        return blend_over(dst, cover >= 255 ? src : scale_pixel(src, cover));
+    }
+    if (mode == VG_BLEND_COPY) {
+        return cover >= 255 ? src : scale_pixel(src, cover) + scale_pixel(dst, 255 - cover);
+    }
+
+    if (cover < 255) {
+        src = scale_pixel(src, cover);
+    }
+    switch (mode) {
+    case VG_BLEND_ADD:
+        return blend_mode_pixel<VG_BLEND_ADD>(dst, src);
+    case VG_BLEND_MULTIPLY:
+        return blend_mode_pixel<VG_BLEND_MULTIPLY>(dst, src);
+    case VG_BLEND_SCREEN:
+        return blend_mode_pixel<VG_BLEND_SCREEN>(dst, src);
+    case VG_BLEND_MIN:
+        return blend_mode_pixel<VG_BLEND_MIN>(dst, src);
+    case VG_BLEND_MAX:
+        return blend_mode_pixel<VG_BLEND_MAX>(dst, src);
+    default:
+        return blend_over(dst, src);
+    }
+}
+
+//---------------------------------------------------------------------------
+// 像素内核
+//
+// fill  用纯色填充一段像素
+// blend 把纯色（预乘）源覆盖混合到一段像素上
+// composite 把一段预乘像素覆盖混合到一段像素上
+// modes 每种混合模式的 composite
+// gradient 把渐变参数转换成颜色表里面的颜色
+// modulate 一段像素乘以一个颜色（精灵的透明度和着色）
+// resample_h 水平缩放一行像素，每个目标像素是一段源像素的定点数加权和
+// resample_v 垂直缩放，多行像素按权重合成一行
+//
+// 各个版本的计算结果完全相同，运行时根据 CPUID 选择最快的版本。
+//---------------------------------------------------------------------------
+
+enum
+{
+    CPU_SSE2 = 1,
+    CPU_AVX2 = 2,
+    CPU_NEON = 4
+};
+
+enum
+{
+    RAMP_SIZE  = 1024,   // 渐变颜色表大小
+    RAMP_LIMIT = 1 << 22 // 渐变参数的范围，超出的部分先限制到范围以内
+};
+
+enum
+{
+    RESAMPLE_BITS  = 14,                      // 缩放权重的定点数位数，权重和是 1 << RESAMPLE_BITS
+    RESAMPLE_ROUND = 1 << (RESAMPLE_BITS - 1)
+};
+
+typedef void (*span_func)(vgPixel* dst, int len, vgPixel color);
+typedef void (*accumulate_func)(const int32_t* acc, uint8_t* covers, int len, int rule, bool antialias);
+typedef void (*composite_func)(vgPixel* dst, const vgPixel* src, int len);
+typedef uint32_t (*hash_func)(const vgPixel* src, int len, uint32_t seed);
+typedef void (*gradient_func)(vgPixel* dst, const float* t, int len, const vgPixel* ramp, int spread);
+typedef void (*modulate_func)(vgPixel* dst, const vgPixel* src, int len, vgPixel color);
+typedef void (*resample_h_func)(vgPixel* dst, const vgPixel* src, int len, const int32_t* first, const int16_t* weights, int taps);
+typedef void (*resample_v_func)(vgPixel* dst, const vgPixel* const* rows, const int16_t* weights, int taps, int len);
+
+struct pixel_kernels
+{
+    span_func fill;
+    span_func blend;
+    accumulate_func accumulate;
+    composite_func composite;
+    hash_func hash;
+    composite_func modes[VG_BLEND_COUNT];
+    gradient_func gradient;
+    modulate_func modulate;
+    resample_h_func resample_h;
+    resample_v_func resample_v;
+};
+
+/* 面积转换成覆盖率
+ * area 是 24.8 定点数的两倍面积（一个像素是 256 * 256 * 2）
+ */
+inline uint8_t calc_alpha(int area, int rule, bool antialias)
+{
+    int cover = area >> 9;
+    if (cover < 0) {
+        cover = -cover;
+    }
+    if (rule == VG_EVENODD) {
+        cover &= 511;
+        if (cover > 256) {
+            cover = 512 - cover;
+        }
+    }
+    if (cover > 255) {
+        cover = 255;
+    }
+    if (!antialias) {
+        cover = cover >= 128 ? 255 : 0;
+    }
+    return static_cast<uint8_t>(cover);
+}
+
+// 四个字节相同的颜色（透明、白色、灰色）可以直接 memset
+inline bool is_byte_pattern(vgPixel color)
+{
+    return color == (color & 0xFF) * 0x01010101u;
+}
+
+inline void fill_scalar(vgPixel* dst, int len, vgPixel color)
+{
+    if (is_byte_pattern(color)) {
+        memset(dst, int(color & 0xFF), len * sizeof(vgPixel));
+    }
+    else {
+        std::fill(dst, dst + len, color);
+    }
+}
+
+inline void blend_scalar(vgPixel* dst, int len, vgPixel color)
+{
+    uint32_t k = 255 - (color >> 24);
+    if (k == 0) {
+        fill_scalar(dst, len, color);
+    }
+    else if (color) {
+        for (int i = 0; i < len; ++i) {
+            dst[i] = color + scale_pixel(dst[i], k);
+        }
+    }
+}
+
+inline void composite_scalar(vgPixel* dst, const vgPixel* src, int len)
+{
+    for (int i = 0; i < len; ++i) {
+        vgPixel c = src[i];
+        if (c >= 0xFF000000) {
+            dst[i] = c;
+        }
+        else if (c) {
+            dst[i] = c + scale_pixel(dst[i], 255 - (c >> 24));
+        }
+    }
+}
+
+template<int MODE>
+inline void composite_mode_scalar(vgPixel* dst, const vgPixel* src, int len)
+{
+    for (int i = 0; i < len; ++i) {
+        dst[i] = blend_mode_pixel<MODE>(dst[i], src[i]);
+    }
+}
+
+inline void composite_copy(vgPixel* dst, const vgPixel* src, int len)
+{
+    memmove(dst, src, len * sizeof(vgPixel));
+}
+
+/* 缩放的加权和转换成像素
+ * 负的权重可能让结果超出范围，先限制到 0 ~ 255，颜色再限制到不超过 alpha，保证还是有效的预乘像素
+ */
+inline vgPixel resample_pack(const int32_t* c)
+{
+    uint32_t p[4];
+    for (int i = 0; i < 4; ++i) {
+        int32_t n = (c[i] + RESAMPLE_ROUND) >> RESAMPLE_BITS;
+        p[i] = n < 0 ? 0 : (n > 255 ? 255 : n);
+    }
+    return (p[3] << 24) | (std::min(p[2], p[3]) << 16) | (std::min(p[1], p[3]) << 8) | std::min(p[0], p[3]);
+}
+
+/* 水平缩放
+ * len              目标像素数量
+ * first            每个目标像素的第一个源像素
+ * weights          每个目标像素 taps 个权重
+ */
+inline void resample_h_scalar(vgPixel* dst, const vgPixel* src, int len, const int32_t* first, const int16_t* weights, int taps)
+{
+    for (int i = 0; i < len; ++i, weights += taps) {
+        const vgPixel* s = src + first[i];
+        int32_t c[4] = { 0, 0, 0, 0 };
+        for (int j = 0; j < taps; ++j) {
+            const int32_t w = weights[j];
+            c[0] += int32_t(s[j] & 0xFF) * w;
+            c[1] += int32_t((s[j] >> 8) & 0xFF) * w;
+            c[2] += int32_t((s[j] >> 16) & 0xFF) * w;
+            c[3] += int32_t(s[j] >> 24) * w;
+        }
+        dst[i] = resample_pack(c);
+    }
+}
+
+// 垂直缩放 [i, len) 范围的像素，rows 是 taps 行源像素
+inline void resample_v_span(vgPixel* dst, const vgPixel* const* rows, const int16_t* weights, int taps, int i, int len)
+{
+    for (; i < len; ++i) {
+        int32_t c[4] = { 0, 0, 0, 0 };
+        for (int j = 0; j < taps; ++j) {
+            const vgPixel s = rows[j][i];
+            const int32_t w = weights[j];
+            c[0] += int32_t(s & 0xFF) * w;
+            c[1] += int32_t((s >> 8) & 0xFF) * w;
+            c[2] += int32_t((s >> 16) & 0xFF) * w;
+            c[3] += int32_t(s >> 24) * w;
+        }
+        dst[i] = resample_pack(c);
+    }
+}
+
+inline void resample_v_scalar(vgPixel* dst, const vgPixel* const* rows, const int16_t* weights, int taps, int len)
+{
+    resample_v_span(dst, rows, weights, taps, 0, len);
+}
+
+// 两个 16 位权重拼成 32 位，给 SIMD 版本的乘加使用，n 为 1 的时候第二个权重是 0
+inline int32_t resample_pair(const int16_t* w, int n)
+{
+    return int32_t(uint32_t(uint16_t(w[0])) | (n > 1 ? uint32_t(uint16_t(w[1])) << 16 : 0u));
+}
+
+inline void modulate_scalar(vgPixel* dst, const vgPixel* src, int len, vgPixel color)
+{
+    for (int i = 0; i < len; ++i) {
+        dst[i] = modulate_pixel(src[i], color);
+    }
+}
+
+/* 渐变颜色表的索引
+ * t 按扩展方式转换到 [0, 1]，再乘以颜色表大小取整。
+ * 比较的写法和 SIMD 的 max/min 相同（NaN 返回第二个参数），各个版本的结果相同。
+ */
+inline float floor_ramp(float t)
+{
+    float f = float(int(t));
+    return f > t ? f - 1.0f : f;
+}
+
+inline int ramp_index(float t, int spread)
+{
+    const float limit = float(RAMP_LIMIT);
+    t = t > -limit ? t : -limit;
+    t = t < limit ? t : limit;
+    if (spread == VG_SPREAD_REPEAT) {
+        t = t - floor_ramp(t);
+    }
+    else if (spread == VG_SPREAD_REFLECT) {
+        float w = t - floor_ramp(t * 0.5f) * 2.0f;
+        t = w > 1.0f ? 2.0f - w : w;
+    }
+    t = t > 0.0f ? t : 0.0f;
+    t = t * float(RAMP_SIZE);
+    t = t < float(RAMP_SIZE - 1) ? t : float(RAMP_SIZE - 1);
+    return int(t);
+}
+
+inline void gradient_scalar(vgPixel* dst, const float* t, int len, const vgPixel* ramp, int spread)
+{
+    for (int i = 0; i < len; ++i) {
+        dst[i] = ramp[ramp_index(t[i], spread)];
+    }
+}
+
+/* 像素哈希
+ * 8 路并行的 xxHash32 变体：每路每次吸收一个像素，不满 8 个的部分和长度在最后混合。
+ */
+enum
+{
+    HASH_LANES = 8
+};
+
+inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+inline uint32_t hash_prime(int i)
+{
+    static const uint32_t primes[] = { 2654435761U, 2246822519U, 3266489917U, 668265263U, 374761393U };
+    return primes[i];
+}
+
+inline void hash_init(uint32_t* acc, uint32_t seed)
+{
+    for (int j = 0; j < HASH_LANES; ++j) {
+        acc[j] = seed + hash_prime(0) * uint32_t(j + 1);
+    }
+}
+
+inline uint32_t hash_round(uint32_t acc, uint32_t value)
+{
+    return rotl32(acc + value * hash_prime(1), 13) * hash_prime(0);
+}
+
+inline uint32_t hash_finish(const uint32_t* acc, const vgPixel* tail, int count, int len)
+{
+    uint32_t h = hash_prime(4) + uint32_t(len) * 4;
+    for (int j = 0; j < HASH_LANES; ++j) {
+        h += rotl32(acc[j], j * 4 + 1);
+    }
+    for (int i = 0; i < count; ++i) {
+        h = rotl32(h + tail[i] * hash_prime(2), 17) * hash_prime(3);
+    }
+    h ^= h >> 15;
+    h *= hash_prime(1);
+    h ^= h >> 13;
+    h *= hash_prime(2);
+    h ^= h >> 16;
+    return h;
+}
+
+inline uint32_t hash_scalar(const vgPixel* src, int len, uint32_t seed)
+{
+    uint32_t acc[HASH_LANES];
+    hash_init(acc, seed);
+    int i = 0;
+    for (; i + HASH_LANES <= len; i += HASH_LANES) {
+        for (int j = 0; j < HASH_LANES; ++j) {
+            acc[j] = hash_round(acc[j], src[i + j]);
+        }
+    }
+    return hash_finish(acc, src + i, len - i, len);
+}
+
+// 累加缓冲区一行求前缀和，转换成覆盖率
+inline void accumulate_scalar(const int32_t* acc, uint8_t* covers, int len, int rule, bool antialias)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < len; ++i) {
+        sum += acc[i];
+        covers[i] = calc_alpha(sum, rule, antialias);
+    }
+}
+
+#ifdef MINIVG_SIMD_X86
+
+// 查询 CPU 支持的指令集
+inline int cpu_features()
+{
+    int features = 0;
+    uint32_t ecx1 = 0, edx1 = 0, ebx7 = 0;
+
+    #ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int count = info[0];
+    __cpuid(info, 1);
+    ecx1 = info[2];
+    edx1 = info[3];
+    if (count >= 7) {
+        __cpuidex(info, 7, 0);
+        ebx7 = info[1];
+    }
+    #else
+    uint32_t a, b, c, d;
+    uint32_t count = __get_cpuid_max(0, 0);
+    if (count >= 1) {
+        __cpuid(1, a, b, c, d);
+        ecx1 = c;
+        edx1 = d;
+    }
+    if (count >= 7) {
+        __cpuid_count(7, 0, a, b, c, d);
+        ebx7 = b;
+    }
+    #endif
+
+    if (edx1 & (1 << 26)) {
+        features |= CPU_SSE2;
+    }
+
+    // AVX2 还需要操作系统保存 YMM 寄存器（OSXSAVE + XCR0）
+    if ((ecx1 & (1 << 27)) && (ecx1 & (1 << 28)) && (ebx7 & (1 << 5))) {
+        #ifdef _MSC_VER
+        uint64_t xcr0 = _xgetbv(0);
+        #else
+        uint32_t lo, hi;
+        __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        uint64_t xcr0 = (uint64_t(hi) << 32) | lo;
+        #endif
+        if ((xcr0 & 6) == 6) {
+            features |= CPU_AVX2;
+        }
+    }
+    return features;
+}
+
+MINIVG_TARGET_SSE2 inline void fill_sse2(vgPixel* dst, int len, vgPixel color)
+{
+    if (is_byte_pattern(color)) {
+        memset(dst, int(color & 0xFF), len * sizeof(vgPixel));
+        return;
+    }
+
+    __m128i c = _mm_set1_epi32(int(color));
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), c);
+    }
+    for (; i < len; ++i) {
+        dst[i] = color;
+    }
+}
+
+// 每个通道：t = d * k + 128; d = (t + (t >> 8)) >> 8，和 scale_pixel 相同
+MINIVG_TARGET_SSE2 inline void blend_sse2(vgPixel* dst, int len, vgPixel color)
+{
+    uint32_t k = 255 - (color >> 24);
+    if (k == 0) {
+        fill_sse2(dst, len, color);
+        return;
+    }
+    if (!color) {
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i vk   = _mm_set1_epi16(short(k));
+    const __m128i c    = _mm_set1_epi32(int(color));
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128i d  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), vk), half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), vk), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        d  = _mm_add_epi8(_mm_packus_epi16(lo, hi), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), d);
+    }
+    for (; i < len; ++i) {
+        dst[i] = color + scale_pixel(dst[i], k);
+    }
+}
+
+// 每个像素的 255 - alpha 复制到 4 个 16 位通道，其他和 blend_sse2 相同
+MINIVG_TARGET_SSE2 inline void composite_sse2(vgPixel* dst, const vgPixel* src, int len)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i half  = _mm_set1_epi16(128);
+    const __m128i v255  = _mm_set1_epi32(255);
+    const __m128i amask = _mm_set1_epi32(int(0xFF000000));
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+        // 全部不透明直接复制，全部透明跳过
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, amask), amask)) == 0xFFFF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xFFFF) {
+            continue;
+        }
+
+        __m128i k  = _mm_sub_epi32(v255, _mm_srli_epi32(s, 24));
+        k          = _mm_or_si128(k, _mm_slli_epi32(k, 16));
+        __m128i d  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(k, k)), half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(k, k)), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        d  = _mm_add_epi8(_mm_packus_epi16(lo, hi), s);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), d);
+    }
+    composite_scalar(dst + i, src + i, len - i);
+}
+
+/* 混合模式
+ * 像素展开成 16 位分量计算，alpha 复制到 4 个分量，打包的时候饱和到 255，和 blend_channel 相同。
+ */
+MINIVG_TARGET_SSE2 inline __m128i mul255_sse2(__m128i a, __m128i b)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+template<int MODE>
+MINIVG_TARGET_SSE2 inline __m128i blend_mode_sse2(__m128i s, __m128i d)
+{
+    const __m128i v255 = _mm_set1_epi16(255);
+    const __m128i sa   = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i da   = _mm_shufflehi_epi16(_mm_shufflelo_epi16(d, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    switch (MODE) {
+    case VG_BLEND_ADD:
+        return _mm_add_epi16(s, d);
+    case VG_BLEND_MULTIPLY:
+        return _mm_add_epi16(_mm_add_epi16(mul255_sse2(s, d), mul255_sse2(s, _mm_sub_epi16(v255, da))), mul255_sse2(d, _mm_sub_epi16(v255, sa)));
+    case VG_BLEND_SCREEN:
+        return _mm_sub_epi16(_mm_add_epi16(s, d), mul255_sse2(s, d));
+    case VG_BLEND_MIN:
+        return _mm_sub_epi16(_mm_add_epi16(s, d), _mm_max_epi16(mul255_sse2(s, da), mul255_sse2(d, sa)));
+    case VG_BLEND_MAX:
+        return _mm_sub_epi16(_mm_add_epi16(s, d), _mm_min_epi16(mul255_sse2(s, da), mul255_sse2(d, sa)));
+    default:
+        return _mm_add_epi16(s, mul255_sse2(d, _mm_sub_epi16(v255, sa)));
+    }
+}
+
+template<int MODE>
+MINIVG_TARGET_SSE2 inline void composite_mode_sse2(vgPixel* dst, const vgPixel* src, int len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128i s  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i d  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = blend_mode_sse2<MODE>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = blend_mode_sse2<MODE>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    composite_mode_scalar<MODE>(dst + i, src + i, len - i);
+}
+
+// 颜色调制：像素的 4 个分量分别乘以 color 的分量
+MINIVG_TARGET_SSE2 inline void modulate_sse2(vgPixel* dst, const vgPixel* src, int len, vgPixel color)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i m    = _mm_unpacklo_epi8(_mm_set1_epi32(int(color)), zero);
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128i s  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = mul255_sse2(_mm_unpacklo_epi8(s, zero), m);
+        __m128i hi = mul255_sse2(_mm_unpackhi_epi8(s, zero), m);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    modulate_scalar(dst + i, src + i, len - i, color);
+}
+
+/* 缩放：_mm_madd_epi16 一次计算两个权重的乘加
+ * 两个源像素交错成 b0 b1 g0 g1 r0 r1 a0 a1，和 w0 w1 相乘相加得到 4 个通道的 32 位和
+ */
+
+// 4 个通道的和转换成像素，结果和 resample_pack 相同
+MINIVG_TARGET_SSE2 inline __m128i resample_pack_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    const __m128i round = _mm_set1_epi32(RESAMPLE_ROUND);
+    a = _mm_srai_epi32(_mm_add_epi32(a, round), RESAMPLE_BITS);
+    b = _mm_srai_epi32(_mm_add_epi32(b, round), RESAMPLE_BITS);
+    c = _mm_srai_epi32(_mm_add_epi32(c, round), RESAMPLE_BITS);
+    d = _mm_srai_epi32(_mm_add_epi32(d, round), RESAMPLE_BITS);
+    __m128i p = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+    // 颜色不超过 alpha
+    __m128i alpha = _mm_and_si128(p, _mm_set1_epi32(int(0xFF000000)));
+    alpha = _mm_or_si128(alpha, _mm_srli_epi32(alpha, 8));
+    alpha = _mm_or_si128(alpha, _mm_srli_epi32(alpha, 16));
+    return _mm_min_epu8(p, alpha);
+}
+
+MINIVG_TARGET_SSE2 inline __m128i resample_taps_sse2(const vgPixel* s, const int16_t* w, int j, int taps, __m128i acc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (; j + 2 <= taps; j += 2) {
+        __m128i p = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + j));
+        p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p, _mm_srli_si128(p, 4)), zero);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(resample_pair(w + j, 2))));
+    }
+    if (j < taps) {
+        __m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128(int(s[j])), zero);
+        p = _mm_unpacklo_epi16(p, zero);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(resample_pair(w + j, 1))));
+    }
+    return acc;
+}
+
+MINIVG_TARGET_SSE2 inline void resample_h_sse2(vgPixel* dst, const vgPixel* src, int len, const int32_t* first, const int16_t* weights, int taps)
+{
+    for (int i = 0; i < len; ++i, weights += taps) {
+        __m128i acc = resample_taps_sse2(src + first[i], weights, 0, taps, _mm_setzero_si128());
+        dst[i] = vgPixel(_mm_cvtsi128_si32(resample_pack_sse2(acc, acc, acc, acc)));
+    }
+}
+
+// 垂直缩放：两行像素交错，一次处理 4 个像素
+MINIVG_TARGET_SSE2 inline void resample_v_sse2(vgPixel* dst, const vgPixel* const* rows, const int16_t* weights, int taps, int len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128i acc0 = zero;
+        __m128i acc1 = zero;
+        __m128i acc2 = zero;
+        __m128i acc3 = zero;
+        for (int j = 0; j < taps; j += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[j] + i));
+            __m128i b = j + 1 < taps ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[j + 1] + i)) : zero;
+            __m128i w = _mm_set1_epi32(resample_pair(weights + j, taps - j));
+            __m128i lo = _mm_unpacklo_epi8(a, b);
+            __m128i hi = _mm_unpackhi_epi8(a, b);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), resample_pack_sse2(acc0, acc1, acc2, acc3));
+    }
+    resample_v_span(dst, rows, weights, taps, i, len);
+}
+
+// 渐变：4 个参数一起计算索引，查表还是逐个读取
+MINIVG_TARGET_SSE2 inline __m128 floor_ramp_sse2(__m128 t)
+{
+    __m128 f = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    return _mm_sub_ps(f, _mm_and_ps(_mm_cmpgt_ps(f, t), _mm_set1_ps(1.0f)));
+}
+
+MINIVG_TARGET_SSE2 inline __m128i ramp_index_sse2(__m128 t, int spread)
+{
+    const __m128 limit = _mm_set1_ps(float(RAMP_LIMIT));
+    const __m128 one   = _mm_set1_ps(1.0f);
+    const __m128 two   = _mm_set1_ps(2.0f);
+    t = _mm_min_ps(_mm_max_ps(t, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+    if (spread == VG_SPREAD_REPEAT) {
+        t = _mm_sub_ps(t, floor_ramp_sse2(t));
+    }
+    else if (spread == VG_SPREAD_REFLECT) {
+        __m128 w    = _mm_sub_ps(t, _mm_mul_ps(floor_ramp_sse2(_mm_mul_ps(t, _mm_set1_ps(0.5f))), two));
+        __m128 mask = _mm_cmpgt_ps(w, one);
+        t = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(two, w)), _mm_andnot_ps(mask, w));
+    }
+    t = _mm_max_ps(t, _mm_setzero_ps());
+    t = _mm_min_ps(_mm_mul_ps(t, _mm_set1_ps(float(RAMP_SIZE))), _mm_set1_ps(float(RAMP_SIZE - 1)));
+    return _mm_cvttps_epi32(t);
+}
+
+MINIVG_TARGET_SSE2 inline void gradient_sse2(vgPixel* dst, const float* t, int len, const vgPixel* ramp, int spread)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        int32_t index[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(index), ramp_index_sse2(_mm_loadu_ps(t + i), spread));
+        dst[i]     = ramp[index[0]];
+        dst[i + 1] = ramp[index[1]];
+        dst[i + 2] = ramp[index[2]];
+        dst[i + 3] = ramp[index[3]];
+    }
+    gradient_scalar(dst + i, t + i, len - i, ramp, spread);
+}
+
+// SSE2 没有 32 位乘法，用两次 32x32 -> 64 位乘法组合
+MINIVG_TARGET_SSE2 inline __m128i mullo32_sse2(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+MINIVG_TARGET_SSE2 inline __m128i hash_round_sse2(__m128i acc, __m128i value, __m128i p1, __m128i p2)
+{
+    acc = _mm_add_epi32(acc, mullo32_sse2(value, p2));
+    acc = _mm_or_si128(_mm_slli_epi32(acc, 13), _mm_srli_epi32(acc, 19));
+    return mullo32_sse2(acc, p1);
+}
+
+MINIVG_TARGET_SSE2 inline uint32_t hash_sse2(const vgPixel* src, int len, uint32_t seed)
+{
+    uint32_t acc[HASH_LANES];
+    hash_init(acc, seed);
+    if (len < HASH_LANES) {
+        return hash_finish(acc, src, len, len);
+    }
+
+    const __m128i p1 = _mm_set1_epi32(int(hash_prime(0)));
+    const __m128i p2 = _mm_set1_epi32(int(hash_prime(1)));
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc));
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 4));
+    int i = 0;
+    for (; i + HASH_LANES <= len; i += HASH_LANES) {
+        a0 = hash_round_sse2(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), p1, p2);
+        a1 = hash_round_sse2(a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)), p1, p2);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), a0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 4), a1);
+    return hash_finish(acc, src + i, len - i, len);
+}
+
+// 4 个一组求前缀和：x += x << 1 格; x += x << 2 格; 再加上前一组的和
+MINIVG_TARGET_SSE2 inline void accumulate_sse2(const int32_t* acc, uint8_t* covers, int len, int rule, bool antialias)
+{
+    const __m128i mask   = _mm_set1_epi32(511);
+    const __m128i v256   = _mm_set1_epi32(256);
+    const __m128i v512   = _mm_set1_epi32(512);
+    const __m128i v127   = _mm_set1_epi32(127);
+    const __m128i v255   = _mm_set1_epi32(255);
+    const bool evenodd = rule == VG_EVENODD;
+
+    __m128i carry = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+
+        // calc_alpha
+        __m128i c = _mm_srai_epi32(x, 9);
+        __m128i s = _mm_srai_epi32(c, 31);
+        c = _mm_sub_epi32(_mm_xor_si128(c, s), s);
+        if (evenodd) {
+            c = _mm_and_si128(c, mask);
+            __m128i m = _mm_cmpgt_epi32(c, v256);
+            c = _mm_or_si128(_mm_and_si128(m, _mm_sub_epi32(v512, c)), _mm_andnot_si128(m, c));
+        }
+        if (!antialias) {
+            c = _mm_and_si128(_mm_cmpgt_epi32(c, v127), v255);
+        }
+
+        // 饱和打包，超过 255 的截断到 255
+        c = _mm_packs_epi32(c, c);
+        c = _mm_packus_epi16(c, c);
+        int32_t bytes = _mm_cvtsi128_si32(c);
+        memcpy(covers + i, &bytes, 4);
+    }
+
+    int32_t sum = _mm_cvtsi128_si32(carry);
+    for (; i < len; ++i) {
+        sum += acc[i];
+        covers[i] = calc_alpha(sum, rule, antialias);
+    }
+}
+
+MINIVG_TARGET_AVX2 inline void fill_avx2(vgPixel* dst, int len, vgPixel color)
+{
+    if (is_byte_pattern(color)) {
+        memset(dst, int(color & 0xFF), len * sizeof(vgPixel));
+        return;
+    }
+
+    __m256i c = _mm256_set1_epi32(int(color));
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), c);
+    }
+    for (; i < len; ++i) {
+        dst[i] = color;
+    }
+}
+
+MINIVG_TARGET_AVX2 inline void blend_avx2(vgPixel* dst, int len, vgPixel color)
+{
+    uint32_t k = 255 - (color >> 24);
+    if (k == 0) {
+        fill_avx2(dst, len, color);
+        return;
+    }
+    if (!color) {
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    const __m256i vk   = _mm256_set1_epi16(short(k));
+    const __m256i c    = _mm256_set1_epi32(int(color));
+
+    // unpack 和 pack 都在 128 位通道内进行，像素顺序不变
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256i d  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), vk), half);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), vk), half);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        d  = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), d);
+    }
+    for (; i < len; ++i) {
+        dst[i] = color + scale_pixel(dst[i], k);
+    }
+}
+
+MINIVG_TARGET_AVX2 inline void composite_avx2(vgPixel* dst, const vgPixel* src, int len)
+{
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i half  = _mm256_set1_epi16(128);
+    const __m256i v255  = _mm256_set1_epi32(255);
+    const __m256i amask = _mm256_set1_epi32(int(0xFF000000));
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(s, amask), amask)) == -1) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), s);
+            continue;
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(s, zero)) == -1) {
+            continue;
+        }
+
+        __m256i k  = _mm256_sub_epi32(v255, _mm256_srli_epi32(s, 24));
+        k          = _mm256_or_si256(k, _mm256_slli_epi32(k, 16));
+        __m256i d  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi32(k, k)), half);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi32(k, k)), half);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        d  = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), s);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), d);
+    }
+    composite_scalar(dst + i, src + i, len - i);
+}
+
+MINIVG_TARGET_AVX2 inline __m256i mul255_avx2(__m256i a, __m256i b)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+template<int MODE>
+MINIVG_TARGET_AVX2 inline __m256i blend_mode_avx2(__m256i s, __m256i d)
+{
+    const __m256i v255 = _mm256_set1_epi16(255);
+    const __m256i sa   = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i da   = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(d, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    switch (MODE) {
+    case VG_BLEND_ADD:
+        return _mm256_add_epi16(s, d);
+    case VG_BLEND_MULTIPLY:
+        return _mm256_add_epi16(_mm256_add_epi16(mul255_avx2(s, d), mul255_avx2(s, _mm256_sub_epi16(v255, da))), mul255_avx2(d, _mm256_sub_epi16(v255, sa)));
+    case VG_BLEND_SCREEN:
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), mul255_avx2(s, d));
+    case VG_BLEND_MIN:
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), _mm256_max_epi16(mul255_avx2(s, da), mul255_avx2(d, sa)));
+    case VG_BLEND_MAX:
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), _mm256_min_epi16(mul255_avx2(s, da), mul255_avx2(d, sa)));
+    default:
+        return _mm256_add_epi16(s, mul255_avx2(d, _mm256_sub_epi16(v255, sa)));
+    }
+}
+
+// unpack 和 pack 都在 128 位通道内进行，像素顺序不变
+template<int MODE>
+MINIVG_TARGET_AVX2 inline void composite_mode_avx2(vgPixel* dst, const vgPixel* src, int len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256i s  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i d  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i lo = blend_mode_avx2<MODE>(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+        __m256i hi = blend_mode_avx2<MODE>(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    composite_mode_scalar<MODE>(dst + i, src + i, len - i);
+}
+
+MINIVG_TARGET_AVX2 inline void modulate_avx2(vgPixel* dst, const vgPixel* src, int len, vgPixel color)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i m    = _mm256_unpacklo_epi8(_mm256_set1_epi32(int(color)), zero);
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256i s  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = mul255_avx2(_mm256_unpacklo_epi8(s, zero), m);
+        __m256i hi = mul255_avx2(_mm256_unpackhi_epi8(s, zero), m);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    modulate_scalar(dst + i, src + i, len - i, color);
+}
+
+// 缩放：一次处理 4 个权重，源像素用 pshufb 交错
+MINIVG_TARGET_AVX2 inline void resample_h_avx2(vgPixel* dst, const vgPixel* src, int len, const int32_t* first, const int16_t* weights, int taps)
+{
+    const __m128i order = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    const __m256i pairs = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    for (int i = 0; i < len; ++i, weights += taps) {
+        const vgPixel* s = src + first[i];
+        __m256i acc = _mm256_setzero_si256();
+        int j = 0;
+        for (; j + 4 <= taps; j += 4) {
+            // 低 128 位是 w0 w1，高 128 位是 w2 w3，在寄存器里面展开，避免存储转发失败
+            __m128i p = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + j)), order);
+            __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + j));
+            __m256i w = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(q), pairs);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_cvtepu8_epi16(p), w));
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum = resample_taps_sse2(s, weights, j, taps, sum);
+        dst[i] = vgPixel(_mm_cvtsi128_si32(resample_pack_sse2(sum, sum, sum, sum)));
+    }
+}
+
+// 垂直缩放：一次处理 8 个像素，解包和打包都在 128 位通道内，像素顺序不变
+MINIVG_TARGET_AVX2 inline void resample_v_avx2(vgPixel* dst, const vgPixel* const* rows, const int16_t* weights, int taps, int len)
+{
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(RESAMPLE_ROUND);
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256i acc0 = zero;
+        __m256i acc1 = zero;
+        __m256i acc2 = zero;
+        __m256i acc3 = zero;
+        for (int j = 0; j < taps; j += 2) {
+            __m256i a  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[j] + i));
+            __m256i b  = j + 1 < taps ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[j + 1] + i)) : zero;
+            __m256i w  = _mm256_set1_epi32(resample_pair(weights + j, taps - j));
+            __m256i lo = _mm256_unpacklo_epi8(a, b);
+            __m256i hi = _mm256_unpackhi_epi8(a, b);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+        }
+        acc0 = _mm256_srai_epi32(_mm256_add_epi32(acc0, round), RESAMPLE_BITS);
+        acc1 = _mm256_srai_epi32(_mm256_add_epi32(acc1, round), RESAMPLE_BITS);
+        acc2 = _mm256_srai_epi32(_mm256_add_epi32(acc2, round), RESAMPLE_BITS);
+        acc3 = _mm256_srai_epi32(_mm256_add_epi32(acc3, round), RESAMPLE_BITS);
+        __m256i p = _mm256_packus_epi16(_mm256_packs_epi32(acc0, acc1), _mm256_packs_epi32(acc2, acc3));
+
+        __m256i alpha = _mm256_and_si256(p, _mm256_set1_epi32(int(0xFF000000)));
+        alpha = _mm256_or_si256(alpha, _mm256_srli_epi32(alpha, 8));
+        alpha = _mm256_or_si256(alpha, _mm256_srli_epi32(alpha, 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_min_epu8(p, alpha));
+    }
+    resample_v_span(dst, rows, weights, taps, i, len);
+}
+
+// 渐变：8 个参数一起计算索引，用 gather 查表
+MINIVG_TARGET_AVX2 inline __m256 floor_ramp_avx2(__m256 t)
+{
+    __m256 f = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(t));
+    return _mm256_sub_ps(f, _mm256_and_ps(_mm256_cmp_ps(f, t, _CMP_GT_OQ), _mm256_set1_ps(1.0f)));
+}
+
+MINIVG_TARGET_AVX2 inline void gradient_avx2(vgPixel* dst, const float* t, int len, const vgPixel* ramp, int spread)
+{
+    const __m256 limit = _mm256_set1_ps(float(RAMP_LIMIT));
+    const __m256 lower = _mm256_set1_ps(-float(RAMP_LIMIT));
+    const __m256 zero  = _mm256_setzero_ps();
+    const __m256 one   = _mm256_set1_ps(1.0f);
+    const __m256 two   = _mm256_set1_ps(2.0f);
+    const __m256 half  = _mm256_set1_ps(0.5f);
+    const __m256 size  = _mm256_set1_ps(float(RAMP_SIZE));
+    const __m256 last  = _mm256_set1_ps(float(RAMP_SIZE - 1));
+    const int* table   = reinterpret_cast<const int*>(ramp);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(t + i), lower), limit);
+        if (spread == VG_SPREAD_REPEAT) {
+            v = _mm256_sub_ps(v, floor_ramp_avx2(v));
+        }
+        else if (spread == VG_SPREAD_REFLECT) {
+            __m256 w = _mm256_sub_ps(v, _mm256_mul_ps(floor_ramp_avx2(_mm256_mul_ps(v, half)), two));
+            v = _mm256_blendv_ps(w, _mm256_sub_ps(two, w), _mm256_cmp_ps(w, one, _CMP_GT_OQ));
+        }
+        v = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(v, zero), size), last);
+        __m256i c = _mm256_i32gather_epi32(table, _mm256_cvttps_epi32(v), 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+    }
+    gradient_scalar(dst + i, t + i, len - i, ramp, spread);
+}
+
+MINIVG_TARGET_AVX2 inline uint32_t hash_avx2(const vgPixel* src, int len, uint32_t seed)
+{
+    uint32_t acc[HASH_LANES];
+    hash_init(acc, seed);
+    if (len < HASH_LANES) {
+        return hash_finish(acc, src, len, len);
+    }
+
+    const __m256i p1 = _mm256_set1_epi32(int(hash_prime(0)));
+    const __m256i p2 = _mm256_set1_epi32(int(hash_prime(1)));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    int i = 0;
+    for (; i + HASH_LANES <= len; i += HASH_LANES) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        a = _mm256_add_epi32(a, _mm256_mullo_epi32(v, p2));
+        a = _mm256_or_si256(_mm256_slli_epi32(a, 13), _mm256_srli_epi32(a, 19));
+        a = _mm256_mullo_epi32(a, p1);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a);
+    return hash_finish(acc, src + i, len - i, len);
+}
+
+#elif defined(MINIVG_SIMD_NEON)
+
+inline int cpu_features()
+{
+    return CPU_NEON;
+}
+
+inline void fill_neon(vgPixel* dst, int len, vgPixel color)
+{
+    if (is_byte_pattern(color)) {
+        memset(dst, int(color & 0xFF), len * sizeof(vgPixel));
+        return;
+    }
+
+    uint32x4_t c = vdupq_n_u32(color);
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        vst1q_u32(dst + i, c);
+        vst1q_u32(dst + i + 4, c);
+    }
+    for (; i < len; ++i) {
+        dst[i] = color;
+    }
+}
+
+inline void accumulate_neon(const int32_t* acc, uint8_t* covers, int len, int rule, bool antialias)
+{
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t mask = vdupq_n_s32(511);
+    const int32x4_t v256 = vdupq_n_s32(256);
+    const int32x4_t v512 = vdupq_n_s32(512);
+    const int32x4_t v127 = vdupq_n_s32(127);
+    const int32x4_t v255 = vdupq_n_s32(255);
+    const bool evenodd = rule == VG_EVENODD;
+
+    int32x4_t carry = zero;
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        int32x4_t x = vld1q_s32(acc + i);
+        x = vaddq_s32(x, vextq_s32(zero, x, 3));
+        x = vaddq_s32(x, vextq_s32(zero, x, 2));
+        x = vaddq_s32(x, carry);
+        carry = vdupq_n_s32(vgetq_lane_s32(x, 3));
+
+        int32x4_t c = vabsq_s32(vshrq_n_s32(x, 9));
+        if (evenodd) {
+            c = vandq_s32(c, mask);
+            c = vbslq_s32(vcgtq_s32(c, v256), vsubq_s32(v512, c), c);
+        }
+        c = vminq_s32(c, v255);
+        if (!antialias) {
+            c = vandq_s32(vreinterpretq_s32_u32(vcgtq_s32(c, v127)), v255);
+        }
+
+        uint8x8_t b = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(c)), vdup_n_u16(0)));
+        vst1_lane_u32(reinterpret_cast<uint32_t*>(covers + i), vreinterpret_u32_u8(b), 0);
+    }
+
+    int32_t sum = vgetq_lane_s32(carry, 0);
+    for (; i < len; ++i) {
+        sum += acc[i];
+        covers[i] = calc_alpha(sum, rule, antialias);
+    }
+}
+
+inline void blend_neon(vgPixel* dst, int len, vgPixel color)
+{
+    uint32_t k = 255 - (color >> 24);
+    if (k == 0) {
+        fill_neon(dst, len, color);
+        return;
+    }
+    if (!color) {
+        return;
+    }
+
+    const uint16x8_t half = vdupq_n_u16(128);
+    const uint8x8_t vk    = vdup_n_u8(uint8_t(k));
+    const uint8x16_t c    = vreinterpretq_u8_u32(vdupq_n_u32(color));
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint8x16_t d  = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+        uint16x8_t lo = vmlal_u8(half, vget_low_u8(d), vk);
+        uint16x8_t hi = vmlal_u8(half, vget_high_u8(d), vk);
+        uint8x8_t rlo = vshrn_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8);
+        uint8x8_t rhi = vshrn_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8);
+        d = vaddq_u8(vcombine_u8(rlo, rhi), c);
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(d));
+    }
+    for (; i < len; ++i) {
+        dst[i] = color + scale_pixel(dst[i], k);
+    }
+}
+
+// 每个像素的 255 - alpha 复制到 4 个字节
+inline void composite_neon(vgPixel* dst, const vgPixel* src, int len)
+{
+    const uint16x8_t half = vdupq_n_u16(128);
+    const uint32x4_t v255 = vdupq_n_u32(255);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32x4_t s32 = vld1q_u32(src + i);
+        uint8x16_t k   = vreinterpretq_u8_u32(vmulq_n_u32(vsubq_u32(v255, vshrq_n_u32(s32, 24)), 0x01010101));
+        uint8x16_t d   = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+        uint16x8_t lo  = vmlal_u8(half, vget_low_u8(d), vget_low_u8(k));
+        uint16x8_t hi  = vmlal_u8(half, vget_high_u8(d), vget_high_u8(k));
+        uint8x8_t rlo  = vshrn_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8);
+        uint8x8_t rhi  = vshrn_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8);
+        d = vaddq_u8(vcombine_u8(rlo, rhi), vreinterpretq_u8_u32(s32));
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(d));
+    }
+    composite_scalar(dst + i, src + i, len - i);
+}
+
+inline uint16x8_t mul255_neon(uint16x8_t a, uint16x8_t b)
+{
+    uint16x8_t t = vmlaq_u16(vdupq_n_u16(128), a, b);
+    return vshrq_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+template<int MODE>
+inline uint16x8_t blend_mode_neon(uint16x8_t s, uint16x8_t d, uint16x8_t sa, uint16x8_t da)
+{
+    const uint16x8_t v255 = vdupq_n_u16(255);
+    switch (MODE) {
+    case VG_BLEND_ADD:
+        return vaddq_u16(s, d);
+    case VG_BLEND_MULTIPLY:
+        return vaddq_u16(vaddq_u16(mul255_neon(s, d), mul255_neon(s, vsubq_u16(v255, da))), mul255_neon(d, vsubq_u16(v255, sa)));
+    case VG_BLEND_SCREEN:
+        return vsubq_u16(vaddq_u16(s, d), mul255_neon(s, d));
+    case VG_BLEND_MIN:
+        return vsubq_u16(vaddq_u16(s, d), vmaxq_u16(mul255_neon(s, da), mul255_neon(d, sa)));
+    case VG_BLEND_MAX:
+        return vsubq_u16(vaddq_u16(s, d), vminq_u16(mul255_neon(s, da), mul255_neon(d, sa)));
+    default:
+        return vaddq_u16(s, mul255_neon(d, vsubq_u16(v255, sa)));
+    }
+}
+
+// alpha 乘以 0x01010101 复制到 4 个字节，再展开成 16 位
+template<int MODE>
+inline void composite_mode_neon(vgPixel* dst, const vgPixel* src, int len)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32x4_t s32 = vld1q_u32(src + i);
+        uint32x4_t d32 = vld1q_u32(dst + i);
+        uint8x16_t s   = vreinterpretq_u8_u32(s32);
+        uint8x16_t d   = vreinterpretq_u8_u32(d32);
+        uint8x16_t sa  = vreinterpretq_u8_u32(vmulq_n_u32(vshrq_n_u32(s32, 24), 0x01010101));
+        uint8x16_t da  = vreinterpretq_u8_u32(vmulq_n_u32(vshrq_n_u32(d32, 24), 0x01010101));
+        uint16x8_t lo  = blend_mode_neon<MODE>(vmovl_u8(vget_low_u8(s)), vmovl_u8(vget_low_u8(d)), vmovl_u8(vget_low_u8(sa)), vmovl_u8(vget_low_u8(da)));
+        uint16x8_t hi  = blend_mode_neon<MODE>(vmovl_u8(vget_high_u8(s)), vmovl_u8(vget_high_u8(d)), vmovl_u8(vget_high_u8(sa)), vmovl_u8(vget_high_u8(da)));
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi))));
+    }
+    composite_mode_scalar<MODE>(dst + i, src + i, len - i);
+}
+
+inline void modulate_neon(vgPixel* dst, const vgPixel* src, int len, vgPixel color)
+{
+    const uint16x8_t m = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(color)));
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint8x16_t s  = vreinterpretq_u8_u32(vld1q_u32(src + i));
+        uint16x8_t lo = mul255_neon(vmovl_u8(vget_low_u8(s)), m);
+        uint16x8_t hi = mul255_neon(vmovl_u8(vget_high_u8(s)), m);
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi))));
+    }
+    modulate_scalar(dst + i, src + i, len - i, color);
+}
+
+// 缩放：4 个通道的和转换成 4 个像素，结果和 resample_pack 相同
+inline uint8x16_t resample_pack_neon(int32x4_t a, int32x4_t b, int32x4_t c, int32x4_t d)
+{
+    const int32x4_t round = vdupq_n_s32(RESAMPLE_ROUND);
+    a = vshrq_n_s32(vaddq_s32(a, round), RESAMPLE_BITS);
+    b = vshrq_n_s32(vaddq_s32(b, round), RESAMPLE_BITS);
+    c = vshrq_n_s32(vaddq_s32(c, round), RESAMPLE_BITS);
+    d = vshrq_n_s32(vaddq_s32(d, round), RESAMPLE_BITS);
+    uint8x16_t p = vcombine_u8(
+        vqmovun_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b))),
+        vqmovun_s16(vcombine_s16(vqmovn_s32(c), vqmovn_s32(d)))
+    );
+
+    uint32x4_t alpha = vandq_u32(vreinterpretq_u32_u8(p), vdupq_n_u32(0xFF000000));
+    alpha = vorrq_u32(alpha, vshrq_n_u32(alpha, 8));
+    alpha = vorrq_u32(alpha, vshrq_n_u32(alpha, 16));
+    return vminq_u8(p, vreinterpretq_u8_u32(alpha));
+}
+
+inline void resample_h_neon(vgPixel* dst, const vgPixel* src, int len, const int32_t* first, const int16_t* weights, int taps)
+{
+    for (int i = 0; i < len; ++i, weights += taps) {
+        const vgPixel* s = src + first[i];
+        int32x4_t acc = vdupq_n_s32(0);
+        for (int j = 0; j < taps; ++j) {
+            uint16x8_t p = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(s[j])));
+            acc = vmlal_n_s16(acc, vreinterpret_s16_u16(vget_low_u16(p)), weights[j]);
+        }
+        dst[i] = vgetq_lane_u32(vreinterpretq_u32_u8(resample_pack_neon(acc, acc, acc, acc)), 0);
+    }
+}
+
+inline void resample_v_neon(vgPixel* dst, const vgPixel* const* rows, const int16_t* weights, int taps, int len)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        int32x4_t acc0 = vdupq_n_s32(0);
+        int32x4_t acc1 = acc0;
+        int32x4_t acc2 = acc0;
+        int32x4_t acc3 = acc0;
+        for (int j = 0; j < taps; ++j) {
+            uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(rows[j] + i));
+            int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(s)));
+            int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(s)));
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(lo), weights[j]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(lo), weights[j]);
+            acc2 = vmlal_n_s16(acc2, vget_low_s16(hi), weights[j]);
+            acc3 = vmlal_n_s16(acc3, vget_high_s16(hi), weights[j]);
+        }
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(resample_pack_neon(acc0, acc1, acc2, acc3)));
+    }
+    resample_v_span(dst, rows, weights, taps, i, len);
+}
+
+// 渐变：NEON 的 max/min 遇到 NaN 返回 NaN，用比较和选择代替
+inline float32x4_t floor_ramp_neon(float32x4_t t)
+{
+    float32x4_t f = vcvtq_f32_s32(vcvtq_s32_f32(t));
+    uint32x4_t one = vreinterpretq_u32_f32(vdupq_n_f32(1.0f));
+    return vsubq_f32(f, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(f, t), one)));
+}
+
+inline void gradient_neon(vgPixel* dst, const float* t, int len, const vgPixel* ramp, int spread)
+{
+    const float32x4_t limit = vdupq_n_f32(float(RAMP_LIMIT));
+    const float32x4_t lower = vdupq_n_f32(-float(RAMP_LIMIT));
+    const float32x4_t zero  = vdupq_n_f32(0.0f);
+    const float32x4_t one   = vdupq_n_f32(1.0f);
+    const float32x4_t two   = vdupq_n_f32(2.0f);
+    const float32x4_t last  = vdupq_n_f32(float(RAMP_SIZE - 1));
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        float32x4_t v = vld1q_f32(t + i);
+        v = vbslq_f32(vcgtq_f32(v, lower), v, lower);
+        v = vbslq_f32(vcltq_f32(v, limit), v, limit);
+        if (spread == VG_SPREAD_REPEAT) {
+            v = vsubq_f32(v, floor_ramp_neon(v));
+        }
+        else if (spread == VG_SPREAD_REFLECT) {
+            float32x4_t w = vsubq_f32(v, vmulq_n_f32(floor_ramp_neon(vmulq_n_f32(v, 0.5f)), 2.0f));
+            v = vbslq_f32(vcgtq_f32(w, one), vsubq_f32(two, w), w);
+        }
+        v = vbslq_f32(vcgtq_f32(v, zero), v, zero);
+        v = vmulq_n_f32(v, float(RAMP_SIZE));
+        v = vbslq_f32(vcltq_f32(v, last), v, last);
+
+        int32_t index[4];
+        vst1q_s32(index, vcvtq_s32_f32(v));
+        dst[i]     = ramp[index[0]];
+        dst[i + 1] = ramp[index[1]];
+        dst[i + 2] = ramp[index[2]];
+        dst[i + 3] = ramp[index[3]];
+    }
+    gradient_scalar(dst + i, t + i, len - i, ramp, spread);
+}
+
+inline uint32_t hash_neon(const vgPixel* src, int len, uint32_t seed)
+{
+    uint32_t acc[HASH_LANES];
+    hash_init(acc, seed);
+    if (len < HASH_LANES) {
+        return hash_finish(acc, src, len, len);
+    }
+
+    const uint32_t p1 = hash_prime(0);
+    const uint32_t p2 = hash_prime(1);
+    uint32x4_t a0 = vld1q_u32(acc);
+    uint32x4_t a1 = vld1q_u32(acc + 4);
+    int i = 0;
+    for (; i + HASH_LANES <= len; i += HASH_LANES) {
+        a0 = vaddq_u32(a0, vmulq_n_u32(vld1q_u32(src + i), p2));
+        a1 = vaddq_u32(a1, vmulq_n_u32(vld1q_u32(src + i + 4), p2));
+        a0 = vmulq_n_u32(vorrq_u32(vshlq_n_u32(a0, 13), vshrq_n_u32(a0, 19)), p1);
+        a1 = vmulq_n_u32(vorrq_u32(vshlq_n_u32(a1, 13), vshrq_n_u32(a1, 19)), p1);
+    }
+    vst1q_u32(acc, a0);
+    vst1q_u32(acc + 4, a1);
+    return hash_finish(acc, src + i, len - i, len);
+}
+
+#else
+
+inline int cpu_features()
+{
+    return 0;
+}
+
+#endif
+
+/* 返回指定指令集的内核
+ * features 为 0 返回标量版本，可以用来做性能对比
+ */
+inline pixel_kernels select_kernels(int features)
+{
+    pixel_kernels k;
+    k.fill       = fill_scalar;
+    k.blend      = blend_scalar;
+    k.accumulate = accumulate_scalar;
+    k.composite  = composite_scalar;
+    k.hash       = hash_scalar;
+    k.gradient   = gradient_scalar;
+    k.modulate   = modulate_scalar;
+    k.resample_h = resample_h_scalar;
+    k.resample_v = resample_v_scalar;
+
+    k.modes[VG_BLEND_ADD]      = composite_mode_scalar<VG_BLEND_ADD>;
+    k.modes[VG_BLEND_MULTIPLY] = composite_mode_scalar<VG_BLEND_MULTIPLY>;
+    k.modes[VG_BLEND_SCREEN]   = composite_mode_scalar<VG_BLEND_SCREEN>;
+    k.modes[VG_BLEND_MIN]      = composite_mode_scalar<VG_BLEND_MIN>;
+    k.modes[VG_BLEND_MAX]      = composite_mode_scalar<VG_BLEND_MAX>;
+
+    #if defined(MINIVG_SIMD_X86)
+    if (features & CPU_AVX2) {
+        k.fill       = fill_avx2;
+        k.blend      = blend_avx2;
+        k.accumulate = accumulate_sse2;
+        k.composite  = composite_avx2;
+        k.hash       = hash_avx2;
+        k.gradient   = gradient_avx2;
+        k.modulate   = modulate_avx2;
+        k.resample_h = resample_h_avx2;
+        k.resample_v = resample_v_avx2;
+
+        k.modes[VG_BLEND_ADD]      = composite_mode_avx2<VG_BLEND_ADD>;
+        k.modes[VG_BLEND_MULTIPLY] = composite_mode_avx2<VG_BLEND_MULTIPLY>;
+        k.modes[VG_BLEND_SCREEN]   = composite_mode_avx2<VG_BLEND_SCREEN>;
+        k.modes[VG_BLEND_MIN]      = composite_mode_avx2<VG_BLEND_MIN>;
+        k.modes[VG_BLEND_MAX]      = composite_mode_avx2<VG_BLEND_MAX>;
+    }
+    else if (features & CPU_SSE2) {
+        k.fill       = fill_sse2;
+        k.blend      = blend_sse2;
+        k.accumulate = accumulate_sse2;
+        k.composite  = composite_sse2;
+        k.hash       = hash_sse2;
+        k.gradient   = gradient_sse2;
+        k.modulate   = modulate_sse2;
+        k.resample_h = resample_h_sse2;
+        k.resample_v = resample_v_sse2;
+
+        k.modes[VG_BLEND_ADD]      = composite_mode_sse2<VG_BLEND_ADD>;
+        k.modes[VG_BLEND_MULTIPLY] = composite_mode_sse2<VG_BLEND_MULTIPLY>;
+        k.modes[VG_BLEND_SCREEN]   = composite_mode_sse2<VG_BLEND_SCREEN>;
+        k.modes[VG_BLEND_MIN]      = composite_mode_sse2<VG_BLEND_MIN>;
+        k.modes[VG_BLEND_MAX]      = composite_mode_sse2<VG_BLEND_MAX>;
+    }
+    #elif defined(MINIVG_SIMD_NEON)
+    if (features & CPU_NEON) {
+        k.fill       = fill_neon;
+        k.blend      = blend_neon;
+        k.accumulate = accumulate_neon;
+        k.composite  = composite_neon;
+        k.hash       = hash_neon;
+        k.gradient   = gradient_neon;
+        k.modulate   = modulate_neon;
+        k.resample_h = resample_h_neon;
+        k.resample_v = resample_v_neon;
+
+        k.modes[VG_BLEND_ADD]      = composite_mode_neon<VG_BLEND_ADD>;
+        k.modes[VG_BLEND_MULTIPLY] = composite_mode_neon<VG_BLEND_MULTIPLY>;
+        k.modes[VG_BLEND_SCREEN]   = composite_mode_neon<VG_BLEND_SCREEN>;
+        k.modes[VG_BLEND_MIN]      = composite_mode_neon<VG_BLEND_MIN>;
+        k.modes[VG_BLEND_MAX]      = composite_mode_neon<VG_BLEND_MAX>;
+    }
+    #else
+    (void) features;
+    #endif
+
+    k.modes[VG_BLEND_NORMAL] = k.composite;
+    k.modes[VG_BLEND_COPY]   = composite_copy;
+    return k;
+}
+
+// 当前 CPU 使用的内核，第一次调用的时候检测
+inline const pixel_kernels& kernels()
+{
+    static const pixel_kernels k = select_kernels(cpu_features());
+    return k;
+}
+
+// 使用混合模式把一段纯色混合到像素上（全覆盖）
+inline void blend_color(vgPixel* dst, int len, vgPixel color, int mode)
+{
+    const pixel_kernels& k = kernels();
+    if (mode == VG_BLEND_NORMAL) {
+        k.blend(dst, len, color);
+        return;
+    }
+    if (mode == VG_BLEND_COPY) {
+        k.fill(dst, len, color);
+        return;
+    }
+
+    // 其他模式使用 composite 内核，源是重复的纯色
+    enum { CHUNK = 64 };
+    vgPixel buf[CHUNK];
+    std::fill(buf, buf + std::min(len, int(CHUNK)), color);
+    for (int i = 0; i < len; i += CHUNK) {
+        k.modes[mode](dst + i, buf, std::min(len - i, int(CHUNK)));
+    }
+}
+
+// 使用固定覆盖率混合一段纯色
+inline void blend_solid_hline(vgPixel* dst, int len, vgPixel color, uint32_t cover, int mode)
+{
+    if (mode == VG_BLEND_COPY && cover != 255) {
+        for (int i = 0; i < len; ++i) {
+            dst[i] = blend_pixel(dst[i], color, cover, mode);
+        }
+        return;
+    }
+    blend_color(dst, len, cover == 255 ? color : scale_pixel(color, cover), mode);
+}
+
+// 使用覆盖率数组混合一段纯色
+inline void blend_solid_span(vgPixel* dst, int len, vgPixel color, const uint8_t* covers, int mode)
+{
+    for (int i = 0; i < len; ++i) {
+        if (covers[i]) {
+            dst[i] = blend_pixel(dst[i], color, covers[i], mode);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// 扫描线光栅化
+//---------------------------------------------------------------------------
+
+/* 扫描线单元格
+ * 坐标使用 24.8 定点数，一个像素分成 256 个子像素。
+ * cover 是边穿过这个像素时的有向高度，area 是 cover * (fx1 + fx2)。
+ * 一行里面从左到右累加 cover，就得到了每个像素的面积覆盖率。
+ */
+struct cell
+{
+    int x, y;
+    int cover;
+    int area;
+};
+
+inline bool cell_less(const cell& a, const cell& b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+/* 抗锯齿扫描线光栅化器
+ * 像素 (x, y) 覆盖的范围是 [x, x + 1) x [y, y + 1)。
+ * 单元格只在剪裁矩形内部生成，剪裁区左边的部分合并到 clip.x1 - 1 列，
+ * 所以同一个像素的覆盖率和剪裁矩形无关。
+ *
+ * 单元格有两种存储方式：
+ *   稀疏    单元格保存到数组，输出的时候排序，适合顶点少的图形
+ *   累加    调用 accumulate() 之后，单元格直接累加到像素大小的缓冲区，
+ *           每一行求前缀和得到覆盖率，复杂度 O(边 + 像素)，适合顶点很多的图形
+ * 两种方式的计算结果完全相同。
+ */
+class rasterizer
+{
+public:
+    enum
+    {
+        SHIFT = 8,
+        SCALE = 1 << SHIFT,
+        MASK  = SCALE - 1,
+        LIMIT = 1 << 22 // 坐标范围限制，防止定点数溢出
+    };
+
+private:
+    std::vector<cell> m_cells;
+    std::vector<int32_t> m_acc;     // 累加缓冲区
+    std::vector<uint8_t> m_covers;
+    cell m_cur;
+    irect m_clip;
+    int m_accStride;        // 累加缓冲区行宽，0 表示使用稀疏单元格
+    int m_startX, m_startY; // 子路径起点
+    int m_x, m_y;           // 当前点
+
+public:
+    rasterizer() :
+        m_accStride(), m_startX(), m_startY(), m_x(), m_y()
+    {
+        this->reset_cell();
+    }
+
+    // 重置光栅化器，设置剪裁矩形
+    void reset(const irect& clip)
+    {
+        m_cells.clear();
+        m_clip = clip;
+        m_accStride = 0;
+        m_startX = m_startY = m_x = m_y = 0;
+        this->reset_cell();
+    }
+
+    /* 使用累加缓冲区，需要在添加图形之前调用
+     * bounds           图形的包围盒，剪裁范围缩小到包围盒内部
+     */
+    void accumulate(const irect& bounds)
+    {
+        m_clip = m_clip.intersect(bounds);
+        if (m_clip.empty()) {
+            m_clip = irect();
+            return;
+        }
+
+        // 左边多一列保存剪裁区左边的 cover，右边多一列接收最后一个像素的 area
+        m_accStride = m_clip.width() + 2;
+        m_acc.assign(size_t(m_accStride) * m_clip.height(), 0);
+    }
+
+    const irect& clip() const
+    {
+        return m_clip;
+    }
+
+    // 开始一个新的子路径，之前的子路径自动闭合
+    void move_to(float x, float y)
+    {
+        this->close();
+        m_startX = m_x = upscale(x);
+        m_startY = m_y = upscale(y);
+    }
+
+    void line_to(float x, float y)
+    {
+        int nx = upscale(x);
+        int ny = upscale(y);
+        this->line(m_x, m_y, nx, ny);
+        m_x = nx;
+        m_y = ny;
+    }
+
+    // 闭合当前子路径
+    void close()
+    {
+        if (m_x != m_startX || m_y != m_startY) {
+            this->line(m_x, m_y, m_startX, m_startY);
+            m_x = m_startX;
+            m_y = m_startY;
+        }
+    }
+
+    // 添加多边形
+    void add_polygon(const vec2f* points, size_t size)
+    {
+        if (size < 3) {
+            return;
+        }
+        this->move_to(points[0].x, points[0].y);
+        for (size_t i = 1; i < size; ++i) {
+            this->line_to(points[i].x, points[i].y);
+        }
+        this->close();
+    }
+
+    /* 输出扫描线
+     * painter          需要实现：
+     *                      blend_hline(x, y, len, cover)   固定覆盖率
+     *                      blend_span(x, y, len, covers)   覆盖率数组
+     * rule             填充规则 VG_NONZERO, VG_EVENODD
+     * antialias        是否抗锯齿
+     */
+    template<typename P>
+    void render(P& painter, int rule, bool antialias)
+    {
+        this->close();
+        if (m_accStride) {
+            this->render_accumulated(painter, rule, antialias);
+            return;
+        }
+
+        this->flush_cell();
+        if (m_cells.empty()) {
+            return;
+        }
+
+        std::sort(m_cells.begin(), m_cells.end(), cell_less);
+        m_covers.resize(m_clip.width() + 1);
+
+        const cell* p   = &m_cells[0];
+        const cell* end = p + m_cells.size();
+
+        while (p != end) {
+            const int y = p->y;
+            int cover   = 0;
+            int spanX   = 0;
+            int spanLen = 0;
+
+            while (p != end && p->y == y) {
+                const int x = p->x;
+                int area    = 0;
+                for (; p != end && p->y == y && p->x == x; ++p) {
+                    cover += p->cover;
+                    area += p->area;
+                }
+
+                // 单元格所在的像素
+                if (x >= m_clip.x1) {
+                    uint8_t alpha = calc_alpha((cover * (SCALE * 2)) - area, rule, antialias);
+                    if (alpha) {
+                        if (spanLen && spanX + spanLen != x) {
+                            painter.blend_span(spanX, y, spanLen, &m_covers[0]);
+                            spanLen = 0;
+                        }
+                        if (!spanLen) {
+                            spanX = x;
+                        }
+                        m_covers[spanLen++] = alpha;
+                    }
+                }
+
+                // 到下一个单元格之间的像素覆盖率相同
+                int x1 = std::max(x + 1, m_clip.x1);
+                int x2 = (p != end && p->y == y) ? p->x : m_clip.x2;
+                if (cover && x2 > x1) {
+                    uint8_t alpha = calc_alpha(cover * (SCALE * 2), rule, antialias);
+                    if (alpha) {
+                        if (spanLen) {
+                            painter.blend_span(spanX, y, spanLen, &m_covers[0]);
+                            spanLen = 0;
+                        }
+                        painter.blend_hline(x1, y, x2 - x1, alpha);
+                    }
+                }
+            }
+
+            if (spanLen) {
+                painter.blend_span(spanX, y, spanLen, &m_covers[0]);
+            }
+        }
+    }
+
+    // 坐标转换成 24.8 定点数
+    static int upscale(float v)
+    {
+        using namespace std;
+
+        if (!(v > -LIMIT)) {
+            return -LIMIT * SCALE; // NaN 也在这里处理
+        }
+        if (v > LIMIT) {
+            return LIMIT * SCALE;
+        }
+        return static_cast<int>(floor(v * SCALE + 0.5f));
+    }
+
+private:
+    template<typename P>
+    void render_accumulated(P& painter, int rule, bool antialias)
+    {
+        const pixel_kernels& k = kernels();
+        m_covers.resize(m_accStride);
+
+        for (int y = m_clip.y1; y < m_clip.y2; ++y) {
+            const int32_t* acc = &m_acc[size_t(y - m_clip.y1) * m_accStride];
+            k.accumulate(acc, &m_covers[0], m_accStride - 1, rule, antialias);
+
+            // 第一列是剪裁区左边，不输出
+            this->emit_covers(painter, m_clip.x1, y, &m_covers[1], m_clip.width());
+        }
+    }
+
+    // 输出一行覆盖率，跳过空白，较长的相同覆盖率使用 blend_hline
+    template<typename P>
+    static void emit_covers(P& painter, int x, int y, const uint8_t* covers, int len)
+    {
+        int i = 0;
+        while (i < len) {
+            if (!covers[i]) {
+                ++i;
+                continue;
+            }
+
+            int start = i;
+            while (i < len && covers[i]) {
+                int j = i + 1;
+                while (j < len && covers[j] == covers[i]) {
+                    ++j;
+                }
+                if (j - i >= 16) {
+                    if (i > start) {
+                        painter.blend_span(x + start, y, i - start, covers + start);
+                    }
+                    painter.blend_hline(x + i, y, j - i, covers[i]);
+                    start = j;
+                }
+                i = j;
+            }
+
+            if (i > start) {
+                painter.blend_span(x + start, y, i - start, covers + start);
+            }
+        }
+    }
+
+    void reset_cell()
+    {
+        m_cur.x     = INT_MAX;
+        m_cur.y     = INT_MAX;
+        m_cur.cover = 0;
+        m_cur.area  = 0;
+    }
+
+    void flush_cell()
+    {
+        if (m_cur.cover | m_cur.area) {
+            m_cells.push_back(m_cur);
+        }
+        this->reset_cell();
+    }
+
+    void add_cell(int x, int y, int cover, int area)
+    {
+        if (x >= m_clip.x2) {
+            return;
+        }
+        if (x < m_clip.x1) {
+            x = m_clip.x1 - 1;
+        }
+
+        // 像素值是左边所有 cover 之和减去自己的 area，写成两个差分
+        if (m_accStride) {
+            int32_t* acc = &m_acc[size_t(y - m_clip.y1) * m_accStride + (x - m_clip.x1 + 1)];
+            acc[0] += (cover * (SCALE * 2)) - area;
+            acc[1] += area;
+            return;
+        }
+
+        if (x != m_cur.x || y != m_cur.y) {
+            this->flush_cell();
+            m_cur.x = x;
+            m_cur.y = y;
+        }
+        m_cur.cover += cover;
+        m_cur.area += area;
+    }
+
+    // 光栅化一条边
+    void line(int x1, int y1, int x2, int y2)
+    {
+        using namespace std;
+
+        if (y1 == y2) {
+            return;
+        }
+
+        int dir = 1;
+        if (y1 > y2) {
+            swap(x1, x2);
+            swap(y1, y2);
+            dir = -1;
+        }
+
+        int ey1 = max(y1 >> SHIFT, m_clip.y1);
+        int ey2 = min((y2 - 1) >> SHIFT, m_clip.y2 - 1);
+
+        // 整条边在剪裁区右边
+        if ((min(x1, x2) >> SHIFT) >= m_clip.x2) {
+            return;
+        }
+
+        // 整条边在剪裁区左边，每一行只需要记录 cover（分块渲染的时候很常见）
+        if ((max(x1, x2) >> SHIFT) < m_clip.x1) {
+            for (int ey = ey1; ey <= ey2; ++ey) {
+                int top    = max(y1, ey * SCALE);
+                int bottom = min(y2, (ey + 1) * SCALE);
+                this->add_cell(m_clip.x1 - 1, ey, dir * (bottom - top), 0);
+            }
+            return;
+        }
+
+        const int64_t dx = int64_t(x2) - x1;
+        const int64_t dy = int64_t(y2) - y1;
+
+        // 每一行的端点都从原始端点计算，保证和剪裁范围无关
+        for (int ey = ey1; ey <= ey2; ++ey) {
+            int top    = max(y1, ey * SCALE);
+            int bottom = min(y2, (ey + 1) * SCALE);
+            int xa     = x1 + static_cast<int>(dx * (top - y1) / dy);
+            int xb     = x1 + static_cast<int>(dx * (bottom - y1) / dy);
+            this->hline(ey, xa, top - (ey * SCALE), xb, bottom - (ey * SCALE), dir);
+        }
+    }
+
+    // 光栅化一行内的线段，fy1 < fy2
+    void hline(int ey, int x1, int fy1, int x2, int fy2, int dir)
+    {
+        const int ex1 = x1 >> SHIFT;
+        const int ex2 = x2 >> SHIFT;
+
+        if (fy1 == fy2) {
+            return;
+        }
+
+        // 整段在剪裁区左边，只需要记录 cover
+        if (ex1 < m_clip.x1 && ex2 < m_clip.x1) {
+            this->add_cell(m_clip.x1 - 1, ey, dir * (fy2 - fy1), 0);
+            return;
+        }
+
+        // 整段在剪裁区右边
+        if (ex1 >= m_clip.x2 && ex2 >= m_clip.x2) {
+            return;
+        }
+
+        // 在同一个像素里面
+        if (ex1 == ex2) {
+            int d = dir * (fy2 - fy1);
+            this->add_cell(ex1, ey, d, d * ((x1 & MASK) + (x2 & MASK)));
+            return;
+        }
+
+        const int64_t dx = int64_t(x2) - x1;
+        const int64_t dy = fy2 - fy1;
+
+        int ex = ex1;
+        int x  = x1;
+        int y  = fy1;
+        int d;
+
+        if (dx > 0) {
+            // 跳过剪裁区左边的像素
+            if (ex < m_clip.x1 - 1) {
+                int bx = m_clip.x1 * SCALE;
+                int by = fy1 + static_cast<int>((bx - x1) * dy / dx);
+                this->add_cell(m_clip.x1 - 1, ey, dir * (by - y), 0);
+                ex = m_clip.x1;
+                x  = bx;
+                y  = by;
+            }
+
+            for (; ex < ex2; ++ex) {
+                if (ex >= m_clip.x2) {
+                    return;
+                }
+                int bx = (ex + 1) * SCALE;
+                int by = fy1 + static_cast<int>((bx - x1) * dy / dx);
+                d      = dir * (by - y);
+                this->add_cell(ex, ey, d, d * ((x - (ex * SCALE)) + SCALE));
+                x = bx;
+                y = by;
+            }
+        }
+        else {
+            // 跳过剪裁区右边的像素
+            if (ex >= m_clip.x2) {
+                int bx = m_clip.x2 * SCALE;
+                y      = fy1 + static_cast<int>((bx - x1) * dy / dx);
+                ex     = m_clip.x2 - 1;
+                x      = bx;
+            }
+
+            for (; ex > ex2; --ex) {
+                if (ex < m_clip.x1) {
+                    this->add_cell(m_clip.x1 - 1, ey, dir * (fy2 - y), 0);
+                    return;
+                }
+                int bx = ex * SCALE;
+                int by = fy1 + static_cast<int>((bx - x1) * dy / dx);
+                d      = dir * (by - y);
+                this->add_cell(ex, ey, d, d * (x - bx));
+                x = bx;
+                y = by;
+            }
+        }
+
+        d = dir * (fy2 - y);
+        this->add_cell(ex2, ey, d, d * ((x - (ex2 * SCALE)) + (x2 & MASK)));
+    }
+};
+
+//---------------------------------------------------------------------------
+// 扫描线输出
+//---------------------------------------------------------------------------
+
+// 纯色填充
+struct solid_painter
+{
+    const vgSurface* target;
+    vgPixel color;
+    int mode;
+
+    solid_painter(const vgSurface* target, vgPixel color, int mode = VG_BLEND_NORMAL) :
+        target(target), color(color), mode(mode) { }
+
+    void blend_hline(int x, int y, int len, uint8_t cover)
+    {
+        blend_solid_hline(target->row(y) + x, len, color, cover, mode);
+    }
+
+    void blend_span(int x, int y, int len, const uint8_t* covers)
+    {
+        blend_solid_span(target->row(y) + x, len, color, covers, mode);
+    }
+};
+
+// 图片填充，使用逆矩阵把目标像素中心映射到图片坐标
+struct image_painter
+{
+    const vgSurface* target;
+    const vgSurface* image;
+    irect source;     // 图片采样范围
+    vgMatrix inverse; // 目标坐标到图片坐标的矩阵
+    bool bilinear;    // 双线性插值
+    int mode;         // 混合模式
+    const vgSurface* next; // 三线性插值的下一级 mipmap，坐标是这一级的一半
+    irect nextSource;      // 下一级的采样范围
+    uint32_t mix;          // 下一级的权重 0 ~ 256，为 0 的时候不插值
+
+    image_painter(const vgSurface* target, const vgSurface* image, const irect& source, const vgMatrix& inverse, bool bilinear,
+        int mode = VG_BLEND_NORMAL, const vgSurface* next = NULL, const irect& nextSource = irect(), uint32_t mix = 0) :
+        target(target), image(image), source(source), inverse(inverse), bilinear(bilinear), mode(mode),
+        next(next), nextSource(nextSource), mix(next ? mix : 0) { }
+
+    // 每个像素的采样坐标单独计算，不累加误差，保证和扫描线的起点无关
+    void blend_hline(int x, int y, int len, uint8_t cover)
+    {
+        vgPixel* dst = target->row(y) + x;
+        float u0     = inverse.c * (y + 0.5f) + inverse.tx;
+        float v0     = inverse.d * (y + 0.5f) + inverse.ty;
+        for (int i = 0; i < len; ++i) {
+            float fx  = float(x + i) + 0.5f;
+            dst[i]    = blend_pixel(dst[i], this->sample(inverse.a * fx + u0, inverse.b * fx + v0), cover, mode);
+        }
+    }
+
+    void blend_span(int x, int y, int len, const uint8_t* covers)
+    {
+        vgPixel* dst = target->row(y) + x;
+        float u0     = inverse.c * (y + 0.5f) + inverse.tx;
+        float v0     = inverse.d * (y + 0.5f) + inverse.ty;
+        for (int i = 0; i < len; ++i) {
+            if (covers[i]) {
+                float fx = float(x + i) + 0.5f;
+                dst[i]   = blend_pixel(dst[i], this->sample(inverse.a * fx + u0, inverse.b * fx + v0), covers[i], mode);
+            }
+        }
+    }
+
+    vgPixel sample(float u, float v) const
+    {
+        vgPixel c = this->sample(*image, source, u, v);
+        if (mix) {
+            c = lerp(c, this->sample(*next, nextSource, u * 0.5f, v * 0.5f), mix);
+        }
+        return c;
+    }
+
+    vgPixel sample(const vgSurface& image, const irect& source, float u, float v) const
+    {
+        using namespace std;
+
+        if (!bilinear) {
+            int x = clamp(static_cast<int>(floor(u)), source.x1, source.x2);
+            int y = clamp(static_cast<int>(floor(v)), source.y1, source.y2);
+            return image.row(y)[x];
+        }
+
+        // 双线性插值，权重 0 ~ 256
+        u -= 0.5f;
+        v -= 0.5f;
+        float fu = floor(u);
+        float fv = floor(v);
+        int x1   = static_cast<int>(fu);
+        int y1   = static_cast<int>(fv);
+        int wx   = static_cast<int>((u - fu) * 256.0f);
+        int wy   = static_cast<int>((v - fv) * 256.0f);
+        int x2   = clamp(x1 + 1, source.x1, source.x2);
+        int y2   = clamp(y1 + 1, source.y1, source.y2);
+        x1       = clamp(x1, source.x1, source.x2);
+        y1       = clamp(y1, source.y1, source.y2);
+
+        const vgPixel* r1 = image.row(y1);
+        const vgPixel* r2 = image.row(y2);
+        return lerp(lerp(r1[x1], r1[x2], wx), lerp(r2[x1], r2[x2], wx), wy);
+    }
+
+    // 限制在 [x1, x2) 范围内
+    static int clamp(int x, int x1, int x2)
+    {
+        return x < x1 ? x1 : (x >= x2 ? x2 - 1 : x);
+    }
+
+    // 像素线性插值，w 范围 0 ~ 256
+    static vgPixel lerp(vgPixel a, vgPixel b, uint32_t w)
+    {
+        uint32_t rb = ((a & 0x00FF00FF) * (256 - w) + (b & 0x00FF00FF) * w) >> 8;
+        uint32_t ag = ((a >> 8) & 0x00FF00FF) * (256 - w) + ((b >> 8) & 0x00FF00FF) * w;
+        return (rb & 0x00FF00FF) | (ag & 0xFF00FF00);
+    }
+};
+
+/* 角度 atan2(y, x) / 2pi，范围 [0, 1)
+ * 多项式近似，误差小于 1e-6 圈，比颜色表的间隔小得多。
+ */
+inline float turn_angle(float y, float x)
+{
+    using namespace std;
+
+    const float ax = fabs(x);
+    const float ay = fabs(y);
+    const float hi = max(ax, ay);
+    if (!(hi > 0.0f)) {
+        return 0.0f;
+    }
+    const float z  = min(ax, ay) / hi;
+    const float z2 = z * z;
+    float t = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f + z2 * (0.05265332f + z2 * -0.01172120f)))));
+    t *= float(0.5 / M_PI);
+    if (ay > ax) {
+        t = 0.25f - t;
+    }
+    if (x < 0.0f) {
+        t = 0.5f - t;
+    }
+    if (y < 0.0f) {
+        t = 1.0f - t;
+    }
+    return t < 1.0f ? t : 0.0f;
+}
+
+/* 渐变填充，使用逆矩阵把目标像素中心映射到渐变坐标 (u, v)
+ * 线性渐变 t = u，径向渐变 t = |(u, v)|，锥形渐变 t = atan2(v, u) / 2pi。
+ * 每段像素先算出参数，再用 gradient 内核查颜色表。
+ */
+struct gradient_painter
+{
+    enum { CHUNK = 128 };
+
+    const vgSurface* target;
+    const vgPixel* ramp; // 预乘颜色表，RAMP_SIZE 个颜色
+    vgMatrix inverse;    // 目标坐标到渐变坐标的矩阵
+    int type;            // 渐变类型
+    int spread;          // 扩展方式
+    int mode;            // 混合模式
+    float params[CHUNK];
+    vgPixel colors[CHUNK];
+
+    gradient_painter(const vgSurface* target, const vgPixel* ramp, const vgMatrix& inverse, int type, int spread, int mode) :
+        target(target), ramp(ramp), inverse(inverse), type(type), spread(spread), mode(mode) { }
+
+    void blend_hline(int x, int y, int len, uint8_t cover)
+    {
+        const pixel_kernels& k = kernels();
+        vgPixel* dst = target->row(y) + x;
+        for (int i = 0; i < len; i += CHUNK) {
+            const int n = std::min(len - i, int(CHUNK));
+            this->generate(x + i, y, n);
+            if (cover == 255) {
+                k.modes[mode](dst + i, colors, n);
+                continue;
+            }
+            for (int j = 0; j < n; ++j) {
+                dst[i + j] = blend_pixel(dst[i + j], colors[j], cover, mode);
+            }
+        }
+    }
+
+    void blend_span(int x, int y, int len, const uint8_t* covers)
+    {
+        vgPixel* dst = target->row(y) + x;
+        for (int i = 0; i < len; i += CHUNK) {
+            const int n = std::min(len - i, int(CHUNK));
+            this->generate(x + i, y, n);
+            for (int j = 0; j < n; ++j) {
+                if (covers[i + j]) {
+                    dst[i + j] = blend_pixel(dst[i + j], colors[j], covers[i + j], mode);
+                }
+            }
+        }
+    }
+
+    // 计算一段像素的颜色，每个像素的参数单独计算，和扫描线的起点无关
+    void generate(int x, int y, int len)
+    {
+        using namespace std;
+
+        const float u0 = inverse.c * (float(y) + 0.5f) + inverse.tx;
+        const float v0 = inverse.d * (float(y) + 0.5f) + inverse.ty;
+        switch (type) {
+        case VG_GRADIENT_RADIAL:
+            for (int i = 0; i < len; ++i) {
+                float fx = float(x + i) + 0.5f;
+                float u  = inverse.a * fx + u0;
+                float v  = inverse.b * fx + v0;
+                params[i] = sqrt(u * u + v * v);
+            }
+            break;
+        case VG_GRADIENT_CONIC:
+            for (int i = 0; i < len; ++i) {
+                float fx = float(x + i) + 0.5f;
+                params[i] = turn_angle(inverse.b * fx + v0, inverse.a * fx + u0);
+            }
+            break;
+        default:
+            for (int i = 0; i < len; ++i) {
+                params[i] = inverse.a * (float(x + i) + 0.5f) + u0;
+            }
+            break;
+        }
+        kernels().gradient(colors, params, len, ramp, spread);
+    }
+};
+
+// 计算椭圆弧需要的分段数量，误差不超过 tolerance 像素
+inline int arc_segments(float radius, float sweep, float tolerance = 0.125f)
+{
+    using namespace std;
+
+    if (radius <= tolerance) {
+        return 4;
+    }
+    double step = 2.0 * acos(1.0 - tolerance / radius);
+    int n       = static_cast<int>(ceil(fabs(sweep) / step));
+    return max(n, 4);
+}
+
+//---------------------------------------------------------------------------
+// 线程池
+//---------------------------------------------------------------------------
+
+/* 固定数量的工作线程，调用线程也参与工作
+ * 没有 C++11 线程库的时候只使用调用线程
+ */
+class worker_pool
+{
+public:
+    // task 是任务序号，worker 是执行任务的线程序号（调用线程是 0）
+    typedef void (*task_func)(void* param, int task, int worker);
+
+private:
+    task_func m_func;
+    void* m_param;
+    int m_count;
+
+#ifdef MINIVG_THREADS
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    std::atomic<int> m_next;
+    unsigned m_generation;  // 每次 run() 加一，工作线程用它判断新任务
+    int m_running;
+    bool m_quit;
+#endif
+
+public:
+    worker_pool() :
+        m_func(), m_param(), m_count()
+#ifdef MINIVG_THREADS
+        , m_next(0), m_generation(), m_running(), m_quit()
+#endif
+    {
+    }
+
+    // 复制的时候不复制线程，新的对象只使用调用线程
+    worker_pool(const worker_pool&) :
+        m_func(), m_param(), m_count()
+#ifdef MINIVG_THREADS
+        , m_next(0), m_generation(), m_running(), m_quit()
+#endif
+    {
+    }
+
+    ~worker_pool()
+    {
+        this->resize(1);
+    }
+
+    worker_pool& operator=(const worker_pool&)
+    {
+        return *this;
+    }
+
+    // 线程数量（包括调用线程）
+    int size() const
+    {
+        #ifdef MINIVG_THREADS
+        return static_cast<int>(m_threads.size()) + 1;
+        #else
+        return 1;
+        #endif
+    }
+
+    // 设置线程数量
+    void resize(int count)
+    {
+        #ifdef MINIVG_THREADS
+        count = std::max(count, 1);
+        if (count == this->size()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_start.notify_all();
+        for (size_t i = 0; i < m_threads.size(); ++i) {
+            m_threads[i].join();
+        }
+        m_threads.clear();
+
+        m_quit = false;
+        for (int i = 1; i < count; ++i) {
+            m_threads.push_back(std::thread(&worker_pool::worker_main, this, i, m_generation));
+        }
+        #else
+        (void) count;
+        #endif
+    }
+
+    // 执行 count 个任务，全部完成之后返回
+    void run(task_func func, void* param, int count)
+    {
+        #ifdef MINIVG_THREADS
+        if (!m_threads.empty() && count > 1) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_func    = func;
+                m_param   = param;
+                m_count   = count;
+                m_next    = 0;
+                m_running = static_cast<int>(m_threads.size());
+                ++m_generation;
+            }
+            m_start.notify_all();
+
+            this->work(0);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_running) {
+                m_done.wait(lock);
+            }
+            return;
+        }
+        #endif
+
+        for (int i = 0; i < count; ++i) {
+            func(param, i, 0);
+        }
+    }
+
+private:
+#ifdef MINIVG_THREADS
+    void work(int worker)
+    {
+        for (int task = m_next++; task < m_count; task = m_next++) {
+            m_func(m_param, task, worker);
+        }
+    }
+
+    // generation 是创建线程时的任务批次，线程启动之前提交的任务也不会漏掉
+    void worker_main(int worker, unsigned generation)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            while (!m_quit && m_generation == generation) {
+                m_start.wait(lock);
+            }
+            if (m_quit) {
+                return;
+            }
+            generation = m_generation;
+
+            lock.unlock();
+            this->work(worker);
+            lock.lock();
+
+            if (--m_running == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+#endif
+};
+
+//---------------------------------------------------------------------------
+// 图片缩放
+//---------------------------------------------------------------------------
+
+// 滤波器的半径（放大时的源像素数量）
+inline double filter_radius(int filter)
+{
+    switch (filter) {
+    case VG_FILTER_BICUBIC:
+        return 2.0;
+    case VG_FILTER_LANCZOS:
+        return 3.0;
+    default:
+        return 1.0;
+    }
+}
+
+// 滤波器在距离 x 的权重
+inline double filter_weight(int filter, double x)
+{
+    using namespace std;
+
+    x = fabs(x);
+    switch (filter) {
+    case VG_FILTER_BICUBIC:
+        // Catmull-Rom，a = -0.5
+        if (x < 1.0) {
+            return (1.5 * x - 2.5) * x * x + 1.0;
+        }
+        if (x < 2.0) {
+            return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+        }
+        return 0.0;
+    case VG_FILTER_LANCZOS:
+        if (x < 1e-8) {
+            return 1.0;
+        }
+        if (x < 3.0) {
+            double a = M_PI * x;
+            return 3.0 * sin(a) * sin(a / 3.0) / (a * a);
+        }
+        return 0.0;
+    default:
+        return x < 1.0 ? 1.0 - x : 0.0;
+    }
+}
+
+/* 一个方向的缩放权重表
+ * 目标像素 i 的中心对应的源坐标是 offset + i * scale，源像素 k 的中心是 k + 0.5。
+ * 缩小的时候滤波器按 scale 放大，每个目标像素覆盖对应的全部源像素。
+ * 采样范围限制在 [lo, hi)，超出范围的权重加到边缘的像素上。
+ */
+struct resample_table
+{
+    int taps;                     // 每个目标像素使用的源像素数量
+    std::vector<int32_t> first;   // 每个目标像素的第一个源像素
+    std::vector<int16_t> weights; // 每个目标像素 taps 个权重，和是 1 << RESAMPLE_BITS
+
+    resample_table() : taps(), first(), weights() { }
+
+    void build(int filter, double offset, double scale, int count, int lo, int hi)
+    {
+        using namespace std;
+
+        const bool nearest   = filter == VG_FILTER_NEAREST;
+        const double fs      = max(scale, 1.0);
+        const double support = nearest ? 0.0 : filter_radius(filter) * fs;
+        const int n          = nearest ? 1 : int(ceil(support)) * 2 + 1;
+
+        taps = min(n, hi - lo);
+        first.resize(count);
+        weights.assign(size_t(count) * taps, 0);
+
+        std::vector<double> w(taps);
+        for (int i = 0; i < count; ++i) {
+            const double c = offset + i * scale;
+            int16_t* dst   = &weights[size_t(i) * taps];
+            if (nearest) {
+                first[i] = min(max(int(floor(c)), lo), hi - 1);
+                dst[0]   = 1 << RESAMPLE_BITS;
+                continue;
+            }
+
+            const int left  = int(floor(c - 0.5 - support)) + 1;
+            const int start = max(lo, min(left, hi - taps));
+            first[i] = start;
+
+            std::fill(w.begin(), w.end(), 0.0);
+            double sum = 0.0;
+            for (int t = 0; t < n; ++t) {
+                const int k    = left + t;
+                const double v = filter_weight(filter, (k + 0.5 - c) / fs);
+                w[min(max(k, lo), hi - 1) - start] += v;
+                sum += v;
+            }
+            if (!(fabs(sum) > 1e-8)) {
+                dst[min(max(int(floor(c)), lo), hi - 1) - start] = 1 << RESAMPLE_BITS;
+                continue;
+            }
+
+            // 量化的误差加到最大的权重上，保证权重和不变
+            int total = 0;
+            int big   = 0;
+            for (int t = 0; t < taps; ++t) {
+                dst[t] = static_cast<int16_t>(floor(w[t] / sum * (1 << RESAMPLE_BITS) + 0.5));
+                total += dst[t];
+                if (abs(dst[t]) > abs(dst[big])) {
+                    big = t;
+                }
+            }
+            dst[big] = static_cast<int16_t>(dst[big] + (1 << RESAMPLE_BITS) - total);
+        }
+    }
+};
+
+// 缩放任务，先水平缩放用到的源行，再垂直缩放，每个任务处理 ROWS 行
+struct resample_job
+{
+    enum
+    {
+        ROWS = 32
+    };
+
+    const vgSurface* dst;
+    const vgSurface* src;
+    resample_table columns;      // 水平方向的权重
+    resample_table rows;         // 垂直方向的权重
+    std::vector<vgPixel> buffer; // 水平缩放以后的源行
+    int top;                     // buffer 第一行对应的源行
+    int count;                   // buffer 的行数
+    int pass;                    // 0 水平缩放，1 垂直缩放
+
+    static void run(void* param, int task, int worker)
+    {
+        using namespace std;
+
+        (void) worker;
+        resample_job& job      = *static_cast<resample_job*>(param);
+        const pixel_kernels& k = kernels();
+        const int width        = job.dst->width;
+        const int y1           = task * ROWS;
+
+        if (job.pass == 0) {
+            const int y2 = min(y1 + ROWS, job.count);
+            for (int y = y1; y < y2; ++y) {
+                k.resample_h(&job.buffer[size_t(y) * width], job.src->row(job.top + y), width,
+                    &job.columns.first[0], &job.columns.weights[0], job.columns.taps);
+            }
+            return;
+        }
+
+        const int taps = job.rows.taps;
+        const int y2   = min(y1 + ROWS, job.dst->height);
+        std::vector<const vgPixel*> lines(taps);
+        for (int y = y1; y < y2; ++y) {
+            const vgPixel* line = &job.buffer[size_t(job.rows.first[y] - job.top) * width];
+            for (int t = 0; t < taps; ++t) {
+                lines[t] = line + size_t(t) * width;
+            }
+            k.resample_v(job.dst->row(y), &lines[0], &job.rows.weights[size_t(y) * taps], taps, width);
+        }
+    }
+};
+
+/* 可分离缩放，整个 dst 都会写入
+ * src, source      源像素和采样范围
+ * offsetX, scaleX  目标第 i 列像素中心对应的源坐标是 offsetX + i * scaleX
+ * offsetY, scaleY  目标第 j 行像素中心对应的源坐标是 offsetY + j * scaleY
+ * pool             不为空的时候按行分块多线程执行
+ */
+inline void resample(const vgSurface& dst, const vgSurface& src, const irect& source, int filter,
+    double offsetX, double scaleX, double offsetY, double scaleY, worker_pool* pool)
+{
+    if (dst.empty() || src.empty() || source.empty() || !(scaleX > 0.0) || !(scaleY > 0.0)) {
+        return;
+    }
+
+    resample_job job;
+    job.dst = &dst;
+    job.src = &src;
+    job.columns.build(filter, offsetX, scaleX, dst.width, source.x1, source.x2);
+    job.rows.build(filter, offsetY, scaleY, dst.height, source.y1, source.y2);
+    job.top   = job.rows.first.front();
+    job.count = job.rows.first.back() + job.rows.taps - job.top;
+    job.buffer.resize(size_t(job.count) * dst.width);
+
+    const int passes[2] = {
+        (job.count + resample_job::ROWS - 1) / resample_job::ROWS,
+        (dst.height + resample_job::ROWS - 1) / resample_job::ROWS
+    };
+    for (job.pass = 0; job.pass < 2; ++job.pass) {
+        if (pool) {
+            pool->run(resample_job::run, &job, passes[job.pass]);
+        }
+        else {
+            for (int i = 0; i < passes[job.pass]; ++i) {
+                resample_job::run(&job, i, 0);
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// 图层合成
+//---------------------------------------------------------------------------
+
+// 合成的图层
+struct layer_source
+{
+    vgSurface pixels; // 图层像素（预乘）
+    int x, y;         // 在目标里面的位置
+    uint8_t alpha;    // 不透明度
+
+    layer_source() : pixels(), x(), y(), alpha(255) { }
+    layer_source(const vgSurface& pixels, int x, int y, uint8_t alpha) : pixels(pixels), x(x), y(y), alpha(alpha) { }
+};
+
+/* 合成任务，每个任务处理 ROWS 行，每一行按顺序混合所有图层，目标像素只读写一次缓存。
+ * 半透明的图层先调制到每个线程的临时行里面，再混合。
+ */
+struct composite_job
+{
+    enum
+    {
+        ROWS = 32
+    };
+
+    const vgSurface* dst;
+    const layer_source* layers;
+    size_t count;
+    std::vector< std::vector<vgPixel> > buffers; // 每个线程的临时行
+
+    static void run(void* param, int task, int worker)
+    {
+        using namespace std;
+
+        composite_job& job     = *static_cast<composite_job*>(param);
+        const pixel_kernels& k = kernels();
+        vgPixel* buffer        = &job.buffers[worker][0];
+        const int y1           = task * ROWS;
+        const int y2           = min(y1 + ROWS, job.dst->height);
+
+        for (int y = y1; y < y2; ++y) {
+            vgPixel* row = job.dst->row(y);
+            for (size_t i = 0; i < job.count; ++i) {
+                const layer_source& layer = job.layers[i];
+                const int sy = y - layer.y;
+                const int x1 = max(layer.x, 0);
+                const int x2 = min(layer.x + layer.pixels.width, job.dst->width);
+                if (sy < 0 || sy >= layer.pixels.height || x1 >= x2 || !layer.alpha) {
+                    continue;
+                }
+                const vgPixel* src = layer.pixels.row(sy) + (x1 - layer.x);
+                if (layer.alpha == 255) {
+                    k.composite(row + x1, src, x2 - x1);
+                }
+                else {
+                    k.modulate(buffer, src, x2 - x1, vgPixel(layer.alpha) * 0x01010101u);
+                    k.composite(row + x1, buffer, x2 - x1);
+                }
+            }
+        }
+    }
+};
+
+/* 按顺序把图层混合到 dst 上面（源覆盖）
+ * pool             不为空的时候按行分块多线程执行
+ */
+inline void composite_layers(const vgSurface& dst, const layer_source* layers, size_t count, worker_pool* pool)
+{
+    if (dst.empty() || !count) {
+        return;
+    }
+
+    composite_job job;
+    job.dst    = &dst;
+    job.layers = layers;
+    job.count  = count;
+    job.buffers.resize(pool ? pool->size() : 1, std::vector<vgPixel>(dst.width));
+
+    const int tasks = (dst.height + composite_job::ROWS - 1) / composite_job::ROWS;
+    if (pool) {
+        pool->run(composite_job::run, &job, tasks);
+    }
+    else {
+        for (int i = 0; i < tasks; ++i) {
+            composite_job::run(&job, i, 0);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// 脏矩形
+//---------------------------------------------------------------------------
+
+/* 一帧里面改变的区域
+ * 新矩形和已有的矩形合并以后面积不超过两者之和（相交或者相邻）就合并成一个，
+ * 矩形数量达到 MAX_RECTS 以后，和合并增加面积最少的矩形合并。
+ */
+class damage_region
+{
+public:
+    enum
+    {
+        MAX_RECTS = 16
+    };
+
+private:
+    std::vector<irect> m_rects;
+
+public:
+    void clear()
+    {
+        m_rects.clear();
+    }
+
+    bool empty() const
+    {
+        return m_rects.empty();
+    }
+
+    const std::vector<irect>& rects() const
+    {
+        return m_rects;
+    }
+
+    void add(irect r)
+    {
+        if (r.empty()) {
+            return;
+        }
+
+        // 合并以后的矩形可能和前面检查过的矩形相交，从头检查
+        for (size_t i = 0; i < m_rects.size();) {
+            irect u = m_rects[i].unite(r);
+            if (u.area() <= m_rects[i].area() + r.area()) {
+                r = u;
+                m_rects.erase(m_rects.begin() + i);
+                i = 0;
+            }
+            else {
+                ++i;
+            }
+        }
+
+        if (m_rects.size() >= MAX_RECTS) {
+            size_t best   = 0;
+            int64_t least = 0;
+            for (size_t i = 0; i < m_rects.size(); ++i) {
+                int64_t grow = m_rects[i].unite(r).area() - m_rects[i].area();
+                if (i == 0 || grow < least) {
+                    best  = i;
+                    least = grow;
+                }
+            }
+            r = r.unite(m_rects[best]);
+            m_rects.erase(m_rects.begin() + best);
+            this->add(r);
+            return;
+        }
+
+        m_rects.push_back(r);
+    }
+};
+
+/* 分块比较两帧的像素
+ * 每个分块计算一个哈希值，和上一帧不同的分块加到脏矩形里面。
+ * 只看像素内容，不管像素是怎么画上去的。
+ */
+class frame_diff
+{
+public:
+    enum
+    {
+        TILE_SIZE = 32
+    };
+
+private:
+    std::vector<uint32_t> m_hashes; // 上一帧每个分块的哈希
+    std::vector<uint32_t> m_row;    // 当前一排分块的哈希
+    int m_width, m_height;
+
+public:
+    frame_diff() : m_width(), m_height() { }
+
+    // 下一次比较的时候所有分块都算改变
+    void reset()
+    {
+        m_hashes.clear();
+    }
+
+    /* 计算 surface 每个分块的哈希，改变的分块（同一排相邻的合并）加到 damage
+     * 返回改变的分块数量
+     */
+    size_t update(const vgSurface& surface, damage_region& damage)
+    {
+        const int columns = (surface.width + TILE_SIZE - 1) / TILE_SIZE;
+        const int rows    = (surface.height + TILE_SIZE - 1) / TILE_SIZE;
+        const bool first  = surface.width != m_width || surface.height != m_height || m_hashes.empty();
+        m_width  = surface.width;
+        m_height = surface.height;
+        m_hashes.resize(size_t(columns) * rows);
+        m_row.resize(columns);
+
+        const hash_func hash = kernels().hash;
+        size_t changed       = 0;
+        for (int ty = 0; ty < rows; ++ty) {
+            const int y1 = ty * TILE_SIZE;
+            const int y2 = std::min(y1 + TILE_SIZE, surface.height);
+
+            // 按行遍历，每个分块的哈希逐行串联
+            for (int tx = 0; tx < columns; ++tx) {
+                m_row[tx] = uint32_t(ty * columns + tx);
+            }
+            for (int y = y1; y < y2; ++y) {
+                const vgPixel* line = surface.row(y);
+                for (int tx = 0; tx < columns; ++tx) {
+                    const int x = tx * TILE_SIZE;
+                    m_row[tx]   = hash(line + x, std::min(int(TILE_SIZE), surface.width - x), m_row[tx]);
+                }
+            }
+
+            uint32_t* last = &m_hashes[size_t(ty) * columns];
+            int run        = -1;
+            for (int tx = 0; tx <= columns; ++tx) {
+                bool dirty = false;
+                if (tx < columns) {
+                    dirty    = first || m_row[tx] != last[tx];
+                    last[tx] = m_row[tx];
+                }
+                if (dirty) {
+                    ++changed;
+                    if (run < 0) {
+                        run = tx;
+                    }
+                }
+                else if (run >= 0) {
+                    damage.add(irect(run * TILE_SIZE, y1, std::min(tx * TILE_SIZE, surface.width), y2));
+                    run = -1;
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+//---------------------------------------------------------------------------
+// 显示列表
+//---------------------------------------------------------------------------
+
+enum
+{
+    CMD_CLEAR,  // 填充矩形范围
+    CMD_RECT,   // 混合对齐到像素的矩形
+    CMD_FILL,   // 纯色填充多边形
+    CMD_IMAGE,  // 图片填充多边形
+    CMD_SPRITE, // 精灵，不使用顶点
+    CMD_BLIT,   // 对齐到像素的图片，按行混合
+    CMD_ELLIPSE,// 纯色椭圆、椭圆环，不使用顶点
+    CMD_LINE,   // 1 像素宽的细线，每个轮廓是一条折线
+    CMD_GRADIENT,// 渐变填充多边形
+    CMD_BATCH,  // 批量绘制，按顺序执行 display_list::batch 里面的一段图元
+    CMD_SHAPES  // 批量绘制的简单图元，按顺序直接混合 display_list::shapes 里面的一段
+};
+
+// 分块里面的序号：BATCH_ITEM 是 display_list::batch 里面的图元，SHAPE_ITEM 是 display_list::shapes 里面的图元
+const uint32_t BATCH_ITEM = 0x80000000u;
+const uint32_t SHAPE_ITEM = 0x40000000u;
+const uint32_t ITEM_INDEX = 0x3FFFFFFFu;
+
+/* 绘图命令
+ * 只保存数值，顶点保存在 display_list 里面。
+ * 命令执行的时候只依赖自己保存的状态，可以在任意剪裁范围内重复执行，结果相同。
+ */
+struct command
+{
+    int type;
+    irect bounds;           // 影响的像素范围（已经和剪裁矩形求交集）
+    vgPixel color;          // 颜色（预乘）
+    uint8_t rule;           // 填充规则
+    uint8_t antialias;      // 抗锯齿
+    uint8_t accumulate;     // 使用累加缓冲区
+    uint8_t bilinear;       // 图片双线性插值
+    uint8_t closed;         // 细线首尾相连
+    uint8_t blend;          // 混合模式 vgBlendMode
+    uint8_t gradient;       // 渐变类型
+    uint8_t spread;         // 渐变扩展方式
+    uint32_t ramp;          // 渐变颜色表在 display_list::ramps 里面的位置
+    uint32_t point;         // 第一个顶点（CMD_BATCH、CMD_SHAPES 是第一个图元）
+    uint32_t contour;       // 第一个轮廓
+    uint32_t contours;      // 轮廓数量（CMD_BATCH、CMD_SHAPES 是图元数量）
+    vgSurface image;        // 图片
+    irect source;           // 图片采样范围
+    vgSurface next;         // 三线性插值的下一级 mipmap
+    irect nextSource;       // 下一级的采样范围
+    uint32_t mix;           // 下一级的权重 0 ~ 256，为 0 的时候不插值
+    vgMatrix inverse;       // 目标坐标到图片坐标（渐变坐标）的矩阵
+    vgRect region;          // 精灵在图片上的范围
+    int originX, originY;   // 对齐图片左上角的目标位置
+    int scaleX, scaleY;     // 对齐图片的整数放大倍数
+    vec2f center;           // 椭圆圆心
+    vec2f radius;           // 椭圆半径
+    vec2f hole;             // 椭圆环的内半径，实心椭圆为 0
+};
+
+enum
+{
+    SHAPE_RECT,     // 没有旋转、镜像的矩形
+    SHAPE_ELLIPSE   // 纯色椭圆、椭圆环
+};
+
+/* 批量绘制的简单图元
+ * 不使用顶点和光栅化器，执行的时候逐行直接混合，比 command 小很多，批次里面不用逐个分派命令。
+ */
+struct shape
+{
+    irect bounds;           // 影响的像素范围（已经和剪裁矩形求交集）
+    vgPixel color;          // 颜色（预乘）
+    uint8_t type;           // SHAPE_RECT, SHAPE_ELLIPSE
+    uint8_t antialias;      // 抗锯齿
+    uint8_t blend;          // 混合模式 vgBlendMode
+    int x1, y1, x2, y2;     // 矩形的边，24.8 定点数，和光栅化器的取整相同
+    vec2f center;           // 椭圆圆心
+    vec2f radius;           // 椭圆半径
+    vec2f hole;             // 椭圆环的内半径，实心椭圆为 0
+};
+
+class display_list
+{
+public:
+    enum
+    {
+        CULL_WINDOW = 64    // 不透明命令向前查找被覆盖的命令的数量
+    };
+
+    std::vector<command> commands;
+    std::vector<command> batch;     // 批量绘制的图元，只由 CMD_BATCH 引用
+    std::vector<shape> shapes;      // 批量绘制的简单图元，只由 CMD_SHAPES 引用
+    std::vector<vec2f> points;
+    std::vector<uint32_t> contours; // 每个轮廓的顶点数量
+    std::vector<vgPixel> ramps;     // 渐变颜色表，每个 RAMP_SIZE 个颜色
+    std::deque< std::vector<vgPixel> > images; // 记录时生成的图片（缩放以后的图片），deque 增加元素不移动已有的图片
+
+private:
+    std::vector<uint8_t> m_hidden;
+
+public:
+    bool empty() const
+    {
+        return commands.empty();
+    }
+
+    void clear()
+    {
+        commands.clear();
+        batch.clear();
+        shapes.clear();
+        points.clear();
+        contours.clear();
+        ramps.clear();
+        images.clear();
+    }
+
+    /* 整理命令，执行结果和按顺序逐个执行相同
+     * 1. 被后面的不透明命令（CMD_CLEAR、不透明或者复制模式的 CMD_RECT）完全覆盖的命令看不到，直接删除。
+     *    覆盖整个 screen 的 CMD_CLEAR 之前的命令全部删除。
+     * 2. 相邻的两个同色矩形，如果能拼成一个矩形，合并成一个命令。
+     * 顶点不需要移动，命令里面保存的顶点位置仍然有效。
+     */
+    void optimize(const irect& screen)
+    {
+        const size_t n = commands.size();
+        m_hidden.assign(n, 0);
+
+        for (size_t i = 0; i < n; ++i) {
+            const command& cmd = commands[i];
+            if (!is_opaque(cmd)) {
+                continue;
+            }
+
+            if (cmd.type == CMD_CLEAR && cmd.bounds.contains(screen)) {
+                std::fill(m_hidden.begin(), m_hidden.begin() + i, 1);
+                continue;
+            }
+
+            size_t end = i > CULL_WINDOW ? i - CULL_WINDOW : 0;
+            for (size_t j = i; j-- > end;) {
+                if (cmd.bounds.contains(commands[j].bounds)) {
+                    m_hidden[j] = 1;
+                }
+            }
+        }
+
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (m_hidden[i]) {
+                continue;
+            }
+            if (count && merge_rect(commands[count - 1], commands[i])) {
+                continue;
+            }
+            commands[count++] = commands[i];
+        }
+        commands.resize(count);
+    }
+
+private:
+    static bool is_opaque(const command& cmd)
+    {
+        if (cmd.type == CMD_CLEAR) {
+            return true;
+        }
+        return cmd.type == CMD_RECT && (cmd.blend == VG_BLEND_COPY || (cmd.blend == VG_BLEND_NORMAL && (cmd.color >> 24) == 255));
+    }
+
+    // 拼接上下或者左右相邻的同色矩形
+    static bool merge_rect(command& a, const command& b)
+    {
+        if (a.type != b.type || a.color != b.color || a.blend != b.blend || (a.type != CMD_RECT && a.type != CMD_CLEAR)) {
+            return false;
+        }
+
+        const irect& r = a.bounds;
+        const irect& s = b.bounds;
+        if ((r.x1 == s.x1 && r.x2 == s.x2 && (r.y2 == s.y1 || s.y2 == r.y1)) ||
+            (r.y1 == s.y1 && r.y2 == s.y2 && (r.x2 == s.x1 || s.x2 == r.x1))) {
+            a.bounds = r.unite(s);
+            return true;
+        }
+        return false;
+    }
+};
+
+// 按行填充或者混合一个矩形范围
+inline void fill_rows(const vgSurface& target, const irect& rect, vgPixel color, span_func func)
+{
+    // 整行并且行之间没有间隙，一次处理整块内存
+    if (rect.width() == target.width && std::abs(target.stride) == target.width) {
+        func(std::min(target.row(rect.y1), target.row(rect.y2 - 1)), rect.width() * rect.height(), color);
+        return;
+    }
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        func(target.row(y) + rect.x1, rect.width(), color);
+    }
+}
+
+template<typename P>
+void rasterize(rasterizer& ras, const display_list& list, const command& cmd, const irect& clip, P& painter)
+{
+    ras.reset(clip);
+    if (cmd.accumulate) {
+        ras.accumulate(clip);
+    }
+
+    const vec2f* p = &list.points[cmd.point];
+    for (uint32_t i = 0; i < cmd.contours; ++i) {
+        uint32_t n = list.contours[cmd.contour + i];
+        ras.add_polygon(p, n);
+        p += n;
+    }
+    ras.render(painter, cmd.rule, cmd.antialias != 0);
+}
+
+/* 对齐到像素的图片：不缩放的直接按行混合，整数倍放大的每个源像素重复 scale 次
+ * cmd.color 是调制颜色（透明度和着色），不是白色的时候先用 modulate 内核乘到一段临时像素上
+ */
+inline void render_blit(const vgSurface& target, const command& cmd, const irect& clip)
+{
+    enum { CHUNK = 256 };
+
+    const pixel_kernels& k = kernels();
+    const int offset = clip.x1 - cmd.originX;
+    const bool tinted = cmd.color != 0xFFFFFFFF;
+    vgPixel buf[CHUNK];
+    for (int y = clip.y1; y < clip.y2; ++y) {
+        const vgPixel* src = cmd.image.row(cmd.source.y1 + (y - cmd.originY) / cmd.scaleY) + cmd.source.x1;
+        vgPixel* dst = target.row(y);
+        if (cmd.scaleX == 1 && !tinted) {
+            k.modes[cmd.blend](dst + clip.x1, src + offset, clip.width());
+            continue;
+        }
+        if (cmd.scaleX == 1) {
+            for (int x = clip.x1; x < clip.x2; x += CHUNK) {
+                int n = std::min(int(CHUNK), clip.x2 - x);
+                k.modulate(buf, src + offset + (x - clip.x1), n, cmd.color);
+                k.modes[cmd.blend](dst + x, buf, n);
+            }
+            continue;
+        }
+
+        int i = offset / cmd.scaleX;
+        int n = cmd.scaleX - offset % cmd.scaleX;
+        for (int x = clip.x1; x < clip.x2; x += n, n = cmd.scaleX, ++i) {
+            n = std::min(n, clip.x2 - x);
+            blend_color(dst + x, n, tinted ? modulate_pixel(src[i], cmd.color) : src[i], cmd.blend);
+        }
+    }
+}
+
+/* 像素中心在椭圆里面的深度（像素），外面为负数
+ * 圆是精确距离，椭圆用 (1 - k) / |grad k| 近似，k = sqrt((dx / rx)^2 + (dy / ry)^2)
+ */
+inline float ellipse_depth(float dx, float dy, float rx, float ry)
+{
+    if (rx == ry) {
+        return rx - sqrt(dx * dx + dy * dy);
+    }
+    float u = dx / rx;
+    float v = dy / ry;
+    float k = sqrt(u * u + v * v);
+    float g = sqrt(u * u / (rx * rx) + v * v / (ry * ry));
+    return g > 0.0f ? (1.0f - k) * k / g : std::min(rx, ry);
+}
+
+/* 像素中心在椭圆里面的范围 [x1, x2)，没有返回 false
+ * dy 是像素中心到圆心的垂直距离
+ */
+inline bool ellipse_span(float ox, float dy, float rx, float ry, int& x1, int& x2)
+{
+    if (rx <= 0.0f || ry <= 0.0f) {
+        return false;
+    }
+    float t = 1.0f - (dy / ry) * (dy / ry);
+    if (t <= 0.0f) {
+        return false;
+    }
+    float w = rx * sqrt(t);
+    x1 = int(ceil(ox - w - 0.5f));
+    x2 = int(floor(ox + w - 0.5f)) + 1;
+    return x1 < x2;
+}
+
+/* 绘制纯色椭圆、椭圆环
+ * 覆盖率按像素中心到边的距离解析计算，每行只对边缘像素计算，
+ * 里面完全覆盖的部分直接用 blend 内核混合，环中间的空洞跳过。
+ * 半径不超过 SMALL_RADIUS 的小圆（散点），直接遍历包围盒。
+ */
+inline void render_ellipse(const vgSurface& target, const irect& clip, const vec2f& center, const vec2f& radius, const vec2f& hole,
+    vgPixel color, bool aa, int mode)
+{
+    using namespace std;
+
+    enum { SMALL_RADIUS = 4 };
+
+    const float ox = center.x;
+    const float oy = center.y;
+    const float rx = radius.x;
+    const float ry = radius.y;
+    const float hx = hole.x;
+    const float hy = hole.y;
+    const bool ring = hx > 0.0f && hy > 0.0f;
+
+    // 比一个像素小的椭圆，覆盖率不超过直径
+    const float limit = min(rx * 2.0f, 1.0f) * min(ry * 2.0f, 1.0f);
+
+    for (int y = clip.y1; y < clip.y2; ++y) {
+        const float dy = float(y) + 0.5f - oy;
+
+        // 外边向外一个像素以内可能有覆盖；外边向内一个像素以内完全覆盖；
+        // 内边向外一个像素以内需要计算，内边向内一个像素以内完全不覆盖
+        int x1 = clip.x1, x2 = clip.x2;
+        int i1 = clip.x2, i2 = clip.x2;
+        int h1 = clip.x2, h2 = clip.x2;
+        int s1 = clip.x2, s2 = clip.x2;
+        if (max(rx, ry) > SMALL_RADIUS) {
+            if (!ellipse_span(ox, dy, rx + 1.0f, ry + 1.0f, x1, x2)) {
+                continue;
+            }
+            x1 = max(x1, clip.x1);
+            x2 = min(x2, clip.x2);
+            if (ellipse_span(ox, dy, rx - 1.0f, ry - 1.0f, i1, i2)) {
+                i1 = max(i1, x1);
+                i2 = min(i2, x2);
+            }
+            if (ring && ellipse_span(ox, dy, hx + 1.0f, hy + 1.0f, h1, h2)) {
+                if (!ellipse_span(ox, dy, hx - 1.0f, hy - 1.0f, s1, s2)) {
+                    s1 = s2 = clip.x2;
+                }
+            }
+        }
+
+        vgPixel* dst = target.row(y);
+        int x = x1;
+        while (x < x2) {
+            if (x >= s1 && x < s2) {
+                x = s2;
+                continue;
+            }
+            if (x >= i1 && x < i2 && (x < h1 || x >= h2)) {
+                int end = (h1 > x && h1 < i2) ? h1 : i2;
+                blend_color(dst + x, end - x, color, mode);
+                x = end;
+                continue;
+            }
+
+            const float dx = float(x) + 0.5f - ox;
+            float d = ellipse_depth(dx, dy, rx, ry);
+            float c;
+            if (aa) {
+                c = min(d + 0.5f, limit);
+                if (ring && c > 0.0f) {
+                    c -= max(min(ellipse_depth(dx, dy, hx, hy) + 0.5f, 1.0f), 0.0f);
+                }
+            }
+            else {
+                c = (d >= 0.0f && (!ring || ellipse_depth(dx, dy, hx, hy) < 0.0f)) ? 1.0f : 0.0f;
+            }
+            if (c > 0.0f) {
+                uint32_t cover = uint32_t(c * 255.0f + 0.5f);
+                if (cover) {
+                    dst[x] = blend_pixel(dst[x], color, cover, mode);
+                }
+            }
+            ++x;
+        }
+    }
+}
+
+inline void render_ellipse(const vgSurface& target, const command& cmd, const irect& clip)
+{
+    render_ellipse(target, clip, cmd.center, cmd.radius, cmd.hole, cmd.color, cmd.antialias != 0, cmd.blend);
+}
+
+// 矩形的覆盖率：area 是像素被覆盖的面积（24.8 定点数，一个像素是 256 * 256），和 calc_alpha 一样向上取整
+inline uint32_t rect_cover(int area, bool antialias)
+{
+    uint32_t cover = std::min((area + 255) >> 8, 255);
+    if (!antialias) {
+        cover = cover >= 128 ? 255 : 0;
+    }
+    return cover;
+}
+
+/* 绘制批量的矩形，结果和光栅化器用 VG_NONZERO 填充同样的矩形完全相同
+ * 边已经按光栅化器的方式取整到 24.8 定点数，每个像素覆盖的面积是行高乘以列宽，
+ * 每行只有左右两个边缘像素的覆盖率不同，中间用 blend 内核混合。
+ */
+inline void render_rect(const vgSurface& target, const shape& s, const irect& clip)
+{
+    using namespace std;
+
+    const bool aa = s.antialias != 0;
+    const int lx  = s.x1 >> 8;  // 左边所在的列
+    const int rx  = s.x2 >> 8;  // 右边所在的列
+    const int fl  = s.x1 & 255;
+    const int fr  = s.x2 & 255;
+
+    for (int y = clip.y1; y < clip.y2; ++y) {
+        const int dy = min(s.y2, (y + 1) * 256) - max(s.y1, y * 256);
+        if (dy <= 0) {
+            continue;
+        }
+
+        vgPixel* dst = target.row(y);
+        if (lx == rx) {
+            uint32_t cover = rect_cover(dy * (fr - fl), aa);
+            if (cover && lx >= clip.x1 && lx < clip.x2) {
+                dst[lx] = blend_pixel(dst[lx], s.color, cover, s.blend);
+            }
+            continue;
+        }
+
+        uint32_t cover = rect_cover(dy * (256 - fl), aa);
+        if (cover && lx >= clip.x1 && lx < clip.x2) {
+            dst[lx] = blend_pixel(dst[lx], s.color, cover, s.blend);
+        }
+        const int x1 = max(lx + 1, clip.x1);
+        const int x2 = min(rx, clip.x2);
+        cover = rect_cover(dy * 256, aa);
+        if (cover && x2 > x1) {
+            blend_solid_hline(dst + x1, x2 - x1, s.color, cover, s.blend);
+        }
+        cover = rect_cover(dy * fr, aa);
+        if (cover && rx >= clip.x1 && rx < clip.x2) {
+            dst[rx] = blend_pixel(dst[rx], s.color, cover, s.blend);
+        }
+    }
+}
+
+// 在 tile 范围内绘制一个简单图元
+inline void render_shape(const vgSurface& target, const shape& s, const irect& tile)
+{
+    irect clip = s.bounds.intersect(tile);
+    if (clip.empty()) {
+        return;
+    }
+    if (s.type == SHAPE_RECT) {
+        render_rect(target, s, clip);
+    }
+    else {
+        render_ellipse(target, clip, s.center, s.radius, s.hole, s.color, s.antialias != 0, s.blend);
+    }
+}
+
+// 求 lo < k * (x + 0.5) + b < hi 的 x 范围，和 [x1, x2] 求交集。范围为空返回 false
+inline bool sprite_span(float k, float b, float lo, float hi, float& x1, float& x2)
+{
+    if (std::fabs(k) < 1e-12f) {
+        return b > lo && b < hi;
+    }
+    float t1 = (lo - b) / k - 0.5f;
+    float t2 = (hi - b) / k - 0.5f;
+    if (k < 0.0f) {
+        std::swap(t1, t2);
+    }
+    x1 = std::max(x1, t1);
+    x2 = std::min(x2, t2);
+    return x1 <= x2;
+}
+
+/* 绘制精灵
+ * 仿射纹理映射：逐行解出像素中心落在精灵内的范围，只遍历这一段像素。
+ * 抗锯齿的覆盖率按像素中心到四条边的距离计算，不经过多边形光栅化。
+ */
+inline void render_sprite(const vgSurface& target, const command& cmd, const irect& clip)
+{
+    using namespace std;
+
+    const vgMatrix& m = cmd.inverse;
+    image_painter painter(&target, &cmd.image, cmd.source, m, cmd.bilinear != 0, cmd.blend, &cmd.next, cmd.nextSource, cmd.mix);
+
+    const float u1 = cmd.region.x;
+    const float v1 = cmd.region.y;
+    const float u2 = u1 + cmd.region.w;
+    const float v2 = v1 + cmd.region.h;
+
+    // 图片坐标每单位对应的目标像素距离
+    const float ku = 1.0f / sqrt(m.a * m.a + m.c * m.c);
+    const float kv = 1.0f / sqrt(m.b * m.b + m.d * m.d);
+
+    // 抗锯齿的时候边缘向外扩展半个像素
+    const float eu = cmd.antialias ? 0.5f / ku : 0.0f;
+    const float ev = cmd.antialias ? 0.5f / kv : 0.0f;
+
+    // 精灵比一个像素窄的时候，覆盖率不超过宽度
+    const float wu = min(cmd.region.w * ku, 1.0f);
+    const float wv = min(cmd.region.h * kv, 1.0f);
+
+    // 只有透明度的时候乘到覆盖率上，有着色的时候颜色单独调制
+    const uint32_t alpha = cmd.color >> 24;
+    const bool tinted    = cmd.color != alpha * 0x01010101;
+
+    for (int y = clip.y1; y < clip.y2; ++y) {
+        float fy = float(y) + 0.5f;
+        float u0 = m.c * fy + m.tx;
+        float v0 = m.d * fy + m.ty;
+
+        float xl = float(clip.x1);
+        float xr = float(clip.x2 - 1);
+        if (!sprite_span(m.a, u0, u1 - eu, u2 + eu, xl, xr) || !sprite_span(m.b, v0, v1 - ev, v2 + ev, xl, xr)) {
+            continue;
+        }
+
+        // 浮点误差向外扩展一个像素，多出来的像素覆盖率为 0
+        int x1 = max(clip.x1, int(floor(xl)) - 1);
+        int x2 = min(clip.x2, int(ceil(xr)) + 2);
+
+        vgPixel* dst = target.row(y);
+        for (int x = x1; x < x2; ++x) {
+            float fx = float(x) + 0.5f;
+            float u  = m.a * fx + u0;
+            float v  = m.b * fx + v0;
+
+            uint32_t cover;
+            if (cmd.antialias) {
+                float cu = min(min(u - u1, u2 - u) * ku + 0.5f, wu);
+                float cv = min(min(v - v1, v2 - v) * kv + 0.5f, wv);
+                if (cu <= 0.0f || cv <= 0.0f) {
+                    continue;
+                }
+                cover = uint32_t(cu * cv * 255.0f + 0.5f);
+            }
+            else {
+                if (u < u1 || u >= u2 || v < v1 || v >= v2) {
+                    continue;
+                }
+                cover = 255;
+            }
+
+            if (tinted) {
+                if (cover) {
+                    dst[x] = blend_pixel(dst[x], modulate_pixel(painter.sample(u, v), cmd.color), cover, cmd.blend);
+                }
+                continue;
+            }
+            if (alpha != 255) {
+                cover = mul255(cover, alpha);
+            }
+            if (cover) {
+                dst[x] = blend_pixel(dst[x], painter.sample(u, v), cover, cmd.blend);
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// 细线
+//---------------------------------------------------------------------------
+
+// Cohen-Sutherland 区域编码
+inline int outcode(double x, double y, double x1, double y1, double x2, double y2)
+{
+    int code = 0;
+    if (x < x1) {
+        code |= 1;
+    }
+    else if (x > x2) {
+        code |= 2;
+    }
+    if (y < y1) {
+        code |= 4;
+    }
+    else if (y > y2) {
+        code |= 8;
+    }
+    return code;
+}
+
+/* Cohen-Sutherland 剪裁线段到矩形 [x1, x2] x [y1, y2]
+ * 线段完全在矩形外面返回 false
+ */
+inline bool clip_line(double& ax, double& ay, double& bx, double& by, double x1, double y1, double x2, double y2)
+{
+    int ca = outcode(ax, ay, x1, y1, x2, y2);
+    int cb = outcode(bx, by, x1, y1, x2, y2);
+    for (;;) {
+        if (!(ca | cb)) {
+            return true;
+        }
+        if (ca & cb) {
+            return false;
+        }
+
+        int code = ca ? ca : cb;
+        double x, y;
+        if (code & 8) {
+            x = ax + (bx - ax) * (y2 - ay) / (by - ay);
+            y = y2;
+        }
+        else if (code & 4) {
+            x = ax + (bx - ax) * (y1 - ay) / (by - ay);
+            y = y1;
+        }
+        else if (code & 2) {
+            x = x2;
+            y = ay + (by - ay) * (x2 - ax) / (bx - ax);
+        }
+        else {
+            x = x1;
+            y = ay + (by - ay) * (x1 - ax) / (bx - ax);
+        }
+
+        if (code == ca) {
+            ax = x;
+            ay = y;
+            ca = outcode(ax, ay, x1, y1, x2, y2);
+        }
+        else {
+            bx = x;
+            by = y;
+            cb = outcode(bx, by, x1, y1, x2, y2);
+        }
+    }
+}
+
+inline void plot(const vgSurface& target, const irect& clip, int x, int y, vgPixel color, uint32_t cover, int mode)
+{
+    if (cover && x >= clip.x1 && x < clip.x2 && y >= clip.y1 && y < clip.y2) {
+        vgPixel* p = target.row(y) + x;
+        *p = blend_pixel(*p, color, cover, mode);
+    }
+}
+
+/* 画一条细线段，不包含终点像素（last 为 true 的时候包含）
+ * 每个像素只由线段本身决定，和剪裁范围无关，所以分块绘制的结果相同。
+ * Bresenham：端点取所在的像素，主轴方向每个像素画一个点。
+ * Wu：在像素中心坐标上，主轴方向每个像素按次轴的小数部分分给相邻的两个像素。
+ */
+inline void render_segment(const vgSurface& target, const irect& clip, vec2f a, vec2f b, bool last, vgPixel color, bool aa, int mode)
+{
+    using namespace std;
+
+    // NaN 直接忽略，超出范围的坐标先剪裁到范围以内
+    if (!(a.x == a.x && a.y == a.y && b.x == b.x && b.y == b.y)) {
+        return;
+    }
+    double ax = a.x, ay = a.y, bx = b.x, by = b.y;
+    const double limit = double(rasterizer::LIMIT);
+    if (!clip_line(ax, ay, bx, by, -limit, -limit, limit, limit)) {
+        return;
+    }
+
+    // 剪裁到当前范围（向外一个像素），确定主轴方向需要处理的像素
+    double cx1 = ax, cy1 = ay, cx2 = bx, cy2 = by;
+    if (!clip_line(cx1, cy1, cx2, cy2, clip.x1 - 1.0, clip.y1 - 1.0, clip.x2 + 1.0, clip.y2 + 1.0)) {
+        return;
+    }
+
+    // 统一成 x 是主轴，从小到大
+    const bool steep = fabs(by - ay) > fabs(bx - ax);
+    if (steep) {
+        swap(ax, ay);
+        swap(bx, by);
+        swap(cx1, cy1);
+        swap(cx2, cy2);
+    }
+    bool skipLo = false;
+    bool skipHi = !last;
+    if (ax > bx) {
+        swap(ax, bx);
+        swap(ay, by);
+        swap(skipLo, skipHi);
+    }
+    const int lo = int(floor(min(cx1, cx2))) - 1;
+    const int hi = int(floor(max(cx1, cx2))) + 1;
+
+    if (!aa) {
+        const int64_t x0 = int64_t(floor(ax));
+        const int64_t y0 = int64_t(floor(ay));
+        const int64_t x1 = int64_t(floor(bx));
+        const int64_t dx = x1 - x0;
+        const int64_t dy = int64_t(floor(by)) - y0;
+        int64_t first = skipLo ? x0 + 1 : x0;
+        int64_t end   = skipHi ? x1 - 1 : x1;
+        if (dx == 0) {
+            if (!skipLo && !skipHi) {
+                steep ? plot(target, clip, int(y0), int(x0), color, 255, mode) : plot(target, clip, int(x0), int(y0), color, 255, mode);
+            }
+            return;
+        }
+        first = max(first, int64_t(lo));
+        end   = min(end, int64_t(hi));
+        if (first > end) {
+            return;
+        }
+
+        // y = y0 + floor(((x - x0) * 2dy + dx) / 2dx)，r 是 Bresenham 的误差项
+        const int64_t d2 = dx * 2;
+        int64_t n = (first - x0) * dy * 2 + dx;
+        int64_t q = n / d2;
+        int64_t r = n - q * d2;
+        if (r < 0) {
+            r += d2;
+            --q;
+        }
+        int64_t y = y0 + q;
+        for (int64_t x = first; x <= end; ++x) {
+            steep ? plot(target, clip, int(y), int(x), color, 255, mode) : plot(target, clip, int(x), int(y), color, 255, mode);
+            r += dy * 2;
+            if (r >= d2) {
+                r -= d2;
+                ++y;
+            }
+            else if (r < 0) {
+                r += d2;
+                --y;
+            }
+        }
+        return;
+    }
+
+    // 像素中心坐标
+    const double u0 = ax - 0.5, v0 = ay - 0.5;
+    const double u1 = bx - 0.5, v1 = by - 0.5;
+    if (u1 - u0 < 1e-9) {
+        if (!skipLo && !skipHi) {
+            int x = int(floor(ax));
+            int y = int(floor(ay));
+            steep ? plot(target, clip, y, x, color, 255, mode) : plot(target, clip, x, y, color, 255, mode);
+        }
+        return;
+    }
+
+    const double k = (v1 - v0) / (u1 - u0);
+    int first = skipLo ? int(floor(u0)) + 1 : int(ceil(u0));
+    int end   = skipHi ? int(ceil(u1)) - 1 : int(floor(u1));
+    first = max(first, lo);
+    end   = min(end, hi);
+    for (int x = first; x <= end; ++x) {
+        double v = v0 + (x - u0) * k;
+        int y    = int(floor(v));
+        uint32_t c2 = uint32_t((v - y) * 255.0 + 0.5);
+        uint32_t c1 = 255 - c2;
+        if (steep) {
+            plot(target, clip, y, x, color, c1, mode);
+            plot(target, clip, y + 1, x, color, c2, mode);
+        }
+        else {
+            plot(target, clip, x, y, color, c1, mode);
+            plot(target, clip, x, y + 1, color, c2, mode);
+        }
+    }
+}
+
+inline void render_lines(const vgSurface& target, const display_list& list, const command& cmd, const irect& clip)
+{
+    const vec2f* p = &list.points[cmd.point];
+    for (uint32_t i = 0; i < cmd.contours; ++i) {
+        const uint32_t n = list.contours[cmd.contour + i];
+        if (cmd.closed) {
+            for (uint32_t j = 0; j < n; ++j) {
+                render_segment(target, clip, p[j], p[(j + 1) % n], false, cmd.color, cmd.antialias != 0, cmd.blend);
+            }
+        }
+        else {
+            for (uint32_t j = 0; j + 1 < n; ++j) {
+                render_segment(target, clip, p[j], p[j + 1], j + 2 == n, cmd.color, cmd.antialias != 0, cmd.blend);
+            }
+        }
+        p += n;
+    }
+}
+
+// 在 tile 范围内执行一个命令
+inline void execute(const vgSurface& target, const display_list& list, const command& cmd, const irect& tile, rasterizer& ras)
+{
+    irect clip = cmd.bounds.intersect(tile);
+    if (clip.empty()) {
+        return;
+    }
+
+    switch (cmd.type) {
+    case CMD_CLEAR:
+        fill_rows(target, clip, cmd.color, kernels().fill);
+        break;
+    case CMD_RECT:
+        if (cmd.blend == VG_BLEND_NORMAL) {
+            fill_rows(target, clip, cmd.color, kernels().blend);
+        }
+        else {
+            for (int y = clip.y1; y < clip.y2; ++y) {
+                blend_color(target.row(y) + clip.x1, clip.width(), cmd.color, cmd.blend);
+            }
+        }
+        break;
+    case CMD_FILL: {
+        solid_painter painter(&target, cmd.color, cmd.blend);
+        rasterize(ras, list, cmd, clip, painter);
+        break;
+    }
+    case CMD_IMAGE: {
+        image_painter painter(&target, &cmd.image, cmd.source, cmd.inverse, cmd.bilinear != 0, cmd.blend,
+            &cmd.next, cmd.nextSource, cmd.mix);
+        rasterize(ras, list, cmd, clip, painter);
+        break;
+    }
+    case CMD_SPRITE:
+        render_sprite(target, cmd, clip);
+        break;
+    case CMD_BLIT:
+        render_blit(target, cmd, clip);
+        break;
+    case CMD_ELLIPSE:
+        render_ellipse(target, cmd, clip);
+        break;
+    case CMD_LINE:
+        render_lines(target, list, cmd, clip);
+        break;
+    case CMD_GRADIENT: {
+        gradient_painter painter(&target, &list.ramps[cmd.ramp], cmd.inverse, cmd.gradient, cmd.spread, cmd.blend);
+        rasterize(ras, list, cmd, clip, painter);
+        break;
+    }
+    case CMD_BATCH:
+        for (uint32_t i = 0; i < cmd.contours; ++i) {
+            execute(target, list, list.batch[cmd.point + i], tile, ras);
+        }
+        break;
+    case CMD_SHAPES:
+        for (uint32_t i = 0; i < cmd.contours; ++i) {
+            render_shape(target, list.shapes[cmd.point + i], tile);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+//---------------------------------------------------------------------------
+// 分块渲染
+//---------------------------------------------------------------------------
+
+/* 分块渲染任务
+ * 每个分块按顺序执行和它相交的命令，不同的分块互不影响，可以并行执行。
+ */
+struct tile_job
+{
+    const vgSurface* target;
+    const display_list* list;
+    const std::vector< std::vector<uint32_t> >* bins; // 每个分块的命令序号
+    std::vector<rasterizer>* rasterizers;              // 每个线程一个光栅化器
+    int columns;
+    int size;
+
+    static void render(void* param, int task, int worker)
+    {
+        const tile_job* job = static_cast<const tile_job*>(param);
+        const std::vector<uint32_t>& bin = (*job->bins)[task];
+        if (bin.empty()) {
+            return;
+        }
+
+        int x = (task % job->columns) * job->size;
+        int y = (task / job->columns) * job->size;
+        irect tile(x, y, x + job->size, y + job->size);
+
+        rasterizer& ras = (*job->rasterizers)[worker];
+        for (size_t i = 0; i < bin.size(); ++i) {
+            const uint32_t n = bin[i];
+            if (n & SHAPE_ITEM) {
+                render_shape(*job->target, job->list->shapes[n & ITEM_INDEX], tile);
+                continue;
+            }
+            const command& cmd = (n & BATCH_ITEM) ? job->list->batch[n & ITEM_INDEX] : job->list->commands[n];
+            execute(*job->target, *job->list, cmd, tile, ras);
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+// 描边
+//---------------------------------------------------------------------------
+
+// 多边形集合
+struct polygons
+{
+    std::vector<vec2f> points;
+    std::vector<uint32_t> contours; // 每个多边形的顶点数量
+
+    void clear()
+    {
+        points.clear();
+        contours.clear();
+    }
+};
+
+// 描边样式
+struct stroke_style
+{
+    float width;                // 线宽
+    int join;                   // 拐角样式
+    int cap;                    // 线帽样式
+    float miter_limit;          // 尖角长度限制（线宽的倍数），超过使用斜角
+    std::vector<float> dash;    // 虚线的线段和间隔长度（线宽的倍数），为空是实线
+
+    stroke_style() : width(1.0f), join(VG_JOIN_MITER), cap(VG_CAP_FLAT), miter_limit(10.0f) { }
+
+    bool operator==(const stroke_style& other) const
+    {
+        return width == other.width && join == other.join && cap == other.cap &&
+            miter_limit == other.miter_limit && dash == other.dash;
+    }
+
+    /* 线宽的一半，变换以后最小绘制 1 像素
+     * scale            变换的缩放系数
+     */
+    float half_width(float scale = 1.0f) const
+    {
+        return (scale > 0.0f ? std::max(width, 1.0f / scale) : width) * 0.5f;
+    }
+
+    // 描边超出中心线的最大距离，包括尖角和方形线帽（线宽一半的 sqrt(2) 倍）
+    float extent(float scale = 1.0f) const
+    {
+        return this->half_width(scale) * (join == VG_JOIN_MITER ? std::max(miter_limit, 1.5f) : 1.5f);
+    }
+
+    // 实线、平头的线段可以直接生成四边形
+    bool simple() const
+    {
+        return cap == VG_CAP_FLAT && dash.empty();
+    }
+
+    // 变换以后不超过 1 像素的实线，不需要描边，直接画细线
+    bool hairline(float scale = 1.0f) const
+    {
+        return width * scale <= 1.0f && dash.empty();
+    }
+};
+
+/* 描边：把折线转换成多边形
+ * 线段、拐角、线帽分别生成凸多边形，环绕方向相同，使用非零规则填充得到它们的并集。
+ * 虚线沿着长度切分折线，每一段按照没有闭合的折线描边。
+ */
+class stroker
+{
+private:
+    std::vector<vec2f> m_line;  // 去掉重复顶点的折线
+    std::vector<vec2f> m_dash;  // 虚线的一段
+    std::vector<float> m_pattern;
+    std::vector<vec2f> m_temp;
+
+public:
+    /* 描边折线，结果添加到 out
+     * scale            变换的缩放系数，细线按变换以后 1 像素的宽度描边
+     */
+    void stroke(const stroke_style& style, const vec2f* points, size_t size, bool closed, polygons& out, float scale = 1.0f)
+    {
+        using namespace std;
+
+        const float w = max(style.width, 1.0f);
+        float period  = 0.0f;
+        m_pattern.resize(style.dash.size());
+        for (size_t i = 0; i < style.dash.size(); ++i) {
+            m_pattern[i] = max(style.dash[i], 0.0f) * w;
+            period += m_pattern[i];
+        }
+
+        // 周期太短的虚线按实线绘制
+        if (period < 0.5f || !(period < FLT_MAX)) {
+            this->stroke_solid(style, points, size, closed, out, scale);
+            return;
+        }
+
+        if (size < 2) {
+            return;
+        }
+
+        size_t index = 0;
+        float remain = m_pattern[0];
+        bool on      = true;
+        m_dash.assign(1, points[0]);
+
+        const size_t count = closed ? size : size - 1;
+        for (size_t i = 0; i < count; ++i) {
+            const vec2f& a = points[i];
+            const vec2f& b = points[(i + 1) % size];
+            const vec2f d  = b - a;
+            const float len = length(d);
+            float t = 0.0f;
+            while (len - t > remain) {
+                t += remain;
+                vec2f p = a + d * (t / len);
+                if (on) {
+                    m_dash.push_back(p);
+                    this->stroke_solid(style, &m_dash[0], m_dash.size(), false, out, scale);
+                }
+                m_dash.assign(1, p);
+                on     = !on;
+                index  = (index + 1) % m_pattern.size();
+                remain = m_pattern[index];
+            }
+            remain -= len - t;
+            if (on) {
+                m_dash.push_back(b);
+            }
+        }
+        if (on) {
+            this->stroke_solid(style, &m_dash[0], m_dash.size(), false, out, scale);
+        }
+    }
+
+private:
+    void stroke_solid(const stroke_style& style, const vec2f* points, size_t size, bool closed, polygons& out, float scale)
+    {
+        // 去掉重复的顶点
+        m_line.clear();
+        for (size_t i = 0; i < size; ++i) {
+            if (m_line.empty() || !is_zero(length(points[i] - m_line.back()))) {
+                m_line.push_back(points[i]);
+            }
+        }
+        if (closed && m_line.size() > 2 && is_zero(length(m_line.back() - m_line[0]))) {
+            m_line.pop_back();
+        }
+
+        const size_t n = m_line.size();
+        if (n < 2) {
+            return;
+        }
+        if (n < 3) {
+            closed = false;
+        }
+
+        const float hw = style.half_width(scale);
+        const vec2f* p = &m_line[0];
+
+        const size_t count = closed ? n : n - 1;
+        for (size_t i = 0; i < count; ++i) {
+            this->add_segment(p[i], p[(i + 1) % n], hw, out);
+        }
+
+        for (size_t i = closed ? 0 : 1; i < count; ++i) {
+            this->add_join(style, p[(i + n - 1) % n], p[i], p[(i + 1) % n], hw, out);
+        }
+
+        if (!closed && style.cap != VG_CAP_FLAT) {
+            this->add_cap(style.cap, p[0], normalize(p[0] - p[1]), hw, out);
+            this->add_cap(style.cap, p[n - 1], normalize(p[n - 1] - p[n - 2]), hw, out);
+        }
+    }
+
+    // 添加一个凸多边形，统一成负的有向面积（和画布的线段四边形相同）
+    static void emit(const vec2f* p, size_t size, polygons& out)
+    {
+        float area = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            const vec2f& a = p[i];
+            const vec2f& b = p[(i + 1) % size];
+            area += a.x * b.y - b.x * a.y;
+        }
+        if (area > 0.0f) {
+            out.points.insert(out.points.end(), std::reverse_iterator<const vec2f*>(p + size), std::reverse_iterator<const vec2f*>(p));
+        }
+        else {
+            out.points.insert(out.points.end(), p, p + size);
+        }
+        out.contours.push_back(static_cast<uint32_t>(size));
+    }
+
+    static void add_segment(const vec2f& p1, const vec2f& p2, float hw, polygons& out)
+    {
+        vec2f d = normalize(p2 - p1) * hw;
+        vec2f p[4] = {
+            vec2f(p1.x - d.y, p1.y + d.x),
+            vec2f(p2.x - d.y, p2.y + d.x),
+            vec2f(p2.x + d.y, p2.y - d.x),
+            vec2f(p1.x + d.y, p1.y - d.x)
+        };
+        emit(p, 4, out);
+    }
+
+    void add_join(const stroke_style& style, const vec2f& p0, const vec2f& p1, const vec2f& p2, float hw, polygons& out)
+    {
+        using namespace std;
+
+        vec2f d1 = normalize(p1 - p0);
+        vec2f d2 = normalize(p2 - p1);
+        float cross = d1.x * d2.y - d1.y * d2.x;
+        float dot   = d1.x * d2.x + d1.y * d2.y;
+        if (fabs(cross) < 1e-6f && dot > 0.0f) {
+            return;
+        }
+
+        // 拐角外侧的两个端点
+        float s = cross > 0.0f ? hw : -hw;
+        vec2f a(p1.x + d1.y * s, p1.y - d1.x * s);
+        vec2f b(p1.x + d2.y * s, p1.y - d2.x * s);
+
+        if (style.join == VG_JOIN_ROUND) {
+            vec2f u = a - p1;
+            float sweep = atan2(u.x * (b.y - p1.y) - u.y * (b.x - p1.x), u.x * (b.x - p1.x) + u.y * (b.y - p1.y));
+            int n = detail::arc_segments(hw, sweep);
+            m_temp.assign(1, p1);
+            for (int i = 0; i <= n; ++i) {
+                float t = sweep * i / n;
+                float c = cos(t);
+                float e = sin(t);
+                m_temp.push_back(vec2f(p1.x + u.x * c - u.y * e, p1.y + u.x * e + u.y * c));
+            }
+            emit(&m_temp[0], m_temp.size(), out);
+            return;
+        }
+
+        // 尖角长度和线宽的比例是 1 / cos(a)，a 是两条法线夹角的一半
+        float cosine = sqrt(max((1.0f + dot) * 0.5f, 0.0f));
+        if (style.join == VG_JOIN_MITER && cosine * style.miter_limit > 1.0f) {
+            vec2f m = normalize((a - p1) + (b - p1)) * (hw / cosine);
+            vec2f p[4] = { p1, a, p1 + m, b };
+            emit(p, 4, out);
+        }
+        else if (fabs(cross) >= 1e-6f) {
+            vec2f p[3] = { p1, a, b };
+            emit(p, 3, out);
+        }
+    }
+
+    // d 是线帽方向（指向线段外）
+    void add_cap(int cap, const vec2f& p, const vec2f& d, float hw, polygons& out)
+    {
+        using namespace std;
+
+        vec2f n(-d.y * hw, d.x * hw);
+        if (cap == VG_CAP_SQUARE) {
+            vec2f e = d * hw;
+            vec2f q[4] = { p + n, p + n + e, p - n + e, p - n };
+            emit(q, 4, out);
+        }
+        else if (cap == VG_CAP_ROUND) {
+            // 从 n 经过 d 旋转到 -n
+            int count = detail::arc_segments(hw, float(M_PI));
+            m_temp.clear();
+            for (int i = 0; i <= count; ++i) {
+                float t = float(-M_PI) * i / count;
+                float c = cos(t);
+                float e = sin(t);
+                m_temp.push_back(vec2f(p.x + n.x * c - n.y * e, p.y + n.x * e + n.y * c));
+            }
+            emit(&m_temp[0], m_temp.size(), out);
+        }
+    }
+};
+
+} // end namespace detail
+
+//---------------------------------------------------------------------------
+// 路径
+//---------------------------------------------------------------------------
+
+/* 可以重复绘制的路径
+ * 曲线展平成折线的结果缓存起来，路径没有修改、缩放变化不大的时候直接使用。
+ * 角度和 GDI+ 一样使用角度制，顺时针方向。
+ */
+class vgPath
+{
+private:
+    enum
+    {
+        MOVE_TO,    // 1 个点
+        LINE_TO,    // 1 个点
+        CUBIC_TO,   // 3 个点：两个控制点、终点
+        ARC_TO,     // 3 个点：圆心、半径、(起始角度, 扫过角度)
+        CLOSE       // 没有点
+    };
+
+    std::vector<uint8_t> m_verbs;
+    std::vector<vec2f> m_points;
+    int m_rule;     // 填充规则
+    bool m_open;    // 有没有未结束的图形
+
+    // 展平缓存
+    mutable std::vector<vec2f> m_flatPoints;
+    mutable std::vector<uint32_t> m_flatContours; // 每个轮廓的顶点数量
+    mutable std::vector<uint8_t> m_flatClosed;    // 轮廓是否闭合
+    mutable float m_flatScale;                    // 缓存对应的缩放，0 表示没有缓存
+
+    // 描边缓存
+    mutable detail::polygons m_stroke;
+    mutable detail::stroke_style m_strokeStyle;
+    mutable bool m_strokeValid;
+
+public:
+    vgPath() : m_rule(VG_EVENODD), m_open(false), m_flatScale(), m_strokeValid(false) { }
+
+    // 清空路径
+    void clear()
+    {
+        m_verbs.clear();
+        m_points.clear();
+        m_open = false;
+        this->modified();
+    }
+
+    bool empty() const { return m_verbs.empty(); }
+
+    // 填充规则，和 GDI+ 一样默认使用奇偶填充
+    void fill_rule(int rule) { m_rule = rule; }
+    int fill_rule() const { return m_rule; }
+
+    // 开始一个新的图形
+    void move_to(float x, float y)
+    {
+        m_verbs.push_back(MOVE_TO);
+        m_points.push_back(vec2f(x, y));
+        m_open = true;
+        this->modified();
+    }
+
+    // 直线，没有开始的图形时等同于 move_to
+    void line_to(float x, float y)
+    {
+        if (!m_open) {
+            this->move_to(x, y);
+            return;
+        }
+        m_verbs.push_back(LINE_TO);
+        m_points.push_back(vec2f(x, y));
+        this->modified();
+    }
+
+    // 三次贝塞尔曲线，没有开始的图形时从第一个控制点开始
+    void bezier_to(float x1, float y1, float x2, float y2, float x3, float y3)
+    {
+        if (!m_open) {
+            this->move_to(x1, y1);
+        }
+        m_verbs.push_back(CUBIC_TO);
+        m_points.push_back(vec2f(x1, y1));
+        m_points.push_back(vec2f(x2, y2));
+        m_points.push_back(vec2f(x3, y3));
+        this->modified();
+    }
+
+    /* 椭圆弧，和 GDI+ 的 AddArc 一样，用直线连接到当前图形
+     * ox, oy           圆心
+     * rx, ry           半径
+     * start            起始角度
+     * sweep            扫过的角度
+     */
+    void arc(float ox, float oy, float rx, float ry, float start, float sweep)
+    {
+        if (!m_open) {
+            double a = start * M_RD;
+            this->move_to(ox + rx * static_cast<float>(std::cos(a)), oy + ry * static_cast<float>(std::sin(a)));
+        }
+        m_verbs.push_back(ARC_TO);
+        m_points.push_back(vec2f(ox, oy));
+        m_points.push_back(vec2f(rx, ry));
+        m_points.push_back(vec2f(start, sweep));
+        m_open = true;
+        this->modified();
+    }
+
+    // 闭合当前图形
+    void close()
+    {
+        if (m_open) {
+            m_verbs.push_back(CLOSE);
+            m_open = false;
+            this->modified();
+        }
+    }
+
+    // 添加矩形
+    void add_rect(float x, float y, float width, float height)
+    {
+        this->move_to(x, y);
+        this->line_to(x + width, y);
+        this->line_to(x + width, y + height);
+        this->line_to(x, y + height);
+        this->close();
+    }
+
+    // 添加圆角矩形，cx, cy 是圆角半径
+    void add_roundrect(float x, float y, float width, float height, float cx, float cy)
+    {
+        using namespace std;
+
+        cx = min(cx, width * 0.5f);
+        cy = min(cy, height * 0.5f);
+        if (cx <= 0.0f || cy <= 0.0f) {
+            this->add_rect(x, y, width, height);
+            return;
+        }
+
+        m_open = false;
+        this->arc(x + cx, y + cy, cx, cy, 180.0f, 90.0f);
+        this->arc(x + width - cx, y + cy, cx, cy, 270.0f, 90.0f);
+        this->arc(x + width - cx, y + height - cy, cx, cy, 0.0f, 90.0f);
+        this->arc(x + cx, y + height - cy, cx, cy, 90.0f, 90.0f);
+        this->close();
+    }
+
+    // 添加椭圆
+    void add_ellipse(float ox, float oy, float rx, float ry)
+    {
+        m_open = false;
+        this->arc(ox, oy, rx, ry, 0.0f, 360.0f);
+        this->close();
+    }
+
+    // 保守的包围盒：贝塞尔曲线使用控制点，圆弧使用整个椭圆的范围
+    AABB bounds() const
+    {
+        using namespace std;
+
+        AABB box;
+        const vec2f* p = m_points.empty() ? NULL : &m_points[0];
+        for (size_t i = 0; i < m_verbs.size(); ++i) {
+            switch (m_verbs[i]) {
+            case MOVE_TO:
+            case LINE_TO:
+                box.append(*p++);
+                break;
+            case CUBIC_TO:
+                box.append(p[0]);
+                box.append(p[1]);
+                box.append(p[2]);
+                p += 3;
+                break;
+            case ARC_TO:
+                box.append(p[0].x - fabs(p[1].x), p[0].y - fabs(p[1].y));
+                box.append(p[0].x + fabs(p[1].x), p[0].y + fabs(p[1].y));
+                p += 3;
+                break;
+            default:
+                break;
+            }
+        }
+        return box;
+    }
+
+    /* 展平成折线
+     * scale            绘制时的缩放，决定曲线的分段数量
+     * 结果缓存到下次修改路径。缓存的精度足够（缩放不超过缓存的缩放，也不小于一半）的时候不重新计算。
+     */
+    void flatten(float scale = 1.0f) const
+    {
+        if (!(scale > 0.0f)) {
+            scale = 1.0f;
+        }
+        if (m_flatScale >= scale && m_flatScale < scale * 2.0f) {
+            return;
+        }
+
+        m_flatPoints.clear();
+        m_flatContours.clear();
+        m_flatClosed.clear();
+
+        const float tolerance = 0.125f / scale;
+        size_t first = 0; // 当前轮廓的第一个顶点
+        const vec2f* p = m_points.empty() ? NULL : &m_points[0];
+        for (size_t i = 0; i < m_verbs.size(); ++i) {
+            switch (m_verbs[i]) {
+            case MOVE_TO:
+                this->end_contour(first, false);
+                m_flatPoints.push_back(*p++);
+                break;
+            case LINE_TO:
+                m_flatPoints.push_back(*p++);
+                break;
+            case CUBIC_TO:
+                this->flatten_cubic(m_flatPoints.back(), p[0], p[1], p[2], tolerance);
+                p += 3;
+                break;
+            case ARC_TO:
+                this->flatten_arc(p[0], p[1], p[2].x, p[2].y, scale);
+                p += 3;
+                break;
+            case CLOSE:
+                this->end_contour(first, true);
+                break;
+            default:
+                break;
+            }
+        }
+        this->end_contour(first, false);
+        m_flatScale   = scale;
+        m_strokeValid = false;
+    }
+
+    /* 描边生成的多边形
+     * 结果缓存到下次修改路径，或者描边样式、缩放改变
+     */
+    const detail::polygons& stroke(const detail::stroke_style& style, float scale = 1.0f) const
+    {
+        this->flatten(scale);
+        if (m_strokeValid && m_strokeStyle == style) {
+            return m_stroke;
+        }
+
+        m_stroke.clear();
+        detail::stroker stroker;
+        size_t first = 0;
+        for (size_t i = 0; i < m_flatContours.size(); ++i) {
+            stroker.stroke(style, &m_flatPoints[first], m_flatContours[i], m_flatClosed[i] != 0, m_stroke, scale);
+            first += m_flatContours[i];
+        }
+        m_strokeStyle = style;
+        m_strokeValid = true;
+        return m_stroke;
+    }
+
+    // 展平的顶点，先调用 flatten()
+    const std::vector<vec2f>& flat_points() const { return m_flatPoints; }
+
+    // 展平的每个轮廓的顶点数量
+    const std::vector<uint32_t>& flat_contours() const { return m_flatContours; }
+
+    // 展平的每个轮廓是否闭合
+    const std::vector<uint8_t>& flat_closed() const { return m_flatClosed; }
+
+private:
+    void modified()
+    {
+        m_flatScale = 0.0f;
+    }
+
+    // 结束当前轮廓，少于两个顶点的轮廓丢弃
+    void end_contour(size_t& first, bool closed) const
+    {
+        size_t n = m_flatPoints.size() - first;
+        if (n >= 2) {
+            m_flatContours.push_back(static_cast<uint32_t>(n));
+            m_flatClosed.push_back(closed);
+        }
+        else {
+            m_flatPoints.resize(first);
+        }
+        first = m_flatPoints.size();
+    }
+
+    // 分段数量：控制多边形的二阶差分 L，误差不超过 L * 3 / (4 * n * n)
+    void flatten_cubic(vec2f p0, const vec2f& p1, const vec2f& p2, const vec2f& p3, float tolerance) const
+    {
+        using namespace std;
+
+        float d1 = length(p0 - p1 * 2.0f + p2);
+        float d2 = length(p1 - p2 * 2.0f + p3);
+        float n  = ceil(sqrt(max(d1, d2) * 0.75f / tolerance));
+        int count = n < 1.0f ? 1 : (n > 1000.0f ? 1000 : int(n));
+
+        for (int i = 1; i < count; ++i) {
+            float t  = float(i) / count;
+            float s  = 1.0f - t;
+            float a  = s * s * s;
+            float b  = 3.0f * s * s * t;
+            float c  = 3.0f * s * t * t;
+            float d  = t * t * t;
+            m_flatPoints.push_back(vec2f(
+                a * p0.x + b * p1.x + c * p2.x + d * p3.x,
+                a * p0.y + b * p1.y + c * p2.y + d * p3.y
+            ));
+        }
+        m_flatPoints.push_back(p3);
+    }
+
+    // 第一个点用直线和当前图形连接
+    void flatten_arc(const vec2f& o, const vec2f& r, float start, float sweep, float scale) const
+    {
+        using namespace std;
+
+        int n       = detail::arc_segments(max(r.x, r.y) * scale, static_cast<float>(sweep * M_RD));
+        double step = sweep * M_RD / n;
+        double a    = start * M_RD;
+        for (int i = 0; i <= n; ++i) {
+            double t = a + step * i;
+            vec2f v(o.x + r.x * static_cast<float>(cos(t)), o.y + r.y * static_cast<float>(sin(t)));
+            if (i > 0 || m_flatPoints.back().x != v.x || m_flatPoints.back().y != v.y) {
+                m_flatPoints.push_back(v);
+            }
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+// 渐变
+//---------------------------------------------------------------------------
+
+/* 多个颜色节点的渐变
+ * 颜色节点在使用的时候烘焙成 RAMP_SIZE 个颜色的预乘颜色表，节点没有修改的时候直接使用。
+ * 节点之间按预乘颜色插值，渐变到透明的时候边缘不会发暗。
+ * 坐标和角度使用绘图坐标，角度和 GDI+ 一样使用角度制，顺时针方向。
+ */
+class vgGradient
+{
+public:
+    enum { RAMP_SIZE = detail::RAMP_SIZE };
+
+    // 颜色节点
+    struct stop
+    {
+        float offset;   // 位置 0.0 - 1.0
+        vec4ub color;   // 颜色（没有预乘）
+    };
+
+private:
+    int m_type;             // 渐变类型
+    int m_spread;           // 扩展方式
+    vec2f m_start, m_end;   // 线性渐变的起点和终点
+    vec2f m_center;         // 径向、锥形渐变的圆心
+    float m_radius;         // 径向渐变的半径
+    float m_angle;          // 锥形渐变的起始角度
+    std::vector<stop> m_stops;
+
+    // 颜色表缓存
+    mutable std::vector<vgPixel> m_ramp;
+    mutable bool m_rampValid;
+
+public:
+    vgGradient() :
+        m_type(VG_GRADIENT_LINEAR), m_spread(VG_SPREAD_PAD), m_start(), m_end(1.0f, 0.0f), m_center(),
+        m_radius(1.0f), m_angle(), m_rampValid(false) { }
+
+    // 线性渐变，从 (x1, y1) 到 (x2, y2)
+    void linear(float x1, float y1, float x2, float y2)
+    {
+        m_type  = VG_GRADIENT_LINEAR;
+        m_start = vec2f(x1, y1);
+        m_end   = vec2f(x2, y2);
+    }
+
+    // 径向渐变，圆心 (ox, oy)，半径 radius
+    void radial(float ox, float oy, float radius)
+    {
+        m_type   = VG_GRADIENT_RADIAL;
+        m_center = vec2f(ox, oy);
+        m_radius = radius;
+    }
+
+    // 锥形渐变，绕圆心 (ox, oy) 顺时针一周，angle 是起始角度
+    void conic(float ox, float oy, float angle = 0.0f)
+    {
+        m_type   = VG_GRADIENT_CONIC;
+        m_center = vec2f(ox, oy);
+        m_angle  = angle;
+    }
+
+    int type() const { return m_type; }
+    const vec2f& start() const { return m_start; }
+    const vec2f& end() const { return m_end; }
+    const vec2f& center() const { return m_center; }
+    float radius() const { return m_radius; }
+    float angle() const { return m_angle; }
+
+    // 扩展方式 vgGradientSpread，默认 VG_SPREAD_PAD
+    void spread(int mode) { m_spread = mode; }
+    int spread() const { return m_spread; }
+
+    // 添加颜色节点，位置相同的节点按添加的顺序排列，可以做出硬边
+    void add_stop(float offset, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+    {
+        stop s;
+        s.offset  = offset > 0.0f ? std::min(offset, 1.0f) : 0.0f;
+        s.color.r = r;
+        s.color.g = g;
+        s.color.b = b;
+        s.color.a = a;
+
+        std::vector<stop>::iterator itr = m_stops.end();
+        while (itr != m_stops.begin() && (itr - 1)->offset > s.offset) {
+            --itr;
+        }
+        m_stops.insert(itr, s);
+        m_rampValid = false;
+    }
+
+    void clear_stops()
+    {
+        m_stops.clear();
+        m_rampValid = false;
+    }
+
+    const std::vector<stop>& stops() const { return m_stops; }
+
+    // 绘图坐标到渐变坐标 (u, v) 的矩阵，参数不能计算的时候所有像素使用同一个位置
+    vgMatrix matrix() const
+    {
+        using namespace std;
+
+        switch (m_type) {
+        case VG_GRADIENT_RADIAL: {
+            if (!(m_radius > 0.0f)) {
+                return vgMatrix(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+            }
+            float k = 1.0f / m_radius;
+            return vgMatrix(k, 0.0f, 0.0f, k, -m_center.x * k, -m_center.y * k);
+        }
+        case VG_GRADIENT_CONIC: {
+            float cosine = static_cast<float>(cos(m_angle * M_RD));
+            float sine   = static_cast<float>(sin(m_angle * M_RD));
+            return vgMatrix(cosine, -sine, sine, cosine,
+                -(cosine * m_center.x + sine * m_center.y), sine * m_center.x - cosine * m_center.y);
+        }
+        default: {
+            float dx = m_end.x - m_start.x;
+            float dy = m_end.y - m_start.y;
+            float d  = dx * dx + dy * dy;
+            if (!(d > 0.0f)) {
+                return vgMatrix(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+            }
+            dx /= d;
+            dy /= d;
+            return vgMatrix(dx, 0.0f, dy, 0.0f, -(dx * m_start.x + dy * m_start.y), 0.0f);
+        }
+        }
+    }
+
+    // 预乘颜色表，第 i 个颜色是位置 (i + 0.5) / RAMP_SIZE 的颜色，没有节点的时候全部透明
+    const vgPixel* ramp() const
+    {
+        if (!m_rampValid) {
+            this->bake();
+            m_rampValid = true;
+        }
+        return &m_ramp[0];
+    }
+
+private:
+    void bake() const
+    {
+        m_ramp.assign(RAMP_SIZE, 0);
+        if (m_stops.empty()) {
+            return;
+        }
+
+        size_t k = 0; // 第一个位置大于 t 的节点
+        for (int i = 0; i < RAMP_SIZE; ++i) {
+            float t = (float(i) + 0.5f) / float(RAMP_SIZE);
+            while (k < m_stops.size() && m_stops[k].offset <= t) {
+                ++k;
+            }
+            if (k == 0 || k == m_stops.size()) {
+                m_ramp[i] = detail::premultiply(m_stops[k ? k - 1 : 0].color);
+                continue;
+            }
+
+            const stop& s0 = m_stops[k - 1];
+            const stop& s1 = m_stops[k];
+            float w  = (t - s0.offset) / (s1.offset - s0.offset);
+            float a0 = s0.color.a * (1.0f - w);
+            float a1 = s1.color.a * w;
+            float r  = (s0.color.r * a0 + s1.color.r * a1) / 255.0f;
+            float g  = (s0.color.g * a0 + s1.color.g * a1) / 255.0f;
+            float b  = (s0.color.b * a0 + s1.color.b * a1) / 255.0f;
+            // 舍入误差不能让颜色分量超过 alpha
+            vgPixel a = vgPixel(a0 + a1 + 0.5f);
+            m_ramp[i] = (a << 24) | (std::min(vgPixel(r + 0.5f), a) << 16) | (std::min(vgPixel(g + 0.5f), a) << 8) | std::min(vgPixel(b + 0.5f), a);
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+// 软件渲染画布
+//---------------------------------------------------------------------------
+
+class vgCanvas
+{
+private:
+    enum
+    {
+        ACCUMULATE_THRESHOLD = 256, // 多边形顶点数达到这个值，使用累加缓冲区
+        TILE_SIZE = 64,             // 多线程渲染的分块大小
+        LINE_BATCH = 64             // 批量绘制细线，每个命令的线段数量
+    };
+
+    // 变换的类型，轴对齐的变换可以使用矩形、椭圆和图片的快速路径
+    enum
+    {
+        TRANSFORM_IDENTITY,         // 单位矩阵
+        TRANSFORM_TRANSLATE,        // 只有平移
+        TRANSFORM_AXIS,             // 轴对齐：缩放、镜像和 90 度倍数的旋转
+        TRANSFORM_AFFINE            // 任意仿射变换
+    };
+
+    vgSurface m_target;         // 绘图目标
+    detail::irect m_clip;       // 剪裁矩形（设备坐标，不受变换影响）
+    vgMatrix m_transform;       // 当前变换，绘图坐标到设备坐标
+    int m_transformKind;        // 当前变换的类型
+    std::vector<vgMatrix> m_transforms; // 变换栈，每一级保存合成以后的矩阵，弹出的时候直接恢复
+    int m_effectLevel;          // 效果等级
+    int m_filter;               // 图片缩放滤波器
+    int m_blend;                // 混合模式
+    vgPixel m_penColor;         // 画笔颜色（预乘）
+    detail::stroke_style m_stroke; // 描边样式
+    vgPixel m_fillColor;        // 填充颜色（预乘）
+    vgGradient m_gradient;      // 填充渐变
+    bool m_gradientFill;        // 使用渐变填充
+    std::vector<vec2f> m_points; // 临时顶点
+    std::vector<vec2f> m_circle; // 单位圆顶点缓存
+
+    detail::display_list m_list;            // 绘图命令
+    size_t m_pointMark;                     // 当前图形的第一个顶点
+    size_t m_contourMark;                   // 当前图形的第一个轮廓
+    std::vector<detail::rasterizer> m_ras;  // 光栅化器，每个线程一个
+    std::vector< std::vector<uint32_t> > m_bins; // 每个分块的命令
+    detail::worker_pool m_pool;             // 渲染线程
+    bool m_deferred;                        // 延迟绘制
+    detail::stroker m_stroker;              // 描边
+    detail::polygons m_strokes;             // 描边生成的多边形
+    detail::damage_region m_damage;         // 脏矩形
+    bool m_tracking;                        // 跟踪脏矩形
+    bool m_offscreen;                       // 绘制到离屏目标，不记录脏矩形
+    bool m_batching;                        // 正在收集批量绘制的图元
+    size_t m_batchMark;                     // 当前批次还没有提交的第一个图元
+    size_t m_shapeMark;                     // 当前批次还没有提交的第一个简单图元
+
+public:
+    vgCanvas() :
+        m_transformKind(TRANSFORM_IDENTITY),
+        m_effectLevel(VG_MEDIUM),
+        m_filter(VG_FILTER_AUTO),
+        m_blend(VG_BLEND_NORMAL),
+        m_penColor(0xFF000000),
+        m_fillColor(0xFFFFFFFF),
+        m_gradientFill(false),
+        m_pointMark(),
+        m_contourMark(),
+        m_ras(1),
+        m_deferred(false),
+        m_tracking(false),
+        m_offscreen(false),
+        m_batching(false),
+        m_batchMark(),
+        m_shapeMark()
+    {
+    }
+
+    /* 绑定像素缓冲区，没有执行的绘图命令会被丢弃
+     * pixels           第一行像素指针
+     * width, height    缓冲区大小
+     * stride           行跨度（像素），自底向上的位图为负数
+     */
+    void bind(void* pixels, int width, int height, int stride)
+    {
+        m_list.clear();
+        m_target    = vgSurface(pixels, width, height, stride);
+        m_offscreen = false;
+        this->reset_clip();
+
+        // 新的缓冲区需要全部显示
+        m_damage.clear();
+        if (m_tracking) {
+            m_damage.add(this->bounds());
+        }
+    }
+
+    /* 切换绘图目标，之前目标上记录的命令先执行，变换和绘图设置保留，剪裁重置为整个目标
+     * offscreen        离屏目标（比如图片），绘制的时候不记录脏矩形，之前记录的脏矩形保留
+     */
+    void retarget(const vgSurface& target, bool offscreen)
+    {
+        this->flush();
+        m_target    = target;
+        m_offscreen = offscreen;
+        this->reset_clip();
+    }
+
+    // 返回绘图目标
+    const vgSurface& target() const { return m_target; }
+
+    int width() const { return m_target.width; }
+    int height() const { return m_target.height; }
+
+    /* 设置渲染线程数量
+     * count 大于 1 的时候，绘图命令先记录下来，flush() 的时候分成 64x64 的块多线程绘制。
+     * 每一块按照命令顺序绘制，结果和单线程绘制完全相同。
+     * 记录期间使用的图片，在 flush() 之前不能释放。
+     */
+    void threads(int count)
+    {
+        this->flush();
+        m_pool.resize(count);
+        m_ras.resize(m_pool.size());
+    }
+
+    int threads() const { return m_pool.size(); }
+
+    /* 设置延迟绘制
+     * 开启之后，绘图命令先记录下来，flush() 的时候整理之后再绘制：
+     * 删除被后面的清屏、不透明矩形完全覆盖的命令，合并相邻的同色矩形。
+     * 记录期间使用的图片，在 flush() 之前不能释放。
+     */
+    void deferred(bool enable)
+    {
+        if (!enable) {
+            this->flush();
+        }
+        m_deferred = enable;
+    }
+
+    bool deferred() const { return m_deferred; }
+
+    /* 开启脏矩形跟踪（默认关闭）
+     * 每个绘图命令影响的像素范围（剪裁以后）合并到脏矩形里面，
+     * 显示的时候只需要复制这些区域，复制完以后调用 clear_damage()。
+     */
+    void damage_tracking(bool enable)
+    {
+        m_tracking = enable;
+        m_damage.clear();
+        if (enable) {
+            m_damage.add(this->bounds());
+        }
+    }
+
+    bool damage_tracking() const { return m_tracking; }
+
+    // 标记改变的区域，直接修改像素或者使用其他方式绘制的时候调用
+    void invalidate(int x, int y, int width, int height)
+    {
+        if (m_tracking && !m_offscreen) {
+            m_damage.add(detail::irect(x, y, x + width, y + height).intersect(this->bounds()));
+        }
+    }
+
+    // 脏矩形数量
+    size_t damage_count() const { return m_damage.rects().size(); }
+
+    // 返回一个脏矩形
+    vgRect damage_rect(size_t index) const
+    {
+        const detail::irect& r = m_damage.rects()[index];
+        return vgRect(float(r.x1), float(r.y1), float(r.width()), float(r.height()));
+    }
+
+    // 清空脏矩形，开始新的一帧
+    void clear_damage()
+    {
+        m_damage.clear();
+    }
+
+    // 执行记录的绘图命令
+    void flush()
+    {
+        if (!m_list.empty()) {
+            if (m_list.commands.size() > 1) {
+                m_list.optimize(this->bounds());
+            }
+
+            if (m_pool.size() > 1) {
+                this->render_tiles();
+            }
+            else {
+                for (size_t i = 0; i < m_list.commands.size(); ++i) {
+                    detail::execute(m_target, m_list, m_list.commands[i], this->bounds(), m_ras[0]);
+                }
+            }
+        }
+        m_list.clear();
+    }
+
+    // 设置显示质量
+    void effect_level(int level) { m_effectLevel = level; }
+    int effect_level() const { return m_effectLevel; }
+
+    /* 设置图片缩放滤波器 vgImageFilter
+     * VG_FILTER_AUTO 按显示质量逐像素采样。其他滤波器在轴对齐缩放绘制的时候，
+     * 记录命令时先用可分离滤波器把图片缩放到目标大小，再按行混合，目标范围对齐到像素。
+     */
+    void image_filter(int filter)
+    {
+        m_filter = (filter >= VG_FILTER_AUTO && filter <= VG_FILTER_LANCZOS) ? filter : VG_FILTER_AUTO;
+    }
+
+    int image_filter() const { return m_filter; }
+
+    /* 缩放整张图片，dst 的全部像素都会写入，使用渲染线程
+     * filter           vgImageFilter，VG_FILTER_AUTO 使用双三次插值
+     */
+    void resample(const vgSurface& dst, const vgSurface& src, int filter)
+    {
+        if (dst.empty() || src.empty()) {
+            return;
+        }
+        if (filter < VG_FILTER_NEAREST || filter > VG_FILTER_LANCZOS) {
+            filter = VG_FILTER_BICUBIC;
+        }
+        const double sx = double(src.width) / dst.width;
+        const double sy = double(src.height) / dst.height;
+        detail::resample(dst, src, detail::irect(0, 0, src.width, src.height), filter,
+            0.5 * sx, sx, 0.5 * sy, sy, &m_pool);
+    }
+
+    /* 合成图层，按顺序混合到剪裁范围里面，使用渲染线程
+     * 图层位置是设备坐标，不受变换和混合模式影响
+     */
+    void composite(const detail::layer_source* layers, size_t count)
+    {
+        this->flush();
+        if (m_target.empty() || m_clip.empty() || !count) {
+            return;
+        }
+
+        // 图层位置转换到剪裁范围里面
+        std::vector<detail::layer_source> list(layers, layers + count);
+        for (size_t i = 0; i < list.size(); ++i) {
+            detail::layer_source& layer = list[i];
+            this->invalidate(layer.x, layer.y, layer.pixels.width, layer.pixels.height);
+            layer.x -= m_clip.x1;
+            layer.y -= m_clip.y1;
+        }
+        vgSurface dst = m_target.crop(m_clip.x1, m_clip.y1, m_clip.width(), m_clip.height());
+        detail::composite_layers(dst, &list[0], list.size(), &m_pool);
+    }
+
+    // 设置混合模式 vgBlendMode，影响之后的绘图命令，clear() 不受影响
+    void blend_mode(int mode)
+    {
+        m_blend = (mode >= 0 && mode < VG_BLEND_COUNT) ? mode : VG_BLEND_NORMAL;
+    }
+
+    int blend_mode() const { return m_blend; }
+
+    // 画笔
+    void pen_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+    {
+        m_penColor = detail::premultiply(r, g, b, a);
+    }
+
+    void pen_width(float width) { m_stroke.width = width; }
+    float pen_width() const { return m_stroke.width; }
+
+    // 拐角样式 vgLineJoin
+    void line_join(int join) { m_stroke.join = join; }
+    int line_join() const { return m_stroke.join; }
+
+    // 线帽样式 vgLineCap
+    void line_cap(int cap) { m_stroke.cap = cap; }
+    int line_cap() const { return m_stroke.cap; }
+
+    // 尖角长度限制（线宽的倍数）
+    void miter_limit(float limit) { m_stroke.miter_limit = limit; }
+
+    // 描边超出中心线的最大距离，用来计算图形的包围盒
+    float stroke_extent() const { return m_stroke.extent(this->transform_scale()); }
+
+    // 变换的最大缩放，用来计算曲线的分段数量和 GDI+ 绘制图片的 mipmap 级别
+    float transform_scale() const
+    {
+        using namespace std;
+
+        if (m_transformKind <= TRANSFORM_TRANSLATE) {
+            return 1.0f;
+        }
+        const vgMatrix& m = m_transform;
+        return sqrt(max(m.a * m.a + m.b * m.b, m.c * m.c + m.d * m.d));
+    }
+
+    /* 设置虚线
+     * dash             线段和间隔的长度（线宽的倍数），为空或者 size 为 0 是实线
+     */
+    void dash_pattern(const float* dash, size_t size)
+    {
+        if (dash) {
+            m_stroke.dash.assign(dash, dash + size);
+        }
+        else {
+            m_stroke.dash.clear();
+        }
+    }
+
+    // 填充颜色，取消渐变填充
+    void fill_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+    {
+        m_fillColor    = detail::premultiply(r, g, b, a);
+        m_gradientFill = false;
+    }
+
+    // 使用渐变填充，保存渐变的副本，之后修改 gradient 不影响填充
+    void fill_gradient(const vgGradient& gradient)
+    {
+        m_gradient     = gradient;
+        m_gradientFill = true;
+    }
+
+    bool gradient_fill() const { return m_gradientFill; }
+
+    // 设置剪裁矩形
+    void cliprect(int x, int y, int width, int height)
+    {
+        this->cliprect(detail::irect(x, y, x + width, y + height));
+    }
+
+    // 设置剪裁矩形，和缓冲区求交集，空的剪裁统一为空矩形
+    void cliprect(const detail::irect& rect)
+    {
+        m_clip = rect.intersect(this->bounds());
+        if (m_clip.empty()) {
+            m_clip = detail::irect();
+        }
+    }
+
+    // 取消剪裁
+    void reset_clip()
+    {
+        m_clip = this->bounds();
+    }
+
+    // 返回剪裁矩形
+    vgRect cliprect() const
+    {
+        return vgRect(float(m_clip.x1), float(m_clip.y1), float(m_clip.width()), float(m_clip.height()));
+    }
+
+    // 返回整数剪裁矩形，扫描线直接使用
+    const detail::irect& clip() const { return m_clip; }
+
+    /* 设置变换，影响之后的图形、图片和精灵，剪裁矩形和 clear() 不受影响
+     * m                绘图坐标到设备坐标的变换
+     */
+    void transform(const vgMatrix& m)
+    {
+        m_transform = m;
+        this->update_transform();
+    }
+
+    // 返回当前变换
+    const vgMatrix& transform() const { return m_transform; }
+
+    // 在当前变换之前应用 m（和 Gdiplus::Matrix 的 MatrixOrderPrepend 一样）
+    void concat_transform(const vgMatrix& m)
+    {
+        m_transform = m_transform * m;
+        this->update_transform();
+    }
+
+    // 重置为单位矩阵，不影响变换栈
+    void reset_transform()
+    {
+        m_transform = vgMatrix();
+        m_transformKind = TRANSFORM_IDENTITY;
+    }
+
+    // 保存当前变换
+    void push_transform()
+    {
+        m_transforms.push_back(m_transform);
+    }
+
+    // 恢复上一次保存的变换，栈为空的时候重置为单位矩阵
+    void pop_transform()
+    {
+        if (m_transforms.empty()) {
+            this->reset_transform();
+            return;
+        }
+        m_transform = m_transforms.back();
+        m_transforms.pop_back();
+        this->update_transform();
+    }
+
+    // 变换栈的深度
+    size_t transform_depth() const { return m_transforms.size(); }
+
+    // 交换变换栈，切换绘图目标的时候保存和恢复之前的栈
+    void swap_transforms(std::vector<vgMatrix>& transforms) { m_transforms.swap(transforms); }
+
+    // 平移
+    void translate(float x, float y)
+    {
+        m_transform.translate(x, y);
+        this->update_transform();
+    }
+
+    // 旋转（角度，顺时针），90 度的倍数保持轴对齐
+    void rotate(float angle)
+    {
+        m_transform.rotate(angle);
+        this->update_transform();
+    }
+
+    // 缩放
+    void scale(float x, float y)
+    {
+        m_transform.scale(x, y);
+        this->update_transform();
+    }
+
+    // 清屏（剪裁区域）
+    void clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+    {
+        detail::command cmd = detail::command();
+        cmd.type   = detail::CMD_CLEAR;
+        cmd.bounds = m_clip;
+        cmd.color  = detail::premultiply(r, g, b, a);
+        this->submit(cmd);
+    }
+
+    // 绘制一个点（画笔颜色的实心圆）
+    void draw_point(float x, float y, float size)
+    {
+        float r = size * 0.5f;
+        this->fill_ellipse(x, y, r, r, 0.0f, 0.0f, m_penColor);
+    }
+
+    // 绘制线段
+    void draw_line(float x1, float y1, float x2, float y2)
+    {
+        vec2f p[2] = { vec2f(x1, y1), vec2f(x2, y2) };
+        this->begin();
+        if (this->thin_stroke()) {
+            this->add_hairline(p, 2);
+            this->hairline(m_penColor, false);
+            return;
+        }
+        if (m_stroke.simple()) {
+            this->add_segment(p[0], p[1], this->half_width());
+        }
+        else {
+            this->add_stroke(p, 2, false);
+        }
+        this->fill(m_penColor, VG_NONZERO);
+    }
+
+    // 绘制空心矩形
+    void draw_rect(float x, float y, float width, float height)
+    {
+        if (this->thin_stroke()) {
+            vec2f p[4] = { vec2f(x, y), vec2f(x + width, y), vec2f(x + width, y + height), vec2f(x, y + height) };
+            this->begin();
+            this->add_hairline(p, 4);
+            this->hairline(m_penColor, true);
+            return;
+        }
+        if (!m_stroke.dash.empty()) {
+            vec2f p[4] = { vec2f(x, y), vec2f(x + width, y), vec2f(x + width, y + height), vec2f(x, y + height) };
+            this->begin();
+            this->add_stroke(p, 4, true);
+            this->fill(m_penColor, VG_NONZERO);
+            return;
+        }
+
+        float hw = this->half_width();
+        this->begin();
+        this->add_rect(x - hw, y - hw, width + hw * 2.0f, height + hw * 2.0f, false);
+        if (width > hw * 2.0f && height > hw * 2.0f) {
+            this->add_rect(x + hw, y + hw, width - hw * 2.0f, height - hw * 2.0f, true);
+        }
+        this->fill(m_penColor, VG_NONZERO);
+    }
+
+    // 填充矩形
+    void fill_rect(float x, float y, float width, float height)
+    {
+        if (m_gradientFill) {
+            this->begin();
+            this->add_rect(x, y, width, height, false);
+            this->paint(VG_NONZERO);
+            return;
+        }
+        this->fill_rect(x, y, width, height, m_fillColor);
+    }
+
+    // 绘制圆角矩形，cx, cy 是圆角半径
+    void draw_roundrect(float x, float y, float width, float height, float cx, float cy)
+    {
+        if (!m_stroke.dash.empty()) {
+            this->begin();
+            if (this->roundrect_points(x, y, width, height, cx, cy)) {
+                this->add_stroke(&m_points[0], m_points.size(), true);
+            }
+            this->fill(m_penColor, VG_NONZERO);
+            return;
+        }
+
+        float hw = this->half_width();
+        this->begin();
+        this->add_roundrect(x - hw, y - hw, width + hw * 2.0f, height + hw * 2.0f, cx + hw, cy + hw, false);
+        if (width > hw * 2.0f && height > hw * 2.0f) {
+            this->add_roundrect(x + hw, y + hw, width - hw * 2.0f, height - hw * 2.0f, cx - hw, cy - hw, true);
+        }
+        this->fill(m_penColor, VG_NONZERO);
+    }
+
+    // 填充圆角矩形
+    void fill_roundrect(float x, float y, float width, float height, float cx, float cy)
+    {
+        this->begin();
+        this->add_roundrect(x, y, width, height, cx, cy, false);
+        this->paint(VG_NONZERO);
+    }
+
+    // 绘制空心椭圆
+    void draw_ellipse(float ox, float oy, float rx, float ry)
+    {
+        if (!m_stroke.dash.empty()) {
+            this->begin();
+            if (this->ellipse_points(ox, oy, rx, ry, false)) {
+                this->add_stroke(&m_points[0], m_points.size(), true);
+            }
+            this->fill(m_penColor, VG_NONZERO);
+            return;
+        }
+
+        float hw = this->half_width();
+        if (rx > hw && ry > hw) {
+            this->fill_ellipse(ox, oy, rx + hw, ry + hw, rx - hw, ry - hw, m_penColor);
+        }
+        else {
+            this->fill_ellipse(ox, oy, rx + hw, ry + hw, 0.0f, 0.0f, m_penColor);
+        }
+    }
+
+    // 填充椭圆
+    void fill_ellipse(float ox, float oy, float rx, float ry)
+    {
+        if (m_gradientFill) {
+            this->begin();
+            this->add_ellipse(ox, oy, rx, ry, false);
+            this->paint(VG_NONZERO);
+            return;
+        }
+        this->fill_ellipse(ox, oy, rx, ry, 0.0f, 0.0f, m_fillColor);
+    }
+
+    // 绘制连续的线段
+    void draw_polyline(const vec2f* points, size_t size)
+    {
+        this->begin();
+        if (this->thin_stroke()) {
+            this->add_hairline(points, size);
+            this->hairline(m_penColor, false);
+            return;
+        }
+        this->add_stroke(points, size, false);
+        this->fill(m_penColor, VG_NONZERO);
+    }
+
+    // 绘制多边形
+    void draw_polygon(const vec2f* points, size_t size)
+    {
+        this->begin();
+        if (this->thin_stroke()) {
+            this->add_hairline(points, size);
+            this->hairline(m_penColor, true);
+            return;
+        }
+        this->add_stroke(points, size, true);
+        this->fill(m_penColor, VG_NONZERO);
+    }
+
+    // 填充多边形（和 GDI+ 一样默认使用奇偶填充）
+    void fill_polygon(const vec2f* points, size_t size, int rule = VG_EVENODD)
+    {
+        this->begin();
+        this->add_polygon(points, size);
+        this->paint(rule);
+    }
+
+    /* 批量填充矩形
+     * rects            矩形数组
+     * colors           每个矩形的颜色，为空使用填充颜色或者渐变
+     * size             矩形数量
+     */
+    void fill_rects(const vgRect* rects, const vec4ub* colors, size_t size)
+    {
+        this->begin_batch();
+        for (size_t i = 0; i < size; ++i) {
+            const vgRect& r = rects[i];
+            if (colors) {
+                this->fill_rect(r.x, r.y, r.w, r.h, detail::premultiply(colors[i]));
+            }
+            else {
+                this->fill_rect(r.x, r.y, r.w, r.h);
+            }
+        }
+        this->end_batch();
+    }
+
+    /* 批量绘制线段
+     * points           线段端点数组，每两个点一条线段
+     * size             端点数量
+     * colors           每条线段的颜色，为空使用画笔颜色
+     */
+    void draw_lines(const vec2f* points, size_t size, const vec4ub* colors = NULL)
+    {
+        this->begin_batch();
+        this->add_lines(points, size, colors);
+        this->end_batch();
+    }
+
+    /* 批量填充圆
+     * points           圆心数组
+     * radius           半径数组
+     * colors           每个圆的颜色，为空使用填充颜色或者渐变
+     * size             圆的数量
+     */
+    void fill_circles(const vec2f* points, const float* radius, const vec4ub* colors, size_t size)
+    {
+        this->begin_batch();
+        for (size_t i = 0; i < size; ++i) {
+            if (colors) {
+                this->fill_ellipse(points[i].x, points[i].y, radius[i], radius[i], 0.0f, 0.0f, detail::premultiply(colors[i]));
+            }
+            else {
+                this->fill_ellipse(points[i].x, points[i].y, radius[i], radius[i]);
+            }
+        }
+        this->end_batch();
+    }
+
+private:
+    // draw_lines 的每条线段
+    void add_lines(const vec2f* points, size_t size, const vec4ub* colors)
+    {
+        // 同一种颜色的细线，多条线段合并成一个命令
+        const bool thin = this->thin_stroke();
+        if (thin && !colors) {
+            for (size_t i = 0; i + 1 < size; ) {
+                this->begin();
+                for (size_t n = 0; n < LINE_BATCH && i + 1 < size; ++n, i += 2) {
+                    this->add_hairline(points + i, 2);
+                }
+                this->hairline(m_penColor, false);
+            }
+            return;
+        }
+
+        const float hw = this->half_width();
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            this->begin();
+            if (thin) {
+                this->add_hairline(points + i, 2);
+                this->hairline(colors ? detail::premultiply(colors[i / 2]) : m_penColor, false);
+                continue;
+            }
+            if (m_stroke.simple()) {
+                this->add_segment(points[i], points[i + 1], hw);
+            }
+            else {
+                this->add_stroke(points + i, 2, false);
+            }
+            this->fill(colors ? detail::premultiply(colors[i / 2]) : m_penColor, VG_NONZERO);
+        }
+    }
+
+public:
+
+    // 绘制路径，使用路径缓存的描边结果
+    void draw_path(const vgPath& path)
+    {
+        this->begin();
+        this->add_polygons(path.stroke(m_stroke, this->transform_scale()));
+        this->fill(m_penColor, VG_NONZERO);
+    }
+
+    // 填充路径，没有闭合的图形自动闭合
+    void fill_path(const vgPath& path)
+    {
+        path.flatten(this->transform_scale());
+        const std::vector<vec2f>& points      = path.flat_points();
+        const std::vector<uint32_t>& contours = path.flat_contours();
+
+        this->begin();
+        size_t first = 0;
+        for (size_t i = 0; i < contours.size(); ++i) {
+            this->add_polygon(&points[first], contours[i]);
+            first += contours[i];
+        }
+        this->paint(path.fill_rule());
+    }
+
+    // 绘制图片到指定范围
+    void draw_image(const vgSurface& image, float x, float y, float width, float height)
+    {
+        if (image.empty()) {
+            return;
+        }
+        vgMatrix m;
+        m.translate(x, y);
+        m.scale(width / image.width, height / image.height);
+        this->draw_image(image, vgRect(0.0f, 0.0f, float(image.width), float(image.height)), m);
+    }
+
+    /* 使用仿射矩阵绘制图片
+     * image            图片
+     * source           图片源范围
+     * m                源范围局部坐标 (0, 0) - (source.w, source.h) 到目标的变换
+     */
+    void draw_image(const vgSurface& image, const vgRect& source, const vgMatrix& m)
+    {
+        this->draw_image(image, source, m, NULL, 0);
+    }
+
+    /* 使用 mipmap 绘制图片，缩小的时候从接近的一级采样，VG_QUALITY 的时候在相邻两级之间插值
+     * mipmap           图片的 mipmap，第一次缩小绘制的时候生成，图片大小改变的时候重新生成
+     */
+    void draw_image(const vgSurface& image, vgMipmap& mipmap, const vgRect& source, const vgMatrix& m)
+    {
+        uint32_t mix;
+        int level = this->mip_level(image, mipmap, m, mix);
+        if (!level && !mix) {
+            this->draw_image(image, source, m);
+            return;
+        }
+
+        float k = ldexp(1.0f, -level);
+        vgMatrix ml = m;
+        ml.scale(1.0f / k, 1.0f / k);
+        this->draw_image(level ? mipmap.level(level) : image, vgRect(source.x * k, source.y * k, source.w * k, source.h * k), ml,
+            mix ? &mipmap.level(level + 1) : NULL, mix);
+    }
+
+    /* 绘制精灵
+     * image            图片
+     * sprite           精灵参数
+     */
+    void draw_sprite(const vgSurface& image, const vgSprite& sprite)
+    {
+        if (!(sprite.alpha > 0.0f)) {
+            return;
+        }
+        this->draw_sprite(image, sprite.source, sprite.matrix(), sprite.modulation(), NULL, 0);
+    }
+
+    // 使用 mipmap 绘制精灵，和 draw_image 一样选择级别
+    void draw_sprite(const vgSurface& image, vgMipmap& mipmap, const vgSprite& sprite)
+    {
+        if (!(sprite.alpha > 0.0f)) {
+            return;
+        }
+
+        const vgRect& s = sprite.source;
+        vgMatrix m      = sprite.matrix();
+        uint32_t mix;
+        int level = this->mip_level(image, mipmap, m, mix);
+        if (!level && !mix) {
+            this->draw_sprite(image, s, m, sprite.modulation(), NULL, 0);
+            return;
+        }
+
+        float k = ldexp(1.0f, -level);
+        m.scale(1.0f / k, 1.0f / k);
+        this->draw_sprite(level ? mipmap.level(level) : image, vgRect(s.x * k, s.y * k, s.w * k, s.h * k), m,
+            sprite.modulation(), mix ? &mipmap.level(level + 1) : NULL, mix);
+    }
+
+    // 批量绘制同一张图片的精灵
+    void draw_sprites(const vgSurface& image, const vgSprite* sprites, size_t size)
+    {
+        this->begin_batch();
+        for (size_t i = 0; i < size; ++i) {
+            this->draw_sprite(image, sprites[i]);
+        }
+        this->end_batch();
+    }
+
+    // 使用 mipmap 批量绘制同一张图片的精灵
+    void draw_sprites(const vgSurface& image, vgMipmap& mipmap, const vgSprite* sprites, size_t size)
+    {
+        this->begin_batch();
+        for (size_t i = 0; i < size; ++i) {
+            this->draw_sprite(image, mipmap, sprites[i]);
+        }
+        this->end_batch();
+    }
+
+private:
+    detail::irect bounds() const
+    {
+        return detail::irect(0, 0, m_target.width, m_target.height);
+    }
+
+    // 变换改变以后更新类型
+    void update_transform()
+    {
+        if (m_transform.is_identity()) {
+            m_transformKind = TRANSFORM_IDENTITY;
+        }
+        else if (m_transform.is_translate()) {
+            m_transformKind = TRANSFORM_TRANSLATE;
+        }
+        else if (m_transform.is_axis_aligned()) {
+            m_transformKind = TRANSFORM_AXIS;
+        }
+        else {
+            m_transformKind = TRANSFORM_AFFINE;
+        }
+    }
+
+    // 变换 m_list.points 里面从 first 开始的顶点
+    void transform_points(size_t first)
+    {
+        const vgMatrix& m = m_transform;
+        if (m_transformKind == TRANSFORM_IDENTITY) {
+            return;
+        }
+        if (m_transformKind == TRANSFORM_TRANSLATE) {
+            for (size_t i = first; i < m_list.points.size(); ++i) {
+                m_list.points[i].x += m.tx;
+                m_list.points[i].y += m.ty;
+            }
+            return;
+        }
+        for (size_t i = first; i < m_list.points.size(); ++i) {
+            m_list.points[i] = m.transform(m_list.points[i]);
+        }
+    }
+
+    /* 使用仿射矩阵绘制图片
+     * next, mix        三线性插值的下一级 mipmap 和权重（0 ~ 256），mix 为 0 的时候不插值
+     */
+    void draw_image(const vgSurface& image, const vgRect& source, const vgMatrix& local, const vgSurface* next, uint32_t mix)
+    {
+        using namespace std;
+
+        if (image.empty() || source.w <= 0.0f || source.h <= 0.0f) {
+            return;
+        }
+
+        // 平移和轴对齐的变换合成以后仍然可以直接混合或者缩放
+        const vgMatrix m = m_transformKind == TRANSFORM_IDENTITY ? local : m_transform * local;
+        if (!mix && this->blit_image(image, source, m)) {
+            return;
+        }
+        if (!mix && m_filter != VG_FILTER_AUTO && this->resample_image(image, source, m)) {
+            return;
+        }
+
+        detail::irect src(
+            max(static_cast<int>(floor(source.x)), 0),
+            max(static_cast<int>(floor(source.y)), 0),
+            min(static_cast<int>(ceil(source.x + source.w)), image.width),
+            min(static_cast<int>(ceil(source.y + source.h)), image.height)
+        );
+        if (src.empty()) {
+            return;
+        }
+
+        vgMatrix inverse = vgMatrix(1.0f, 0.0f, 0.0f, 1.0f, source.x, source.y) * m.inverse();
+
+        // 顶点使用绘图坐标，add_polygon 会应用变换
+        vec2f p[4] = {
+            local.transform(0.0f, 0.0f),
+            local.transform(source.w, 0.0f),
+            local.transform(source.w, source.h),
+            local.transform(0.0f, source.h)
+        };
+
+        this->begin();
+        this->add_polygon(p, 4);
+
+        detail::command cmd;
+        if (this->end(cmd, detail::CMD_IMAGE)) {
+            cmd.rule     = VG_NONZERO;
+            cmd.image    = image;
+            cmd.source   = src;
+            cmd.inverse  = inverse;
+            cmd.bilinear = m_effectLevel != VG_SPEED;
+            this->mip_next(cmd, next, mix);
+            this->submit(cmd);
+        }
+    }
+
+    /* 绘制精灵
+     * s                图片源范围
+     * m                源范围局部坐标 (0, 0) - (s.w, s.h) 到目标的变换
+     * color            预乘的调制颜色（透明度和着色）
+     * next, mix        三线性插值的下一级 mipmap 和权重（0 ~ 256），mix 为 0 的时候不插值
+     */
+    void draw_sprite(const vgSurface& image, const vgRect& s, const vgMatrix& local, uint32_t color, const vgSurface* next, uint32_t mix)
+    {
+        using namespace std;
+
+        if (m_target.empty() || m_clip.empty() || image.empty() || s.w <= 0.0f || s.h <= 0.0f || !(color >> 24)) {
+            return;
+        }
+
+        const vgMatrix m = m_transformKind == TRANSFORM_IDENTITY ? local : m_transform * local;
+
+        detail::irect src(
+            max(static_cast<int>(floor(s.x)), 0),
+            max(static_cast<int>(floor(s.y)), 0),
+            min(static_cast<int>(ceil(s.x + s.w)), image.width),
+            min(static_cast<int>(ceil(s.y + s.h)), image.height)
+        );
+        if (src.empty()) {
+            return;
+        }
+
+        if (is_zero(m.a * m.d - m.b * m.c)) {
+            return;
+        }
+
+        // 包围盒，抗锯齿的边缘向外扩展一个像素
+        vec2f p[4] = {
+            m.transform(0.0f, 0.0f),
+            m.transform(s.w, 0.0f),
+            m.transform(s.w, s.h),
+            m.transform(0.0f, s.h)
+        };
+        vec2f a = p[0];
+        vec2f b = p[0];
+        for (int i = 1; i < 4; ++i) {
+            a.x = min(a.x, p[i].x);
+            a.y = min(a.y, p[i].y);
+            b.x = max(b.x, p[i].x);
+            b.y = max(b.y, p[i].y);
+        }
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (!(a.x > -limit && a.y > -limit && b.x < limit && b.y < limit)) {
+            return;
+        }
+
+        if (!mix && this->blit_image(image, s, m, color)) {
+            return;
+        }
+
+        detail::command cmd = detail::command();
+        cmd.type      = detail::CMD_SPRITE;
+        cmd.bounds    = detail::irect(int(floor(a.x)) - 1, int(floor(a.y)) - 1, int(floor(b.x)) + 2, int(floor(b.y)) + 2).intersect(m_clip);
+        cmd.color     = color;
+        cmd.antialias = this->antialias();
+        cmd.bilinear  = m_effectLevel != VG_SPEED;
+        cmd.image     = image;
+        cmd.source    = src;
+        cmd.inverse   = vgMatrix(1.0f, 0.0f, 0.0f, 1.0f, s.x, s.y) * m.inverse();
+        cmd.region    = s;
+        this->mip_next(cmd, next, mix);
+        this->submit(cmd);
+    }
+
+    /* 选择 mipmap 级别，返回 0 使用原图
+     * mix              返回三线性插值下一级的权重，只有 VG_QUALITY 的时候插值
+     */
+    int mip_level(const vgSurface& image, vgMipmap& mipmap, const vgMatrix& m, uint32_t& mix)
+    {
+        using namespace std;
+
+        mix = 0;
+        const bool trilinear = m_effectLevel == VG_QUALITY;
+        const float lod      = vgMipmap::lod(m_transformKind == TRANSFORM_IDENTITY ? m : m_transform * m);
+        if (!(lod > (trilinear ? 0.0f : 0.5f)) || image.empty()) {
+            return 0;
+        }
+
+        if (mipmap.width() != image.width || mipmap.height() != image.height) {
+            // 记录的绘图命令可能还在使用原来的级别
+            if (!mipmap.empty()) {
+                this->flush();
+            }
+            mipmap.build(image);
+        }
+
+        const int count = mipmap.size();
+        if (!trilinear) {
+            return int(min(floor(lod + 0.5f), float(count)));
+        }
+        float level = min(floor(lod), float(count));
+        if (level < float(count)) {
+            mix = uint32_t((lod - level) * 256.0f);
+        }
+        return int(level);
+    }
+
+    // 设置三线性插值的下一级，下一级的采样范围是这一级的一半
+    void mip_next(detail::command& cmd, const vgSurface* next, uint32_t mix)
+    {
+        if (next && mix) {
+            cmd.next       = *next;
+            cmd.nextSource = detail::irect(cmd.source.x1 / 2, cmd.source.y1 / 2, (cmd.source.x2 + 1) / 2, (cmd.source.y2 + 1) / 2)
+                .intersect(detail::irect(0, 0, next->width, next->height));
+            cmd.mix        = mix;
+        }
+    }
+
+    bool antialias() const
+    {
+        return m_effectLevel != VG_SPEED;
+    }
+
+    // 画笔宽度的一半，变换以后最小绘制 1 像素
+    float half_width() const
+    {
+        return m_stroke.half_width(this->transform_scale());
+    }
+
+    // 变换以后不超过 1 像素的实线，按细线绘制
+    bool thin_stroke() const
+    {
+        return m_stroke.hairline(this->transform_scale());
+    }
+
+    // 开始一个图形
+    void begin()
+    {
+        m_pointMark   = m_list.points.size();
+        m_contourMark = m_list.contours.size();
+    }
+
+    // 添加一个轮廓
+    void add_polygon(const vec2f* points, size_t size)
+    {
+        if (size < 3) {
+            return;
+        }
+        const size_t first = m_list.points.size();
+        m_list.points.insert(m_list.points.end(), points, points + size);
+        m_list.contours.push_back(static_cast<uint32_t>(size));
+        this->transform_points(first);
+    }
+
+    // 放弃当前图形
+    void discard()
+    {
+        m_list.points.resize(m_pointMark);
+        m_list.contours.resize(m_contourMark);
+    }
+
+    // 结束当前图形，生成命令。图形为空或者不可见返回 false
+    bool end(detail::command& cmd, int type)
+    {
+        using namespace std;
+
+        if (m_target.empty() || m_clip.empty() || m_list.contours.size() == m_contourMark) {
+            this->discard();
+            return false;
+        }
+
+        // 包围盒
+        const vec2f* p = &m_list.points[m_pointMark];
+        const size_t n = m_list.points.size() - m_pointMark;
+        vec2f a = p[0];
+        vec2f b = p[0];
+        for (size_t i = 1; i < n; ++i) {
+            a.x = min(a.x, p[i].x);
+            a.y = min(a.y, p[i].y);
+            b.x = max(b.x, p[i].x);
+            b.y = max(b.y, p[i].y);
+        }
+
+        cmd = detail::command();
+        cmd.type      = type;
+        cmd.antialias = this->antialias();
+        cmd.point     = static_cast<uint32_t>(m_pointMark);
+        cmd.contour   = static_cast<uint32_t>(m_contourMark);
+        cmd.contours  = static_cast<uint32_t>(m_list.contours.size() - m_contourMark);
+
+        // NaN 和超出范围的坐标只用剪裁矩形限制，并且交给稀疏单元格处理
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (a.x > -limit && a.y > -limit && b.x < limit && b.y < limit) {
+            detail::irect box(int(floor(a.x)), int(floor(a.y)), int(floor(b.x)) + 1, int(floor(b.y)) + 1);
+            if (type == detail::CMD_LINE) {
+                // 抗锯齿细线会影响相邻的像素
+                box = detail::irect(box.x1 - 1, box.y1 - 1, box.x2 + 1, box.y2 + 1);
+            }
+            cmd.bounds     = box.intersect(m_clip);
+            cmd.accumulate = n >= ACCUMULATE_THRESHOLD;
+        }
+        else {
+            cmd.bounds = m_clip;
+        }
+
+        if (cmd.bounds.empty()) {
+            this->discard();
+            return false;
+        }
+        return true;
+    }
+
+    // 执行或者记录一个命令
+    void submit(const detail::command& cmd)
+    {
+        if (m_target.empty() || cmd.bounds.empty()) {
+            return;
+        }
+
+        // 批量绘制的图元先收集起来，end_batch() 的时候一起提交。前面收集的简单图元先提交，保持绘制顺序
+        if (m_batching) {
+            this->end_shapes();
+            m_list.batch.push_back(cmd);
+            m_list.batch.back().blend = static_cast<uint8_t>(cmd.type == detail::CMD_CLEAR ? VG_BLEND_COPY : m_blend);
+            return;
+        }
+        this->record(cmd);
+    }
+
+    // 记录一个命令，立即绘制的时候马上执行
+    void record(const detail::command& cmd)
+    {
+        if (m_tracking && !m_offscreen) {
+            m_damage.add(cmd.bounds);
+        }
+        m_list.commands.push_back(cmd);
+        m_list.commands.back().blend = static_cast<uint8_t>(cmd.type == detail::CMD_CLEAR ? VG_BLEND_COPY : m_blend);
+        if (!m_deferred && m_pool.size() == 1) {
+            this->flush();
+        }
+    }
+
+    // 透明的颜色不改变目标像素，复制模式除外
+    bool invisible(vgPixel color) const
+    {
+        return !color && m_blend != VG_BLEND_COPY;
+    }
+
+    // 多线程分块渲染
+    void render_tiles()
+    {
+        const int columns = (m_target.width + TILE_SIZE - 1) / TILE_SIZE;
+        const int rows    = (m_target.height + TILE_SIZE - 1) / TILE_SIZE;
+
+        m_bins.resize(size_t(columns) * rows);
+        for (size_t i = 0; i < m_bins.size(); ++i) {
+            m_bins[i].clear();
+        }
+
+        // 把命令分配到相交的分块，批量绘制的图元单独分配，分块不用遍历整个批次
+        for (size_t i = 0; i < m_list.commands.size(); ++i) {
+            const detail::command& cmd = m_list.commands[i];
+            if (cmd.type == detail::CMD_BATCH) {
+                for (uint32_t n = cmd.point; n < cmd.point + cmd.contours; ++n) {
+                    this->bin_command(m_list.batch[n].bounds, n | detail::BATCH_ITEM, columns);
+                }
+            }
+            else if (cmd.type == detail::CMD_SHAPES) {
+                for (uint32_t n = cmd.point; n < cmd.point + cmd.contours; ++n) {
+                    this->bin_command(m_list.shapes[n].bounds, n | detail::SHAPE_ITEM, columns);
+                }
+            }
+            else {
+                this->bin_command(cmd.bounds, static_cast<uint32_t>(i), columns);
+            }
+        }
+
+        detail::tile_job job;
+        job.target      = &m_target;
+        job.list        = &m_list;
+        job.bins        = &m_bins;
+        job.rasterizers = &m_ras;
+        job.columns     = columns;
+        job.size        = TILE_SIZE;
+        m_pool.run(detail::tile_job::render, &job, columns * rows);
+    }
+
+    void bin_command(const detail::irect& b, uint32_t index, int columns)
+    {
+        if (b.empty()) {
+            return;
+        }
+        for (int y = b.y1 / TILE_SIZE; y <= (b.y2 - 1) / TILE_SIZE; ++y) {
+            for (int x = b.x1 / TILE_SIZE; x <= (b.x2 - 1) / TILE_SIZE; ++x) {
+                m_bins[size_t(y) * columns + x].push_back(index);
+            }
+        }
+    }
+
+    /* 开始批量绘制
+     * 之后提交的命令收集到一个 CMD_BATCH 里面；矩形和椭圆收集成简单图元，放到一个 CMD_SHAPES 里面，
+     * 不经过光栅化器和命令分派，直接逐行混合。两种图元交替出现的时候分段提交，保持绘制顺序。
+     */
+    void begin_batch()
+    {
+        m_batching  = true;
+        m_batchMark = m_list.batch.size();
+        m_shapeMark = m_list.shapes.size();
+    }
+
+    // 结束批量绘制，没有提交的图元作为一个命令提交
+    void end_batch()
+    {
+        m_batching = false;
+        this->end_items();
+        this->end_shapes();
+    }
+
+    // 收集的图元作为一个 CMD_BATCH 提交
+    void end_items()
+    {
+        if (m_list.batch.size() > m_batchMark) {
+            detail::command cmd = detail::command();
+            cmd.type     = detail::CMD_BATCH;
+            cmd.point    = static_cast<uint32_t>(m_batchMark);
+            cmd.contours = static_cast<uint32_t>(m_list.batch.size() - m_batchMark);
+            cmd.bounds   = m_list.batch[m_batchMark].bounds;
+            for (size_t i = m_batchMark + 1; i < m_list.batch.size(); ++i) {
+                cmd.bounds = cmd.bounds.unite(m_list.batch[i].bounds);
+            }
+            this->record(cmd);
+        }
+        // 立即绘制的时候 record() 会清空命令列表
+        m_batchMark = m_list.batch.size();
+    }
+
+    // 收集的简单图元作为一个 CMD_SHAPES 提交
+    void end_shapes()
+    {
+        if (m_list.shapes.size() > m_shapeMark) {
+            detail::command cmd = detail::command();
+            cmd.type     = detail::CMD_SHAPES;
+            cmd.point    = static_cast<uint32_t>(m_shapeMark);
+            cmd.contours = static_cast<uint32_t>(m_list.shapes.size() - m_shapeMark);
+            cmd.bounds   = m_list.shapes[m_shapeMark].bounds;
+            for (size_t i = m_shapeMark + 1; i < m_list.shapes.size(); ++i) {
+                cmd.bounds = cmd.bounds.unite(m_list.shapes[i].bounds);
+            }
+            this->record(cmd);
+        }
+        m_shapeMark = m_list.shapes.size();
+    }
+
+    // 批量绘制的时候收集一个简单图元，前面收集的其他图元先提交，保持绘制顺序
+    void add_shape(detail::shape& s)
+    {
+        if (m_target.empty() || s.bounds.empty()) {
+            return;
+        }
+        this->end_items();
+        s.blend = static_cast<uint8_t>(m_blend);
+        m_list.shapes.push_back(s);
+    }
+
+    void fill(vgPixel color, int rule)
+    {
+        detail::command cmd;
+        if (this->invisible(color)) {
+            this->discard();
+        }
+        else if (this->end(cmd, detail::CMD_FILL)) {
+            cmd.color = color;
+            cmd.rule  = static_cast<uint8_t>(rule);
+            this->submit(cmd);
+        }
+    }
+
+    // 使用填充颜色或者渐变填充当前图形
+    void paint(int rule)
+    {
+        if (!m_gradientFill) {
+            this->fill(m_fillColor, rule);
+            return;
+        }
+
+        detail::command cmd;
+        if (this->end(cmd, detail::CMD_GRADIENT)) {
+            cmd.rule     = static_cast<uint8_t>(rule);
+            cmd.gradient = static_cast<uint8_t>(m_gradient.type());
+            cmd.spread   = static_cast<uint8_t>(m_gradient.spread());
+            cmd.inverse  = m_transformKind == TRANSFORM_IDENTITY ? m_gradient.matrix() : m_gradient.matrix() * m_transform.inverse();
+            cmd.ramp     = this->add_ramp(m_gradient.ramp());
+            this->submit(cmd);
+        }
+    }
+
+    // 复制渐变颜色表到命令列表，和上一个颜色表相同的时候共用
+    uint32_t add_ramp(const vgPixel* ramp)
+    {
+        std::vector<vgPixel>& ramps = m_list.ramps;
+        const size_t n = vgGradient::RAMP_SIZE;
+        if (ramps.size() < n || !std::equal(ramp, ramp + n, ramps.end() - n)) {
+            ramps.insert(ramps.end(), ramp, ramp + n);
+        }
+        return static_cast<uint32_t>(ramps.size() - n);
+    }
+
+    // 把当前图形作为细线绘制，closed 表示折线首尾相连
+    void hairline(vgPixel color, bool closed)
+    {
+        detail::command cmd;
+        if (this->invisible(color)) {
+            this->discard();
+        }
+        else if (this->end(cmd, detail::CMD_LINE)) {
+            cmd.color  = color;
+            cmd.closed = closed;
+            this->submit(cmd);
+        }
+    }
+
+    // 添加一条细线折线
+    void add_hairline(const vec2f* points, size_t size)
+    {
+        if (size < 2) {
+            return;
+        }
+        const size_t first = m_list.points.size();
+        m_list.points.insert(m_list.points.end(), points, points + size);
+        m_list.contours.push_back(static_cast<uint32_t>(size));
+        this->transform_points(first);
+    }
+
+    void fill_rect(float x, float y, float width, float height, vgPixel color)
+    {
+        // 批量绘制的矩形收集成简单图元
+        if (m_batching && this->batch_rect(x, y, width, height, color)) {
+            return;
+        }
+        // 对齐到像素的矩形不需要光栅化，直接按行混合
+        if (this->fill_aligned_rect(x, y, width, height, color)) {
+            return;
+        }
+        this->begin();
+        this->add_rect(x, y, width, height, false);
+        this->fill(color, VG_NONZERO);
+    }
+
+    // 坐标都是整数的矩形，覆盖率全是 255，结果和光栅化相同。轴对齐的变换先变换矩形
+    bool fill_aligned_rect(float x, float y, float width, float height, vgPixel color)
+    {
+        using namespace std;
+
+        if (m_transformKind == TRANSFORM_AFFINE || !(width > 0.0f && height > 0.0f)) {
+            return false;
+        }
+        if (m_transformKind != TRANSFORM_IDENTITY) {
+            vgRect r = m_transform.transform(vgRect(x, y, width, height));
+            x      = r.x;
+            y      = r.y;
+            width  = r.w;
+            height = r.h;
+        }
+
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (fabs(x) > limit || fabs(y) > limit || width > limit || height > limit) {
+            return false;
+        }
+        if (x != floor(x) || y != floor(y) || width != floor(width) || height != floor(height)) {
+            return false;
+        }
+
+        if (this->invisible(color)) {
+            return true;
+        }
+
+        int x1 = int(x);
+        int y1 = int(y);
+
+        detail::command cmd = detail::command();
+        cmd.type   = detail::CMD_RECT;
+        cmd.bounds = detail::irect(x1, y1, x1 + int(width), y1 + int(height)).intersect(m_clip);
+        cmd.color  = color;
+        this->submit(cmd);
+        return true;
+    }
+
+    /* 批量绘制的矩形，没有旋转和镜像的时候收集成 SHAPE_RECT
+     * 顶点和 add_rect() 一样计算、变换，再按光栅化器的方式取整，结果和填充多边形完全相同。
+     * 镜像以后多边形的环绕方向相反，覆盖率的取整方向不同，仍然交给光栅化器。
+     */
+    bool batch_rect(float x, float y, float width, float height, vgPixel color)
+    {
+        using namespace std;
+
+        const vgMatrix& m = m_transform;
+        if (!(width > 0.0f && height > 0.0f) || m_transformKind == TRANSFORM_AFFINE) {
+            return false;
+        }
+        if (m_transformKind == TRANSFORM_AXIS && !(m.b == 0.0f && m.c == 0.0f && m.a > 0.0f && m.d > 0.0f)) {
+            return false;
+        }
+
+        vec2f a(x, y);
+        vec2f b(x + width, y + height);
+        if (m_transformKind == TRANSFORM_TRANSLATE) {
+            a.x += m.tx;
+            a.y += m.ty;
+            b.x += m.tx;
+            b.y += m.ty;
+        }
+        else if (m_transformKind == TRANSFORM_AXIS) {
+            a = m.transform(a);
+            b = m.transform(b);
+        }
+
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (!(a.x > -limit && a.y > -limit && b.x < limit && b.y < limit)) {
+            return false;
+        }
+        if (this->invisible(color)) {
+            return true;
+        }
+
+        detail::shape s = detail::shape();
+        s.type      = detail::SHAPE_RECT;
+        s.bounds    = detail::irect(int(floor(a.x)), int(floor(a.y)), int(floor(b.x)) + 1, int(floor(b.y)) + 1).intersect(m_clip);
+        s.color     = color;
+        s.antialias = this->antialias();
+        s.x1        = detail::rasterizer::upscale(a.x);
+        s.y1        = detail::rasterizer::upscale(a.y);
+        s.x2        = detail::rasterizer::upscale(b.x);
+        s.y2        = detail::rasterizer::upscale(b.y);
+        this->add_shape(s);
+        return true;
+    }
+
+    /* 填充椭圆或者椭圆环，hx, hy 是环的内半径
+     * 坐标超出光栅化范围的时候，转换成多边形填充
+     */
+    void fill_ellipse(float ox, float oy, float rx, float ry, float hx, float hy, vgPixel color)
+    {
+        using namespace std;
+
+        if (!(rx > 0.0f && ry > 0.0f) || this->invisible(color) || m_target.empty() || m_clip.empty()) {
+            return;
+        }
+
+        // 轴对齐的变换，椭圆变换以后仍然是轴对齐的椭圆，90 度旋转交换两个半径
+        vec2f o(ox, oy);
+        vec2f r(rx, ry);
+        vec2f h(hx, hy);
+        if (m_transformKind == TRANSFORM_TRANSLATE) {
+            o = m_transform.transform(o);
+        }
+        else if (m_transformKind == TRANSFORM_AXIS) {
+            const vgMatrix& m = m_transform;
+            o = m.transform(o);
+            if (m.b == 0.0f && m.c == 0.0f) {
+                r = vec2f(rx * fabs(m.a), ry * fabs(m.d));
+                h = vec2f(hx * fabs(m.a), hy * fabs(m.d));
+            }
+            else {
+                r = vec2f(ry * fabs(m.c), rx * fabs(m.b));
+                h = vec2f(hy * fabs(m.c), hx * fabs(m.b));
+            }
+            if (!(r.x > 0.0f && r.y > 0.0f)) {
+                return;
+            }
+        }
+
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (m_transformKind == TRANSFORM_AFFINE || !(fabs(o.x) + r.x < limit && fabs(o.y) + r.y < limit)) {
+            this->begin();
+            this->add_ellipse(ox, oy, rx, ry, false);
+            if (hx > 0.0f && hy > 0.0f) {
+                this->add_ellipse(ox, oy, hx, hy, true);
+            }
+            this->fill(color, VG_NONZERO);
+            return;
+        }
+
+        const detail::irect bounds = detail::irect(
+            int(floor(o.x - r.x)) - 1, int(floor(o.y - r.y)) - 1,
+            int(floor(o.x + r.x)) + 2, int(floor(o.y + r.y)) + 2
+        ).intersect(m_clip);
+
+        // 批量绘制的椭圆收集成简单图元
+        if (m_batching) {
+            detail::shape s = detail::shape();
+            s.type      = detail::SHAPE_ELLIPSE;
+            s.bounds    = bounds;
+            s.color     = color;
+            s.antialias = this->antialias();
+            s.center    = o;
+            s.radius    = r;
+            s.hole      = vec2f(max(h.x, 0.0f), max(h.y, 0.0f));
+            this->add_shape(s);
+            return;
+        }
+
+        detail::command cmd = detail::command();
+        cmd.type      = detail::CMD_ELLIPSE;
+        cmd.bounds    = bounds;
+        cmd.color     = color;
+        cmd.antialias = this->antialias();
+        cmd.center    = o;
+        cmd.radius    = r;
+        cmd.hole      = vec2f(max(h.x, 0.0f), max(h.y, 0.0f));
+        this->submit(cmd);
+    }
+
+    /* 对齐到像素的图片不需要光栅化，直接按行混合，结果和光栅化相同
+     * 源范围在图片里面，矩阵只有整数平移和整数倍放大。放大的时候只有最近点采样和复制相同
+     * color 是预乘的调制颜色，白色不改变图片
+     */
+    bool blit_image(const vgSurface& image, const vgRect& s, const vgMatrix& m, uint32_t color = 0xFFFFFFFF)
+    {
+        using namespace std;
+
+        if (m.b != 0.0f || m.c != 0.0f || !(m.a >= 1.0f && m.a <= 256.0f) || !(m.d >= 1.0f && m.d <= 256.0f)) {
+            return false;
+        }
+        if (m.a != floor(m.a) || m.d != floor(m.d) || m.tx != floor(m.tx) || m.ty != floor(m.ty)) {
+            return false;
+        }
+        if ((m.a != 1.0f || m.d != 1.0f) && m_effectLevel != VG_SPEED) {
+            return false;
+        }
+        if (s.x != floor(s.x) || s.y != floor(s.y) || s.w != floor(s.w) || s.h != floor(s.h)) {
+            return false;
+        }
+        if (s.x < 0.0f || s.y < 0.0f || s.x + s.w > float(image.width) || s.y + s.h > float(image.height)) {
+            return false;
+        }
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (fabs(m.tx) > limit || fabs(m.ty) > limit || s.w * m.a > limit || s.h * m.d > limit) {
+            return false;
+        }
+
+        detail::command cmd = detail::command();
+        cmd.type    = detail::CMD_BLIT;
+        cmd.color   = color;
+        cmd.image   = image;
+        cmd.source  = detail::irect(int(s.x), int(s.y), int(s.x + s.w), int(s.y + s.h));
+        cmd.originX = int(m.tx);
+        cmd.originY = int(m.ty);
+        cmd.scaleX  = int(m.a);
+        cmd.scaleY  = int(m.d);
+        cmd.bounds  = detail::irect(
+            cmd.originX, cmd.originY,
+            cmd.originX + cmd.source.width() * cmd.scaleX,
+            cmd.originY + cmd.source.height() * cmd.scaleY
+        ).intersect(m_clip);
+        this->submit(cmd);
+        return true;
+    }
+
+    /* 轴对齐缩放的图片先缩放到目标大小，再按行混合
+     * 目标范围四舍五入到像素，缩放以后的图片保存在命令列表里面，flush() 之后释放
+     */
+    bool resample_image(const vgSurface& image, const vgRect& s, const vgMatrix& m)
+    {
+        using namespace std;
+
+        if (m.b != 0.0f || m.c != 0.0f || !(m.a > 0.0f) || !(m.d > 0.0f) || (m.a == 1.0f && m.d == 1.0f)) {
+            return false;
+        }
+        const float limit = float(detail::rasterizer::LIMIT);
+        if (fabs(m.tx) > limit || fabs(m.ty) > limit || s.w * m.a > limit || s.h * m.d > limit) {
+            return false;
+        }
+
+        detail::irect src(
+            max(static_cast<int>(floor(s.x)), 0),
+            max(static_cast<int>(floor(s.y)), 0),
+            min(static_cast<int>(ceil(s.x + s.w)), image.width),
+            min(static_cast<int>(ceil(s.y + s.h)), image.height)
+        );
+        detail::irect box(
+            static_cast<int>(floor(m.tx + 0.5f)),
+            static_cast<int>(floor(m.ty + 0.5f)),
+            static_cast<int>(floor(m.tx + s.w * m.a + 0.5f)),
+            static_cast<int>(floor(m.ty + s.h * m.d + 0.5f))
+        );
+        box = box.intersect(m_clip);
+        if (src.empty() || box.empty()) {
+            return true;
+        }
+
+        // 目标像素中心对应的源坐标
+        const double scaleX  = 1.0 / m.a;
+        const double scaleY  = 1.0 / m.d;
+        const double offsetX = s.x + (box.x1 + 0.5 - m.tx) * scaleX;
+        const double offsetY = s.y + (box.y1 + 0.5 - m.ty) * scaleY;
+
+        m_list.images.push_back(std::vector<vgPixel>());
+        std::vector<vgPixel>& pixels = m_list.images.back();
+        pixels.resize(size_t(box.width()) * box.height());
+        vgSurface scaled(&pixels[0], box.width(), box.height(), box.width());
+        detail::resample(scaled, image, src, m_filter, offsetX, scaleX, offsetY, scaleY, &m_pool);
+
+        detail::command cmd = detail::command();
+        cmd.type    = detail::CMD_BLIT;
+        cmd.color   = 0xFFFFFFFF;
+        cmd.image   = scaled;
+        cmd.source  = detail::irect(0, 0, box.width(), box.height());
+        cmd.originX = box.x1;
+        cmd.originY = box.y1;
+        cmd.scaleX  = 1;
+        cmd.scaleY  = 1;
+        cmd.bounds  = box;
+        this->submit(cmd);
+        return true;
+    }
+
+    // 添加矩形，reverse 表示反向环绕（挖空）
+    void add_rect(float x, float y, float width, float height, bool reverse)
+    {
+        if (width <= 0.0f || height <= 0.0f) {
+            return;
+        }
+        vec2f p[4] = {
+            vec2f(x, y),
+            vec2f(x + width, y),
+            vec2f(x + width, y + height),
+            vec2f(x, y + height)
+        };
+        if (reverse) {
+            std::swap(p[1], p[3]);
+        }
+        this->add_polygon(p, 4);
+    }
+
+    // 添加椭圆弧上的点，角度和 GDI+ 一样顺时针
+    void add_arc(float ox, float oy, float rx, float ry, float start, float sweep)
+    {
+        using namespace std;
+
+        int n       = detail::arc_segments(max(rx, ry) * this->transform_scale(), static_cast<float>(sweep * M_RD));
+        double step = sweep * M_RD / n;
+        double a    = start * M_RD;
+        for (int i = 0; i <= n; ++i, a += step) {
+            m_points.push_back(vec2f(ox + rx * static_cast<float>(cos(a)), oy + ry * static_cast<float>(sin(a))));
+        }
+    }
+
+    // 单位圆上的 n 个顶点，分段数相同的椭圆共用，不用每次计算三角函数
+    const std::vector<vec2f>& unit_circle(int n)
+    {
+        if (m_circle.size() != size_t(n)) {
+            m_circle.resize(n);
+            for (int i = 0; i < n; ++i) {
+                double a = 2.0 * M_PI * i / n;
+                m_circle[i] = vec2f(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+            }
+        }
+        return m_circle;
+    }
+
+    // 椭圆的顶点保存到 m_points
+    bool ellipse_points(float ox, float oy, float rx, float ry, bool reverse)
+    {
+        if (rx <= 0.0f || ry <= 0.0f) {
+            return false;
+        }
+        const std::vector<vec2f>& unit = this->unit_circle(detail::arc_segments(std::max(rx, ry) * this->transform_scale(), float(2.0 * M_PI)));
+        if (reverse) {
+            ry = -ry;
+        }
+        m_points.resize(unit.size());
+        for (size_t i = 0; i < unit.size(); ++i) {
+            m_points[i] = vec2f(ox + rx * unit[i].x, oy + ry * unit[i].y);
+        }
+        return true;
+    }
+
+    void add_ellipse(float ox, float oy, float rx, float ry, bool reverse)
+    {
+        if (this->ellipse_points(ox, oy, rx, ry, reverse)) {
+            this->add_polygon(&m_points[0], m_points.size());
+        }
+    }
+
+    // 圆角矩形的顶点保存到 m_points
+    bool roundrect_points(float x, float y, float width, float height, float cx, float cy)
+    {
+        using namespace std;
+
+        if (width <= 0.0f || height <= 0.0f) {
+            return false;
+        }
+
+        cx = min(cx, width * 0.5f);
+        cy = min(cy, height * 0.5f);
+        m_points.clear();
+        if (cx <= 0.0f || cy <= 0.0f) {
+            m_points.push_back(vec2f(x, y));
+            m_points.push_back(vec2f(x + width, y));
+            m_points.push_back(vec2f(x + width, y + height));
+            m_points.push_back(vec2f(x, y + height));
+            return true;
+        }
+
+        float x1 = x + cx;
+        float y1 = y + cy;
+        float x2 = x + width - cx;
+        float y2 = y + height - cy;
+
+        this->add_arc(x1, y1, cx, cy, 180.0f, 90.0f);
+        this->add_arc(x2, y1, cx, cy, 270.0f, 90.0f);
+        this->add_arc(x2, y2, cx, cy, 0.0f, 90.0f);
+        this->add_arc(x1, y2, cx, cy, 90.0f, 90.0f);
+        return true;
+    }
+
+    void add_roundrect(float x, float y, float width, float height, float cx, float cy, bool reverse)
+    {
+        if (this->roundrect_points(x, y, width, height, cx, cy)) {
+            if (reverse) {
+                std::reverse(m_points.begin(), m_points.end());
+            }
+            this->add_polygon(&m_points[0], m_points.size());
+        }
+    }
+
+    // 添加宽度为 hw * 2 的线段（方向一致，非零填充时可以直接合并）
+    void add_segment(const vec2f& p1, const vec2f& p2, float hw)
+    {
+        vec2f d = p2 - p1;
+        float n = length(d);
+        if (is_zero(n)) {
+            return;
+        }
+        d *= hw / n;
+        vec2f p[4] = {
+            vec2f(p1.x - d.y, p1.y + d.x),
+            vec2f(p2.x - d.y, p2.y + d.x),
+            vec2f(p2.x + d.y, p2.y - d.x),
+            vec2f(p1.x + d.y, p1.y - d.x)
+        };
+        this->add_polygon(p, 4);
+    }
+
+    // 添加描边生成的多边形（环绕方向一致，使用非零填充）
+    void add_polygons(const detail::polygons& polygons)
+    {
+        size_t first = 0;
+        for (size_t i = 0; i < polygons.contours.size(); ++i) {
+            this->add_polygon(&polygons.points[first], polygons.contours[i]);
+            first += polygons.contours[i];
+        }
+    }
+
+    // 添加折线描边，使用当前的拐角、线帽和虚线样式
+    void add_stroke(const vec2f* points, size_t size, bool closed)
+    {
+        m_strokes.clear();
+        m_stroker.stroke(m_stroke, points, size, closed, m_strokes, this->transform_scale());
+        this->add_polygons(m_strokes);
+    }
+};
+
+} // end namespace minivg
+
+#endif // MINIVG_RASTER_HPP_20261017093512
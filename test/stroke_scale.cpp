@@ -0,0 +1,78 @@
+﻿/*
+ Copyright (c) 2005-2020 sdragonx (mail:sdragonx@foxmail.com)
+
+ stroke_scale.cpp
+
+ 2026-10-17 15:00:00
+
+ 缩放变换下的描边线宽测试，只依赖 minivg_raster.hpp。
+ 变换以后不超过 1 像素的实线画细线，超过 1 像素的按实际宽度描边。
+
+ 编译运行（失败的时候返回 1）：
+    g++ -O2 -I.. stroke_scale.cpp -o stroke_scale && ./stroke_scale
+
+*/
+#include <minivg_raster.hpp>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace minivg;
+
+const int WIDTH  = 128;
+const int HEIGHT = 128;
+
+/* 缩放 scale 倍，画一条 width 宽的水平线，返回中间一列的覆盖率之和（像素宽度）
+ */
+float stroke_width(float scale, float width, int effect = VG_MEDIUM)
+{
+    std::vector<uint32_t> pixels(WIDTH * HEIGHT, 0);
+    vgCanvas canvas;
+    canvas.bind(&pixels[0], WIDTH, HEIGHT, WIDTH);
+    canvas.effect_level(effect);
+    canvas.scale(scale, scale);
+    canvas.pen_color(255, 255, 255, 255);
+    canvas.pen_width(width);
+    canvas.draw_line(2.0f, 10.5f, 28.0f, 10.5f);
+    canvas.flush();
+
+    const int x = int(15.0f * scale);
+    float sum   = 0.0f;
+    for (int y = 0; y < HEIGHT; ++y) {
+        sum += float(pixels[y * WIDTH + x] >> 24) / 255.0f;
+    }
+    return sum;
+}
+
+int failed = 0;
+
+void check(const char* name, float value, float expect, float epsilon)
+{
+    bool ok = std::fabs(value - expect) <= epsilon;
+    printf("%-32s %6.2f (expect %.2f) %s\n", name, value, expect, ok ? "ok" : "FAILED");
+    if (!ok) {
+        ++failed;
+    }
+}
+
+int main()
+{
+    // 没有变换：1 像素以内画细线
+    check("scale 1, width 1", stroke_width(1.0f, 1.0f), 1.0f, 0.1f);
+    check("scale 1, width 3", stroke_width(1.0f, 3.0f), 3.0f, 0.1f);
+
+    // 放大 4 倍：线宽 1 和 1.01 都应该是 4 像素左右，不能一个是细线一个是粗线
+    check("scale 4, width 1", stroke_width(4.0f, 1.0f), 4.0f, 0.1f);
+    check("scale 4, width 1.01", stroke_width(4.0f, 1.01f), 4.04f, 0.1f);
+    check("scale 4, width 1 (speed)", stroke_width(4.0f, 1.0f, VG_SPEED), 4.0f, 0.1f);
+
+    // 变换以后不超过 1 像素画细线，超过 1 像素按实际宽度描边
+    check("scale 4, width 0.25", stroke_width(4.0f, 0.25f), 1.0f, 0.1f);
+    check("scale 4, width 0.5", stroke_width(4.0f, 0.5f), 2.0f, 0.1f);
+
+    // 缩小：变换以后不足 1 像素的线按细线绘制
+    check("scale 0.5, width 2", stroke_width(0.5f, 2.0f), 1.0f, 0.1f);
+    check("scale 0.5, width 4", stroke_width(0.5f, 4.0f), 2.0f, 0.1f);
+
+    return failed ? 1 : 0;
+}